@@ -5,12 +5,14 @@
 // A block on the map
 class Block {
 private:
-  BlockType& _blockType;
+  BlockType* _blockType; // a pointer rather than a reference, so that blocks can be assigned and filled in bulk
+  BlockId _id; // copied from the type, so that attribute tables can be looked up without dereferencing it
 
 public:
-  Block(BlockType& blockType_) : _blockType(blockType_) {}
+  Block(BlockType& blockType_) : _blockType(&blockType_), _id(blockType_.id()) {}
 
-  const BlockType& blockType() const { return _blockType; }
+  const BlockType& blockType() const { return *_blockType; }
+  BlockId id() const { return _id; }
 };
 
 #endif
@@ -0,0 +1,49 @@
+#include "Block.hpp"
+#include "BlockTickScheduler.hpp"
+#include "BlockBehaviours.hpp"
+
+namespace {
+
+// Leaves further than this from any tree trunk decay, along each axis
+const int LEAF_SUPPORT_DISTANCE = 4;
+
+bool covered(const BlockTickContext& context, glm::ivec3 position) {
+  const Block* above = context.get(position + glm::ivec3(0, 1, 0));
+  return above && context.registry().opaque(above->id());
+}
+
+}
+
+void addBlockBehaviours(BlockRegistry& registry) {
+  BlockId grass = registry.id("grass_block");
+  BlockId dirt = registry.id("dirt");
+  BlockId treeTrunk = registry.id("tree_trunk");
+  BlockId treeLeaves = registry.id("tree_leaves");
+
+  registry.randomTick(grass, [grass, dirt] (BlockTickContext& context, glm::ivec3 position, const Block&) {
+    if (covered(context, position)) {
+      context.set(position, Block(context.registry().type(dirt)));
+      return;
+    }
+    // Spread to one of the cells around, one step up or down at most
+    uint32_t r = context.random();
+    glm::ivec3 target = position + glm::ivec3(r % 3, (r >> 8) % 3, (r >> 16) % 3) - 1;
+    const Block* targetBlock = context.get(target);
+    if (targetBlock && targetBlock->id() == dirt && !covered(context, target)) {
+      context.set(target, Block(context.registry().type(grass)));
+    }
+  });
+
+  // Scheduled when a neighbour changes, so removing a trunk makes the leaves around it decay one layer per tick
+  registry.scheduledTick(treeLeaves, [treeTrunk] (BlockTickContext& context, glm::ivec3 position, const Block&) {
+    for (int y = -LEAF_SUPPORT_DISTANCE; y <= LEAF_SUPPORT_DISTANCE; y++) {
+      for (int z = -LEAF_SUPPORT_DISTANCE; z <= LEAF_SUPPORT_DISTANCE; z++) {
+        for (int x = -LEAF_SUPPORT_DISTANCE; x <= LEAF_SUPPORT_DISTANCE; x++) {
+          const Block* block = context.get(position + glm::ivec3(x, y, z));
+          if (block && block->id() == treeTrunk) return;
+        }
+      }
+    }
+    context.set(position, std::nullopt);
+  });
+}
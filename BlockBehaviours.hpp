@@ -0,0 +1,9 @@
+#ifndef _BLOCK_BEHAVIOURS_HPP_
+#define _BLOCK_BEHAVIOURS_HPP_
+#include "BlockRegistry.hpp"
+
+// Set the tick callbacks of the game's block types, which must all be in the registry
+// Grass spreads onto uncovered dirt nearby and turns into dirt when covered, leaves without a tree trunk close by decay
+void addBlockBehaviours(BlockRegistry& registry);
+
+#endif
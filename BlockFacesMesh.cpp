@@ -0,0 +1,95 @@
+#include <array>
+#include <stdexcept>
+#include "Block.hpp"
+#include "BlockFacesMesh.hpp"
+#include "Metrics.hpp"
+
+namespace {
+
+// Outward directions of the sides, in the order of BlockFaceDefinition::side()
+const std::array<glm::ivec3, 6> SIDE_DIRECTIONS = {{
+  {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1},
+}};
+
+void addBlockFaces(const BlocksMap& blocksMap, const LightMap* lightMap, glm::ivec3 position, glm::ivec3 positionInSection, const Block& block, MeshVector<uint32_t>& faces) {
+  const BlockRegistry& registry = blocksMap.registry();
+  const BakedModel& model = registry.model(block.id());
+  if (!model.fullCube) return;
+
+  for (int side = 0; side < 6; side++) {
+    const BakedFace& face = registry.bakedFaces()[model.firstFace + side];
+    glm::ivec3 adjacentPosition = position + SIDE_DIRECTIONS[side];
+    const Block* adjacentBlock = blocksMap.get(adjacentPosition);
+    // Discard faces hidden by the adjacent block
+    if (adjacentBlock && registry.hidesFace(adjacentBlock->id(), side, FULL_SIDE_MASK)) continue;
+
+    unsigned skyLight = lightMap ? lightMap->skyLight(adjacentPosition) : LightMap::MAX_LIGHT;
+    unsigned blockLight = lightMap ? lightMap->blockLight(adjacentPosition) : 0;
+
+    if (face.textureCell >= BlockFacesMesh::MAX_TEXTURE_CELLS) {
+      throw std::out_of_range("texture cell does not fit in a face record");
+    }
+
+    faces.push_back(BlockFacesMesh::packFace(positionInSection, side, skyLight, blockLight, face.textureCell));
+  }
+}
+
+}
+
+BlockFacesMesh BlockFacesMesh::buildFromBlocksMap(const BlocksMap& blocksMap, const LightMap* lightMap) {
+  BlockFacesMesh facesMesh;
+  facesMesh.rebuild(blocksMap, lightMap);
+  return facesMesh;
+}
+
+void BlockFacesMesh::rebuild(const BlocksMap& blocksMap, const LightMap* lightMap) {
+  faces.clear();
+  sections.clear();
+  _cutoutFaces.clear();
+
+  glm::ivec3 sectionCount = (blocksMap.size + SECTION_SIZE - 1) / SECTION_SIZE;
+  for (int sectionY = 0; sectionY < sectionCount.y; sectionY++) {
+    for (int sectionZ = 0; sectionZ < sectionCount.z; sectionZ++) {
+      for (int sectionX = 0; sectionX < sectionCount.x; sectionX++) {
+        glm::ivec3 sectionMin = glm::ivec3(sectionX, sectionY, sectionZ) * SECTION_SIZE;
+        glm::ivec3 sectionMax = glm::min(sectionMin + SECTION_SIZE, blocksMap.size);
+
+        Section section;
+        section.center = glm::vec3(blocksMap.basePosition) + glm::vec3(sectionMin + sectionMax) / 2.f - 0.5f;
+        section.origin = blocksMap.basePosition + sectionMin;
+        section.opaque.first = faces.size();
+        section.cutout.first = _cutoutFaces.size();
+
+        for (int y = sectionMin.y; y < sectionMax.y; y++) {
+          for (int z = sectionMin.z; z < sectionMax.z; z++) {
+            for (int x = sectionMin.x; x < sectionMax.x; x++) {
+              const std::optional<Block>& block = blocksMap.storage[(y * blocksMap.size.z + z) * blocksMap.size.x + x];
+              if (!block) continue;
+              glm::ivec3 position = blocksMap.basePosition + glm::ivec3(x, y, z);
+              MeshVector<uint32_t>& blockFaces = blocksMap.registry().cutout(block->id()) ? _cutoutFaces : faces;
+              addBlockFaces(blocksMap, lightMap, position, glm::ivec3(x, y, z) - sectionMin, *block, blockFaces);
+            }
+          }
+        }
+
+        section.opaque.count = faces.size() - section.opaque.first;
+        section.cutout.count = _cutoutFaces.size() - section.cutout.first;
+        if (section.opaque.count > 0 || section.cutout.count > 0) {
+          sections.push_back(section);
+        }
+      }
+    }
+  }
+
+  // Put the cutout faces after all opaque ones
+  size_t cutoutOffset = faces.size();
+  for (Section& section : sections) {
+    section.cutout.first += cutoutOffset;
+  }
+  faces.insert(faces.end(), _cutoutFaces.begin(), _cutoutFaces.end());
+
+  static Metric& meshFaces = Metrics::gauge("block_faces_mesh.faces");
+  static Metric& meshSections = Metrics::gauge("block_faces_mesh.sections");
+  meshFaces.set(faces.size());
+  meshSections.set(sections.size());
+}
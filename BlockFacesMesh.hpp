@@ -0,0 +1,44 @@
+#ifndef _BLOCK_FACES_MESH_HPP_
+#define _BLOCK_FACES_MESH_HPP_
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "BlocksMap.hpp"
+#include "BlocksMesh.hpp"
+#include "LightMap.hpp"
+
+// Compact alternative to BlocksMesh, with one 32-bit record per visible face instead of 4 vertices and 6 indices
+// The records are read by the vertex shader from a buffer texture, which expands each of them into a quad
+// Only full blocks (BakedModel::fullCube) can be expressed, blocks of other shapes are left out
+class BlockFacesMesh {
+public:
+  static constexpr int SECTION_SIZE = BlocksMesh::SECTION_SIZE;
+
+  // Layout of a face record from the lowest bit: x, y, z within the section (4 bits each), side (3 bits),
+  // sky light, block light (4 bits each), texture cell (9 bits, row major in the atlas)
+  static constexpr unsigned MAX_TEXTURE_CELLS = 1 << 9;
+  static uint32_t packFace(glm::ivec3 positionInSection, unsigned side, unsigned skyLight, unsigned blockLight, unsigned textureCell) {
+    return positionInSection.x | positionInSection.y << 4 | positionInSection.z << 8 | side << 12 | skyLight << 15 | blockLight << 19 | textureCell << 23;
+  }
+
+  // Like BlocksMesh::Section, the ranges are of faces, positions in the records are relative to origin
+  struct Section {
+    glm::vec3 center;
+    glm::ivec3 origin;
+    BlocksMesh::IndexRange opaque;
+    BlocksMesh::IndexRange cutout;
+  };
+
+  MeshVector<uint32_t> faces; // opaque ranges of all sections first, then the cutout ranges
+  std::vector<Section> sections; // only the ones with any faces
+
+  // Without a light map, everything is in full sky light
+  static BlockFacesMesh buildFromBlocksMap(const BlocksMap& blocksMap, const LightMap* lightMap = nullptr);
+  // Like BlocksMesh::rebuild(), reuses the memory of the previous build
+  void rebuild(const BlocksMap& blocksMap, const LightMap* lightMap = nullptr);
+
+private:
+  MeshVector<uint32_t> _cutoutFaces; // scratch
+};
+
+#endif
@@ -0,0 +1,145 @@
+#include <fstream>
+#include <sstream>
+#include <limits>
+#include <cstring>
+#include <cerrno>
+#include "BlockRegistry.hpp"
+
+BlockId BlockRegistry::add(std::unique_ptr<BlockType> type) {
+  if (_types.size() > std::numeric_limits<BlockId>::max()) {
+    throw BlockRegistryException("Too many block types");
+  }
+  if (_ids.count(type->blockId())) {
+    throw BlockRegistryException("Block type " + type->blockId() + " is defined more than once");
+  }
+
+  BlockId id = _types.size();
+  type->_id = id;
+  const BlockTypeAttributes& attributes = type->attributes();
+  _flags.push_back((attributes.transparent ? CUTOUT : OPAQUE) | (attributes.solid ? SOLID : 0));
+  _lightEmissions.push_back(attributes.lightEmission);
+  _scheduledTicks.emplace_back();
+  _randomTicks.emplace_back();
+  _ids.emplace(type->blockId(), id);
+  bake(*type);
+  _types.push_back(std::move(type));
+  return id;
+}
+
+void BlockRegistry::bake(const BlockType& type) {
+  BakedModel model;
+  model.firstFace = _bakedFaces.size();
+  model.faceCount = type.faces().size();
+  model.fullCube = type.faces().size() == FULL_BLOCK_FACE_VERTICES.size();
+  // Faces behind see-through blocks stay visible
+  model.sideCoverage = type.attributes().transparent ? std::array<SideMask, 6>{} : type.sideCoverage();
+
+  for (size_t i = 0; i < type.faces().size(); i++) {
+    const BlockFaceDefinition& face = type.faces()[i];
+    const StreamingTexturesPart& texturePart = *face.texturePartPtr();
+
+    BakedFace bakedFace;
+    bakedFace.firstVertex = _bakedVertices.size();
+    bakedFace.firstIndex = _bakedIndices.size();
+    bakedFace.vertexCount = face.vertices().size();
+    bakedFace.indexCount = face.vertexIndices().size();
+    bakedFace.cullSide = face.cullSide();
+    bakedFace.overlappedSubcells = face.overlappedSubcells();
+    bakedFace.textureX = texturePart.xLocation();
+    bakedFace.textureY = texturePart.yLocation();
+    bakedFace.textureCell = texturePart.yLocation() * texturePart.manager().cellCountPerSide() + texturePart.xLocation();
+    _bakedFaces.push_back(bakedFace);
+    _bakedVertices.insert(_bakedVertices.end(), face.vertices().begin(), face.vertices().end());
+    _bakedIndices.insert(_bakedIndices.end(), face.vertexIndices().begin(), face.vertexIndices().end());
+
+    if (face.side() != std::optional<uint8_t>(i)) model.fullCube = false;
+  }
+
+  _models.push_back(model);
+}
+
+void BlockRegistry::loadFromFile(const std::string& filename, StreamingTextures& textures, const std::string& texturesPath) {
+  std::ifstream file(filename);
+  if (!file.is_open()) {
+    std::string msg = strerror(errno);
+    throw BlockRegistryException("Cannot open block definitions " + filename + ": " + msg);
+  }
+
+  // Faces of different block types often share a texture, only load it once
+  std::unordered_map<std::string, std::shared_ptr<StreamingTexturesPart>> loadedTextures;
+  auto texture = [&] (const std::string& path) {
+    auto it = loadedTextures.find(path);
+    if (it == loadedTextures.end()) {
+      it = loadedTextures.emplace(path, textures.allocateFromFiles(std::vector<std::string>{texturesPath + "/" + path})).first;
+    }
+    return it->second;
+  };
+
+  std::string line;
+  for (size_t lineNumber = 1; std::getline(file, line); lineNumber++) {
+    line = line.substr(0, line.find('#'));
+    std::istringstream fields(line);
+    std::string blockId, flags;
+    int lightEmission;
+    if (!(fields >> blockId)) continue; // blank or comment
+    auto error = [&] (const std::string& msg) {
+      return BlockRegistryException(filename + ":" + std::to_string(lineNumber) + ": " + msg);
+    };
+    if (!(fields >> flags >> lightEmission)) {
+      throw error("expected <block id> <flags> <light emission> <textures>");
+    }
+
+    BlockTypeAttributes attributes{.transparent = false};
+    if (flags != "-") {
+      std::istringstream flagList(flags);
+      std::string flag;
+      while (std::getline(flagList, flag, ',')) {
+        if (flag == "transparent") {
+          attributes.transparent = true;
+        } else if (flag == "nonsolid") {
+          attributes.solid = false;
+        } else {
+          throw error("unknown flag " + flag);
+        }
+      }
+    }
+    if (lightEmission < 0 || lightEmission > 15) {
+      throw error("light emission must be between 0 and 15");
+    }
+    attributes.lightEmission = lightEmission;
+
+    std::vector<std::string> texturePaths;
+    for (std::string path; fields >> path;) {
+      texturePaths.push_back(path);
+    }
+    if (texturePaths.size() != 1 && texturePaths.size() != 6) {
+      throw error("expected 1 texture for all faces or 6 textures, got " + std::to_string(texturePaths.size()));
+    }
+    std::array<std::shared_ptr<StreamingTexturesPart>, 6> faceTextures;
+    for (size_t i = 0; i < faceTextures.size(); i++) {
+      faceTextures[i] = texture(texturePaths[texturePaths.size() == 1 ? 0 : i]);
+    }
+
+    if (_ids.count(blockId)) {
+      throw error("block type " + blockId + " is defined more than once");
+    }
+    add(std::make_unique<BlockType>(std::move(blockId), std::move(attributes), std::move(faceTextures)));
+  }
+}
+
+void BlockRegistry::randomTick(BlockId id, BlockTickCallback callback) {
+  if (callback) {
+    _flags[id] |= RANDOM_TICKS;
+  } else {
+    _flags[id] &= ~RANDOM_TICKS;
+  }
+  _randomTicks[id] = std::move(callback);
+}
+
+BlockId BlockRegistry::id(const std::string& blockId) const {
+  auto it = _ids.find(blockId);
+  if (it == _ids.end()) {
+    throw BlockRegistryException("Unknown block type " + blockId);
+  }
+  return it->second;
+}
@@ -0,0 +1,116 @@
+#ifndef _BLOCK_REGISTRY_HPP_
+#define _BLOCK_REGISTRY_HPP_
+#include <string>
+#include <vector>
+#include <array>
+#include <memory>
+#include <unordered_map>
+#include <functional>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "ApplicationException.hpp"
+#include "BlockType.hpp"
+#include "StreamingTextures.hpp"
+
+class Block;
+class BlockTickContext;
+
+// Behaviour of a block type when its block is updated by BlockTickScheduler, called with the position and the block there
+using BlockTickCallback = std::function<void(BlockTickContext& context, glm::ivec3 position, const Block& block)>;
+
+// Flattened copy of a face of a block type, pointing into BlockRegistry's baked tables
+struct BakedFace {
+  uint32_t firstVertex;
+  uint32_t firstIndex; // indices are relative to the face's first vertex
+  uint8_t vertexCount;
+  uint8_t indexCount;
+  int8_t cullSide; // side of the block (X+, X-, Y+, Y-, Z+, Z-) the face lies on, where a neighbour can hide it, -1 if it doesn't lie on one
+  SideMask overlappedSubcells; // of the cull side, the face is hidden if the neighbour covers all of them
+  uint16_t textureX, textureY; // location of the texture in the atlas
+  uint16_t textureCell; // same as a row major index
+};
+
+// The faces of a block type, a run of BlockRegistry's baked faces
+struct BakedModel {
+  uint32_t firstFace;
+  uint16_t faceCount;
+  bool fullCube; // the 6 faces of a full block in side order, which the mesher emits from FULL_BLOCK_FACE_VERTICES instead
+  std::array<SideMask, 6> sideCoverage; // subcells of each side which hide the faces of neighbours, none for transparent blocks
+};
+
+// All block types of the game, numbered with dense IDs in the order they are added
+// The attributes read in hot loops (meshing, lighting, collision) are copied into flat arrays indexed by ID, so that querying them does not go through the BlockType
+class BlockRegistry {
+private:
+  enum Flag : uint8_t {
+    OPAQUE = 1 << 0,
+    CUTOUT = 1 << 1,
+    SOLID = 1 << 2,
+    RANDOM_TICKS = 1 << 3,
+  };
+
+  std::vector<std::unique_ptr<BlockType>> _types;
+  std::unordered_map<std::string, BlockId> _ids;
+  std::vector<uint8_t> _flags;
+  std::vector<uint8_t> _lightEmissions;
+  std::vector<BlockTickCallback> _scheduledTicks;
+  std::vector<BlockTickCallback> _randomTicks;
+
+  // The faces of all block types baked into contiguous tables, so that meshing does not chase the pointers in BlockType
+  std::vector<BakedModel> _models;
+  std::vector<BakedFace> _bakedFaces;
+  std::vector<BlockVertex> _bakedVertices;
+  std::vector<GLuint> _bakedIndices;
+
+  void bake(const BlockType& type);
+
+public:
+  BlockRegistry() = default;
+  BlockRegistry(const BlockRegistry&) = delete;
+  BlockRegistry& operator=(const BlockRegistry&) = delete;
+
+  // Register a block type and assign it the next ID
+  BlockId add(std::unique_ptr<BlockType> type);
+
+  // Add the block types defined in a file, texture paths in it are relative to texturesPath
+  // Each line is "<block id> <flags> <light emission> <textures>", see blocks.txt
+  void loadFromFile(const std::string& filename, StreamingTextures& textures, const std::string& texturesPath);
+
+  size_t size() const { return _types.size(); }
+  BlockType& type(BlockId id) const { return *_types[id]; }
+  // Throws BlockRegistryException for unknown block IDs
+  BlockId id(const std::string& blockId) const;
+
+  // Hides the faces of neighbouring blocks and stops light
+  bool opaque(BlockId id) const { return _flags[id] & OPAQUE; }
+  // Has see-through pixels, drawn with alpha testing
+  bool cutout(BlockId id) const { return _flags[id] & CUTOUT; }
+  // Entities collide with it
+  bool solid(BlockId id) const { return _flags[id] & SOLID; }
+  uint8_t lightEmission(BlockId id) const { return _lightEmissions[id]; }
+
+  // Called when an update scheduled at a block of the type is due, empty if the type has no scheduled updates
+  const BlockTickCallback& scheduledTick(BlockId id) const { return _scheduledTicks[id]; }
+  void scheduledTick(BlockId id, BlockTickCallback callback) { _scheduledTicks[id] = std::move(callback); }
+  // Called when a block of the type is picked by the random ticks
+  const BlockTickCallback& randomTick(BlockId id) const { return _randomTicks[id]; }
+  void randomTick(BlockId id, BlockTickCallback callback);
+  bool randomTicks(BlockId id) const { return _flags[id] & RANDOM_TICKS; }
+  SideMask sideCoverage(BlockId id, int side) const { return _models[id].sideCoverage[side]; }
+  // Whether a face on the side of a block, overlapping the subcells, is hidden by the block of type id next to it
+  bool hidesFace(BlockId id, int side, SideMask overlappedSubcells) const {
+    // Opposite sides only differ in the lowest bit
+    return (overlappedSubcells & ~sideCoverage(id, side ^ 1)) == 0;
+  }
+
+  const BakedModel& model(BlockId id) const { return _models[id]; }
+  const std::vector<BakedFace>& bakedFaces() const { return _bakedFaces; }
+  const std::vector<BlockVertex>& bakedVertices() const { return _bakedVertices; }
+  const std::vector<GLuint>& bakedIndices() const { return _bakedIndices; }
+};
+
+class BlockRegistryException : public ApplicationException {
+  using ApplicationException::ApplicationException;
+};
+
+#endif
@@ -0,0 +1,149 @@
+#include <algorithm>
+#include "BlockTickScheduler.hpp"
+
+namespace {
+
+const glm::ivec3 NEIGHBOR_DIRECTIONS[6] = {
+  {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1},
+};
+
+// SplitMix64, small state and good enough for picking blocks
+uint64_t nextRandom(uint64_t& state) {
+  uint64_t z = (state += 0x9e3779b97f4a7c15u);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9u;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebu;
+  return z ^ (z >> 31);
+}
+
+}
+
+BlockTickScheduler::BlockTickScheduler(BlocksMap& blocksMap_, uint64_t seed) : _blocksMap(blocksMap_) {
+  _regionCount = (glm::ivec2(_blocksMap.size.x, _blocksMap.size.z) + REGION_SIZE - 1) / REGION_SIZE;
+  _regions.resize(_regionCount.x * _regionCount.y);
+  for (int regionZ = 0; regionZ < _regionCount.y; regionZ++) {
+    for (int regionX = 0; regionX < _regionCount.x; regionX++) {
+      size_t index = regionZ * _regionCount.x + regionX;
+      Region& region = _regions[index];
+      region.min = _blocksMap.basePosition + glm::ivec3(regionX * REGION_SIZE, 0, regionZ * REGION_SIZE);
+      region.max = glm::min(region.min + glm::ivec3(REGION_SIZE, _blocksMap.size.y, REGION_SIZE), _blocksMap.basePosition + _blocksMap.size);
+      region.randomState = seed ^ (index * 0x2545f4914f6cdd1du);
+      _phases[(regionZ % 2) * 2 + regionX % 2].push_back(index);
+    }
+  }
+}
+
+BlockTickScheduler::Region* BlockTickScheduler::regionAt(glm::ivec3 position) {
+  glm::ivec3 internalPosition = position - _blocksMap.basePosition;
+  if ((unsigned) internalPosition.x >= (unsigned) _blocksMap.size.x ||
+      (unsigned) internalPosition.y >= (unsigned) _blocksMap.size.y ||
+      (unsigned) internalPosition.z >= (unsigned) _blocksMap.size.z) {
+    return nullptr;
+  }
+  return &_regions[(internalPosition.z / REGION_SIZE) * _regionCount.x + internalPosition.x / REGION_SIZE];
+}
+
+void BlockTickScheduler::schedule(glm::ivec3 position, uint32_t delay) {
+  if (Region* target = regionAt(position)) {
+    target->scheduled.push(ScheduledUpdate{_tickCount + std::max<uint32_t>(delay, 1), position});
+  }
+}
+
+void BlockTickScheduler::blockChanged(glm::ivec3 position) {
+  const BlockRegistry& registry = _blocksMap.registry();
+  for (const glm::ivec3& direction : NEIGHBOR_DIRECTIONS) {
+    glm::ivec3 neighbor = position + direction;
+    const Block* block = _blocksMap.get(neighbor);
+    if (block && registry.scheduledTick(block->id())) {
+      schedule(neighbor, 1);
+    }
+  }
+}
+
+void BlockTickScheduler::tick(ThreadPool* threadPool) {
+  _tickCount++;
+  for (const std::vector<size_t>& phase : _phases) {
+    if (threadPool) {
+      threadPool->run(phase.size(), [this, &phase] (size_t i) {
+        updateRegion(_regions[phase[i]]);
+      });
+    } else {
+      for (size_t index : phase) {
+        updateRegion(_regions[index]);
+      }
+    }
+
+    // Later phases see the changes of the earlier ones
+    for (size_t index : phase) {
+      applyChanges(_regions[index]);
+    }
+  }
+}
+
+void BlockTickScheduler::updateRegion(Region& region) {
+  const BlockRegistry& registry = _blocksMap.registry();
+  BlockTickContext context(*this, region);
+
+  while (!region.scheduled.empty() && region.scheduled.top().tick <= _tickCount) {
+    glm::ivec3 position = region.scheduled.top().position;
+    region.scheduled.pop();
+    // Neighbours changing at once schedule the same update more than once
+    while (!region.scheduled.empty() && region.scheduled.top().tick <= _tickCount && region.scheduled.top().position == position) {
+      region.scheduled.pop();
+    }
+    // The block may have changed since the update was scheduled, it is up to the current one
+    const Block* block = _blocksMap.get(position);
+    if (block && registry.scheduledTick(block->id())) {
+      registry.scheduledTick(block->id())(context, position, *block);
+    }
+  }
+
+  glm::ivec3 size = region.max - region.min;
+  int sectionCount = (size.y + REGION_SIZE - 1) / REGION_SIZE;
+  for (int section = 0; section < sectionCount; section++) {
+    for (int i = 0; i < RANDOM_TICKS_PER_SECTION; i++) {
+      uint64_t r = nextRandom(region.randomState);
+      glm::ivec3 position = region.min + glm::ivec3(
+        (r & 0xffff) % size.x,
+        section * REGION_SIZE + ((r >> 16) & 0xffff) % REGION_SIZE,
+        ((r >> 32) & 0xffff) % size.z);
+      if (position.y >= region.max.y) continue;
+      const Block* block = _blocksMap.get(position);
+      if (block && registry.randomTicks(block->id())) {
+        registry.randomTick(block->id())(context, position, *block);
+      }
+    }
+  }
+}
+
+void BlockTickScheduler::applyChanges(Region& region) {
+  for (const Change& change : region.changes) {
+    if (!regionAt(change.position)) continue;
+    const Block* current = _blocksMap.get(change.position);
+    bool unchanged = current ? (change.block && change.block->id() == current->id()) : !change.block;
+    if (unchanged) continue;
+    _blocksMap.set(change.position, change.block);
+    _changedPositions.push_back(change.position);
+    blockChanged(change.position);
+  }
+  region.changes.clear();
+
+  for (const ScheduledUpdate& update : region.outgoing) {
+    if (Region* target = regionAt(update.position)) {
+      target->scheduled.push(update);
+    }
+  }
+  region.outgoing.clear();
+}
+
+void BlockTickScheduler::takeChangedPositions(std::vector<glm::ivec3>& positions) {
+  positions.insert(positions.end(), _changedPositions.begin(), _changedPositions.end());
+  _changedPositions.clear();
+}
+
+void BlockTickContext::schedule(glm::ivec3 position, uint32_t delay) {
+  _region.outgoing.push_back({_scheduler._tickCount + std::max<uint32_t>(delay, 1), position});
+}
+
+uint32_t BlockTickContext::random() {
+  return nextRandom(_region.randomState);
+}
@@ -0,0 +1,109 @@
+#ifndef _BLOCK_TICK_SCHEDULER_HPP_
+#define _BLOCK_TICK_SCHEDULER_HPP_
+#include <vector>
+#include <array>
+#include <queue>
+#include <optional>
+#include <functional>
+#include <tuple>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "BlocksMap.hpp"
+#include "ThreadPool.hpp"
+
+// Runs the block simulation: updates scheduled by position and tick, and random ticks
+// The map is split into full height columns of REGION_SIZE x REGION_SIZE, each with its own queue of scheduled updates and random generator
+// Regions are processed in 4 phases of a checkerboard, so that the regions of a phase are at least REGION_SIZE apart and can run in parallel
+class BlockTickScheduler {
+public:
+  static constexpr int REGION_SIZE = 16;
+  // Updates may read any cell, but must only change and schedule cells up to this far from the updated block,
+  // so that two regions of the same phase never write the same cell
+  static constexpr int MAX_REACH = REGION_SIZE / 2 - 1;
+  // Blocks picked at random in every 16^3 cube of a region on each tick
+  static constexpr int RANDOM_TICKS_PER_SECTION = 3;
+
+private:
+  friend class BlockTickContext;
+
+  struct ScheduledUpdate {
+    uint64_t tick;
+    glm::ivec3 position;
+
+    // Also ordered by position, so that the same update scheduled several times comes out in a row
+    bool operator>(const ScheduledUpdate& other) const {
+      return std::tie(tick, position.x, position.y, position.z) > std::tie(other.tick, other.position.x, other.position.y, other.position.z);
+    }
+  };
+  struct Change {
+    glm::ivec3 position;
+    std::optional<Block> block;
+  };
+
+  struct Region {
+    glm::ivec3 min; // in world space, the max is REGION_SIZE further or the end of the map
+    glm::ivec3 max;
+    std::priority_queue<ScheduledUpdate, std::vector<ScheduledUpdate>, std::greater<ScheduledUpdate>> scheduled; // earliest first
+    uint64_t randomState;
+
+    // Made by the updates of the current phase, applied when all regions of the phase are done
+    std::vector<Change> changes;
+    std::vector<ScheduledUpdate> outgoing;
+  };
+
+  BlocksMap& _blocksMap;
+  glm::ivec2 _regionCount; // along x and z
+  std::vector<Region> _regions;
+  std::array<std::vector<size_t>, 4> _phases; // region indices of each checkerboard color
+  uint64_t _tickCount = 0;
+  std::vector<glm::ivec3> _changedPositions; // since the last takeChangedPositions()
+
+  Region* regionAt(glm::ivec3 position);
+  void updateRegion(Region& region);
+  void applyChanges(Region& region);
+
+public:
+  BlockTickScheduler(BlocksMap& blocksMap_, uint64_t seed = 0);
+
+  BlockTickScheduler(const BlockTickScheduler&) = delete;
+  BlockTickScheduler& operator=(const BlockTickScheduler&) = delete;
+
+  uint64_t tickCount() const { return _tickCount; }
+
+  // Update the block at position after delay ticks (at least 1), if its type has a scheduled tick callback then
+  void schedule(glm::ivec3 position, uint32_t delay);
+  // Tell the blocks around a block changed outside of the ticks, schedules the ones that react to their neighbours
+  void blockChanged(glm::ivec3 position);
+
+  // Run one tick of scheduled and random updates, using the thread pool for the regions of a phase if there is one
+  void tick(ThreadPool* threadPool = nullptr);
+
+  // Append the positions of the blocks changed by the ticks since the last call, to be relit and remeshed
+  void takeChangedPositions(std::vector<glm::ivec3>& positions);
+};
+
+// What an update can see and do, its changes take effect at the end of the phase
+class BlockTickContext {
+private:
+  friend class BlockTickScheduler;
+
+  BlockTickScheduler& _scheduler;
+  BlockTickScheduler::Region& _region;
+
+  BlockTickContext(BlockTickScheduler& scheduler_, BlockTickScheduler::Region& region_) : _scheduler(scheduler_), _region(region_) {}
+
+public:
+  const BlocksMap& blocksMap() const { return _scheduler._blocksMap; }
+  const BlockRegistry& registry() const { return _scheduler._blocksMap.registry(); }
+  uint64_t tickCount() const { return _scheduler._tickCount; }
+
+  const Block* get(glm::ivec3 position) const { return _scheduler._blocksMap.get(position); }
+  // Place a block, or remove it with an empty optional
+  void set(glm::ivec3 position, const std::optional<Block>& block) { _region.changes.push_back({position, block}); }
+  void schedule(glm::ivec3 position, uint32_t delay);
+
+  // From the generator of the region, so that the simulation does not depend on the number of threads
+  uint32_t random();
+};
+
+#endif
@@ -1,22 +1,101 @@
+#include <algorithm>
+#include <cmath>
 #include <GL/glew.h>
+#include <glm/glm.hpp>
 #include "BlockType.hpp"
 
-BlockFaceDefinition::BlockFaceDefinition(std::vector<BlockVertex>&& vertices_, std::vector<GLuint>&& vertexIndices_, std::shared_ptr<StreamingTexturesPart> texturePartPtr_) {
+namespace {
+
+// Tolerance for vertices to count as lying on a boundary
+const float EPSILON = 1e-4f;
+
+// The side of the block whose boundary all vertices are at or beyond, -1 if there is none
+int8_t findCullSide(const std::vector<BlockVertex>& vertices) {
+  auto allVertices = [&vertices] (auto predicate) { return std::all_of(vertices.begin(), vertices.end(), predicate); };
+  if (allVertices([] (const BlockVertex& vertex) { return vertex.x >= 0.5f; })) return 0;
+  if (allVertices([] (const BlockVertex& vertex) { return vertex.x <= -0.5f; })) return 1;
+  if (allVertices([] (const BlockVertex& vertex) { return vertex.y >= 0.5f; })) return 2;
+  if (allVertices([] (const BlockVertex& vertex) { return vertex.y <= -0.5f; })) return 3;
+  if (allVertices([] (const BlockVertex& vertex) { return vertex.z >= 0.5f; })) return 4;
+  if (allVertices([] (const BlockVertex& vertex) { return vertex.z <= -0.5f; })) return 5;
+  return -1;
+}
+
+// Position of a vertex on the plane of a side, in subcells from the corner of the side
+glm::vec2 sidePlanePosition(const BlockVertex& vertex, int side) {
+  const float position[3] = {vertex.x, vertex.y, vertex.z};
+  int axis = side / 2;
+  int uAxis = axis == 0 ? 1 : 0;
+  int vAxis = axis == 2 ? 1 : 2;
+  return (glm::vec2(position[uAxis], position[vAxis]) + 0.5f) * (float) SIDE_SUBCELLS;
+}
+
+// The subcells in the rectangle from min (inclusive) to max (exclusive)
+SideMask subcellRectangle(glm::ivec2 min, glm::ivec2 max) {
+  min = glm::clamp(min, 0, SIDE_SUBCELLS);
+  max = glm::clamp(max, 0, SIDE_SUBCELLS);
+  SideMask mask = 0;
+  for (int v = min.y; v < max.y; v++) {
+    for (int u = min.x; u < max.x; u++) {
+      mask |= 1 << (v * SIDE_SUBCELLS + u);
+    }
+  }
+  return mask;
+}
+
+}
+
+BlockFaceDefinition::BlockFaceDefinition(std::vector<BlockVertex>&& vertices_, std::vector<GLuint>&& vertexIndices_, std::shared_ptr<StreamingTexturesPart> texturePartPtr_, std::optional<uint8_t> side_) {
   _vertices = vertices_;
   _vertexIndices = vertexIndices_;
   _texturePartPtr = texturePartPtr_;
+  _side = side_;
 
   // Allow the shader to adjust texture coordinates according to the StreamingTexturesPart
   for (BlockVertex& vertex : _vertices) {
     vertex.tx = _texturePartPtr->xLocation();
     vertex.ty = _texturePartPtr->yLocation();
   }
+
+  _cullSide = _side ? *_side : findCullSide(_vertices);
+  if (_cullSide < 0 || _vertices.empty()) return;
+
+  glm::vec2 min = sidePlanePosition(_vertices[0], _cullSide);
+  glm::vec2 max = min;
+  for (const BlockVertex& vertex : _vertices) {
+    min = glm::min(min, sidePlanePosition(vertex, _cullSide));
+    max = glm::max(max, sidePlanePosition(vertex, _cullSide));
+  }
+  _overlappedSubcells = subcellRectangle(glm::ivec2(glm::floor(min + EPSILON)), glm::ivec2(glm::ceil(max - EPSILON)));
+
+  // A quad with a vertex on each corner of its bounding box fills the box
+  unsigned corners = 0;
+  for (const BlockVertex& vertex : _vertices) {
+    glm::vec2 position = sidePlanePosition(vertex, _cullSide);
+    bool atMinX = std::abs(position.x - min.x) < EPSILON, atMaxX = std::abs(position.x - max.x) < EPSILON;
+    bool atMinY = std::abs(position.y - min.y) < EPSILON, atMaxY = std::abs(position.y - max.y) < EPSILON;
+    if ((atMinX || atMaxX) && (atMinY || atMaxY)) {
+      corners |= 1 << (atMaxX + 2 * atMaxY);
+    }
+  }
+  if (_vertices.size() == 4 && corners == 0xf) {
+    _coveredSubcells = subcellRectangle(glm::ivec2(glm::ceil(min - EPSILON)), glm::ivec2(glm::floor(max + EPSILON)));
+  }
+}
+
+std::array<SideMask, 6> BlockType::coverageOfFaces(const std::vector<BlockFaceDefinition>& faces) {
+  std::array<SideMask, 6> coverage = {};
+  for (const BlockFaceDefinition& face : faces) {
+    if (face.cullSide() >= 0) coverage[face.cullSide()] |= face.coveredSubcells();
+  }
+  return coverage;
 }
 
-BlockType::BlockType(std::string&& blockId_, BlockTypeAttributes&& attributes_, std::vector<BlockFaceDefinition>&& faces_) {
+BlockType::BlockType(std::string&& blockId_, BlockTypeAttributes&& attributes_, std::vector<BlockFaceDefinition>&& faces_, std::optional<std::array<SideMask, 6>> sideCoverage_) {
   _blockId = blockId_;
   _attributes = attributes_;
   _faces = faces_;
+  _sideCoverage = sideCoverage_ ? *sideCoverage_ : coverageOfFaces(_faces);
 }
 
 BlockType::BlockType(std::string&& blockId_, BlockTypeAttributes&& attributes_, std::array<std::shared_ptr<StreamingTexturesPart>, 6>&& faceTextures) {
@@ -28,57 +107,13 @@ BlockType::BlockType(std::string&& blockId_, BlockTypeAttributes&& attributes_,
   _faces = std::vector<BlockFaceDefinition>();
   _faces.reserve(6);
 
-  const std::array<std::array<BlockVertex, 4>, 6> predefinedFullBlockFaceVertices = {{
-    // X+
-    {{
-      { 0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f, 0.f, 0.f},
-      { 0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f, 1.f, 0.f},
-      { 0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f, 0.f, 1.f},
-      { 0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f, 1.f, 1.f},
-    }},
-    // X-
-    {{
-      {-0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f, 0.f, 0.f},
-      {-0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f, 1.f, 0.f},
-      {-0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f, 0.f, 1.f},
-      {-0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f, 1.f, 1.f},
-    }},
-    // Y+
-    {{
-      {-0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f, 0.f, 0.f},
-      { 0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f, 1.f, 0.f},
-      {-0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f, 0.f, 1.f},
-      { 0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f, 1.f, 1.f},
-    }},
-    // Y-
-    {{
-      { 0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f, 0.f, 0.f},
-      {-0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f, 1.f, 0.f},
-      { 0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f, 0.f, 1.f},
-      {-0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f, 1.f, 1.f},
-    }},
-    // Z+
-    {{
-      {-0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f, 0.f, 0.f},
-      { 0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f, 1.f, 0.f},
-      {-0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f, 0.f, 1.f},
-      { 0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f, 1.f, 1.f},
-    }},
-    // Z-
-    {{
-      { 0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f, 0.f, 0.f},
-      {-0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f, 1.f, 0.f},
-      { 0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f, 0.f, 1.f},
-      {-0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f, 1.f, 1.f},
-    }},
-  }};
-
-  for (size_t i = 0; i < predefinedFullBlockFaceVertices.size(); i++) {
+  for (size_t i = 0; i < FULL_BLOCK_FACE_VERTICES.size(); i++) {
     std::vector<BlockVertex> faceVertices;
     faceVertices.reserve(4);
-    for (const BlockVertex& predefinedFaceVertex : predefinedFullBlockFaceVertices[i]) {
+    for (const BlockVertex& predefinedFaceVertex : FULL_BLOCK_FACE_VERTICES[i]) {
       faceVertices.push_back(predefinedFaceVertex);
     }
-    _faces.push_back(BlockFaceDefinition(std::move(faceVertices), std::vector<GLuint>{0, 1, 2, 1, 3, 2}, faceTextures[i]));
+    _faces.push_back(BlockFaceDefinition(std::move(faceVertices), std::vector<GLuint>(FULL_BLOCK_FACE_INDICES.begin(), FULL_BLOCK_FACE_INDICES.end()), faceTextures[i], i));
   }
+  _sideCoverage.fill(FULL_SIDE_MASK);
 }
@@ -4,50 +4,132 @@
 #include <array>
 #include <vector>
 #include <memory>
+#include <cstdint>
+#include <optional>
 #include <GL/glew.h>
 #include "StreamingTextures.hpp"
 
+// Dense numeric ID of a block type, assigned by BlockRegistry
+using BlockId = uint16_t;
+
 struct BlockVertex {
   float x, y, z;
   float nx, ny, nz;
   float u, v;
   GLuint tx, ty;
+  float skyLight, blockLight; // 0 to 1, filled in by BlocksMesh
 };
 
+// Faces of a full block, in X+, X-, Y+, Y-, Z+, Z- order
+inline constexpr std::array<std::array<BlockVertex, 4>, 6> FULL_BLOCK_FACE_VERTICES = {{
+  // X+
+  {{
+    { 0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f, 0.f, 0.f},
+    { 0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f, 1.f, 0.f},
+    { 0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f, 0.f, 1.f},
+    { 0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f, 1.f, 1.f},
+  }},
+  // X-
+  {{
+    {-0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f, 0.f, 0.f},
+    {-0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f, 1.f, 0.f},
+    {-0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f, 0.f, 1.f},
+    {-0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f, 1.f, 1.f},
+  }},
+  // Y+
+  {{
+    {-0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f, 0.f, 0.f},
+    { 0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f, 1.f, 0.f},
+    {-0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f, 0.f, 1.f},
+    { 0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f, 1.f, 1.f},
+  }},
+  // Y-
+  {{
+    { 0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f, 0.f, 0.f},
+    {-0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f, 1.f, 0.f},
+    { 0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f, 0.f, 1.f},
+    {-0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f, 1.f, 1.f},
+  }},
+  // Z+
+  {{
+    {-0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f, 0.f, 0.f},
+    { 0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f, 1.f, 0.f},
+    {-0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f, 0.f, 1.f},
+    { 0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f, 1.f, 1.f},
+  }},
+  // Z-
+  {{
+    { 0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f, 0.f, 0.f},
+    {-0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f, 1.f, 0.f},
+    { 0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f, 0.f, 1.f},
+    {-0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f, 1.f, 1.f},
+  }},
+}};
+inline constexpr std::array<GLuint, 6> FULL_BLOCK_FACE_INDICES = {0, 1, 2, 1, 3, 2};
+
+// Each side of the unit cube is divided into SIDE_SUBCELLS^2 subcells for occlusion tests, a mask has a bit for each of them (row major)
+// The rows and columns of a side go along the other two axes in x, y, z order, so that opposite sides of neighbouring blocks line up
+inline constexpr int SIDE_SUBCELLS = 4;
+using SideMask = uint16_t;
+inline constexpr SideMask FULL_SIDE_MASK = 0xffff;
+
 // Definition of each face on the block
 class BlockFaceDefinition {
 private:
   std::vector<BlockVertex> _vertices;
   std::vector<GLuint> _vertexIndices;
   std::shared_ptr<StreamingTexturesPart> _texturePartPtr;
+  std::optional<uint8_t> _side;
+  int8_t _cullSide;
+  SideMask _overlappedSubcells = 0;
+  SideMask _coveredSubcells = 0;
 
 public:
-  BlockFaceDefinition(std::vector<BlockVertex>&& vertices_, std::vector<GLuint>&& vertexIndices_, std::shared_ptr<StreamingTexturesPart> texturePartPtr_);
+  BlockFaceDefinition(std::vector<BlockVertex>&& vertices_, std::vector<GLuint>&& vertexIndices_, std::shared_ptr<StreamingTexturesPart> texturePartPtr_, std::optional<uint8_t> side_ = std::nullopt);
 
   const std::vector<BlockVertex>& vertices() const { return _vertices; }
   const std::vector<GLuint>& vertexIndices() const { return _vertexIndices; }
   std::shared_ptr<StreamingTexturesPart> texturePartPtr() const { return _texturePartPtr; }
+  // Index of the side of the unit cube this face covers exactly as a full block face (X+, X-, Y+, Y-, Z+, Z-), if it does
+  const std::optional<uint8_t>& side() const { return _side; }
+  // The side of the unit cube the face lies on, where a neighbouring block can hide it, -1 if it doesn't lie on one
+  int8_t cullSide() const { return _cullSide; }
+  // Subcells of the cull side the face has any part in, and the ones it covers completely, which is only known for rectangles
+  SideMask overlappedSubcells() const { return _overlappedSubcells; }
+  SideMask coveredSubcells() const { return _coveredSubcells; }
 };
 
 struct BlockTypeAttributes {
   bool transparent; // there are transparent pixels in the texture
+  uint8_t lightEmission = 0; // block light level given off, up to LightMap::MAX_LIGHT
+  bool solid = true; // entities collide with it
 };
 
 // A type of block that could exist in the game
 class BlockType {
 private:
   std::string _blockId;
+  BlockId _id = 0;
   BlockTypeAttributes _attributes;
   std::vector<BlockFaceDefinition> _faces;
+  std::array<SideMask, 6> _sideCoverage;
+
+  static std::array<SideMask, 6> coverageOfFaces(const std::vector<BlockFaceDefinition>& faces);
 
 public:
-  BlockType(std::string&& blockId_, BlockTypeAttributes&& attributes_, std::vector<BlockFaceDefinition>&& faces_);
+  // Without sideCoverage_, the coverage is what the faces on each side cover
+  BlockType(std::string&& blockId_, BlockTypeAttributes&& attributes_, std::vector<BlockFaceDefinition>&& faces_, std::optional<std::array<SideMask, 6>> sideCoverage_ = std::nullopt);
   // Convenience function of defining a 6-faced full block
   BlockType(std::string&& blockId_, BlockTypeAttributes&& attributes_, std::array<std::shared_ptr<StreamingTexturesPart>, 6>&& faceTextures);
 
   const std::string& blockId() const { return _blockId; }
+  BlockId id() const { return _id; }
   const BlockTypeAttributes& attributes() const { return _attributes; }
   const std::vector<BlockFaceDefinition>& faces() const { return _faces; };
+  // Subcells of each side that the block fills from edge to edge, the faces of a neighbour behind them are hidden if the block is opaque
+  const std::array<SideMask, 6>& sideCoverage() const { return _sideCoverage; }
+
+  friend class BlockRegistry;
 };
 
 #endif
@@ -1,13 +1,17 @@
 #include <stdexcept>
+#include <algorithm>
 #include "BlocksMap.hpp"
 
-BlocksMap::BlocksMap(glm::ivec3 basePosition_, glm::ivec3 size_) {
+BlocksMap::BlocksMap(const BlockRegistry& registry_, glm::ivec3 basePosition_, glm::ivec3 size_) : _registry(registry_) {
   basePosition = basePosition_;
   size = size_;
   storage.resize(size.x * size.y * size.z);
+  _solidBits.resize((storage.size() + 63) / 64);
+  _brickCount = (size + BRICK_SIZE - 1) / BRICK_SIZE;
+  _brickBlockCounts.resize(_brickCount.x * _brickCount.y * _brickCount.z);
 }
 
-std::optional<Block>& BlocksMap::operator[](glm::ivec3 position) {
+const std::optional<Block>& BlocksMap::operator[](glm::ivec3 position) const {
   std::optional<size_t> storageLocation = calculateStorageLocation(position);
   if (storageLocation) {
     return storage[*storageLocation];
@@ -16,13 +20,160 @@ std::optional<Block>& BlocksMap::operator[](glm::ivec3 position) {
   }
 }
 
-const std::optional<Block>& BlocksMap::operator[](glm::ivec3 position) const {
+void BlocksMap::set(glm::ivec3 position, const std::optional<Block>& block) {
   std::optional<size_t> storageLocation = calculateStorageLocation(position);
-  if (storageLocation) {
-    return storage[*storageLocation];
-  } else {
+  if (!storageLocation) {
     throw std::out_of_range("position is outside of the BlocksMap");
   }
+
+  std::optional<Block>& element = storage[*storageLocation];
+  bool wasOccupied = element.has_value();
+  element = block;
+
+  uint64_t bit = uint64_t(1) << (*storageLocation % 64);
+  if (block && _registry.solid(block->id())) {
+    _solidBits[*storageLocation / 64] |= bit;
+  } else {
+    _solidBits[*storageLocation / 64] &= ~bit;
+  }
+
+  if (block.has_value() != wasOccupied) {
+    glm::ivec3 brick = (position - basePosition) / BRICK_SIZE;
+    uint8_t& brickBlockCount = _brickBlockCounts[(brick.y * _brickCount.z + brick.z) * _brickCount.x + brick.x];
+    if (block) {
+      brickBlockCount++;
+    } else {
+      brickBlockCount--;
+    }
+  }
+
+  if (_observer) _observer->blocksChanged(*this, BlocksRegion{position, position + 1});
+}
+
+BlocksRegion BlocksMap::clip(const BlocksRegion& region) const {
+  BlocksRegion clipped{glm::max(region.min, basePosition), glm::min(region.max, basePosition + size)};
+  // Keep empty regions from having a negative extent
+  clipped.max = glm::max(clipped.max, clipped.min);
+  return clipped;
+}
+
+BlocksRegion BlocksMap::fill(const BlocksRegion& region, const std::optional<Block>& block) {
+  BlocksRegion clipped = clip(region);
+  if (clipped.empty()) return clipped;
+
+  bool solid = block && _registry.solid(block->id());
+  glm::ivec3 min = clipped.min - basePosition;
+  glm::ivec3 max = clipped.max - basePosition;
+  for (int y = min.y; y < max.y; y++) {
+    for (int z = min.z; z < max.z; z++) {
+      size_t rowStart = (y * size.z + z) * size.x;
+      std::fill(storage.begin() + rowStart + min.x, storage.begin() + rowStart + max.x, block);
+      setSolidBits(rowStart + min.x, rowStart + max.x, solid);
+    }
+  }
+  recountBricks(clipped);
+  if (_observer) _observer->blocksChanged(*this, clipped);
+  return clipped;
+}
+
+BlocksRegion BlocksMap::replace(const BlocksRegion& region, BlockId from, const std::optional<Block>& to) {
+  BlocksRegion clipped = clip(region);
+  if (clipped.empty()) return clipped;
+
+  glm::ivec3 min = clipped.min - basePosition;
+  glm::ivec3 max = clipped.max - basePosition;
+  for (int y = min.y; y < max.y; y++) {
+    for (int z = min.z; z < max.z; z++) {
+      size_t rowStart = (y * size.z + z) * size.x;
+      std::replace_if(storage.begin() + rowStart + min.x, storage.begin() + rowStart + max.x, [from] (const std::optional<Block>& block) {
+        return block && block->id() == from;
+      }, to);
+    }
+  }
+  updateSolidBits(clipped);
+  recountBricks(clipped);
+  if (_observer) _observer->blocksChanged(*this, clipped);
+  return clipped;
+}
+
+BlocksMap BlocksMap::copy(const BlocksRegion& region) const {
+  BlocksMap copied(_registry, region.min, glm::max(region.max - region.min, glm::ivec3(0)));
+  copied.paste(*this, basePosition);
+  return copied;
+}
+
+BlocksRegion BlocksMap::paste(const BlocksMap& source, glm::ivec3 position) {
+  glm::ivec3 offset = position - source.basePosition; // from source positions to positions in this map
+  BlocksRegion clipped = clip(BlocksRegion{position, position + source.size});
+  if (clipped.empty()) return clipped;
+
+  glm::ivec3 min = clipped.min - basePosition;
+  glm::ivec3 max = clipped.max - basePosition;
+  glm::ivec3 sourceMin = clipped.min - offset - source.basePosition;
+  for (int y = min.y; y < max.y; y++) {
+    for (int z = min.z; z < max.z; z++) {
+      size_t rowStart = (y * size.z + z) * size.x;
+      size_t sourceRowStart = ((sourceMin.y + y - min.y) * source.size.z + sourceMin.z + z - min.z) * source.size.x;
+      std::copy_n(source.storage.begin() + sourceRowStart + sourceMin.x, max.x - min.x, storage.begin() + rowStart + min.x);
+    }
+  }
+  updateSolidBits(clipped);
+  recountBricks(clipped);
+  if (_observer) _observer->blocksChanged(*this, clipped);
+  return clipped;
+}
+
+void BlocksMap::setSolidBits(size_t begin, size_t end, bool solid) {
+  // Whole words at a time in the middle of the range
+  while (begin < end) {
+    size_t word = begin / 64;
+    size_t wordEnd = std::min(end, (word + 1) * 64);
+    uint64_t mask = (wordEnd - begin == 64) ? ~uint64_t(0) : ((uint64_t(1) << (wordEnd - begin)) - 1) << (begin % 64);
+    if (solid) {
+      _solidBits[word] |= mask;
+    } else {
+      _solidBits[word] &= ~mask;
+    }
+    begin = wordEnd;
+  }
+}
+
+void BlocksMap::updateSolidBits(const BlocksRegion& region) {
+  glm::ivec3 min = region.min - basePosition;
+  glm::ivec3 max = region.max - basePosition;
+  for (int y = min.y; y < max.y; y++) {
+    for (int z = min.z; z < max.z; z++) {
+      size_t rowStart = (y * size.z + z) * size.x;
+      for (size_t i = rowStart + min.x; i < rowStart + max.x; i++) {
+        const std::optional<Block>& block = storage[i];
+        uint64_t bit = uint64_t(1) << (i % 64);
+        _solidBits[i / 64] = (block && _registry.solid(block->id())) ? (_solidBits[i / 64] | bit) : (_solidBits[i / 64] & ~bit);
+      }
+    }
+  }
+}
+
+void BlocksMap::recountBricks(const BlocksRegion& region) {
+  glm::ivec3 brickMin = (region.min - basePosition) / BRICK_SIZE;
+  glm::ivec3 brickMax = (region.max - basePosition + BRICK_SIZE - 1) / BRICK_SIZE;
+  for (int brickY = brickMin.y; brickY < brickMax.y; brickY++) {
+    for (int brickZ = brickMin.z; brickZ < brickMax.z; brickZ++) {
+      for (int brickX = brickMin.x; brickX < brickMax.x; brickX++) {
+        glm::ivec3 min = glm::ivec3(brickX, brickY, brickZ) * BRICK_SIZE;
+        glm::ivec3 max = glm::min(min + BRICK_SIZE, size);
+        uint8_t count = 0;
+        for (int y = min.y; y < max.y; y++) {
+          for (int z = min.z; z < max.z; z++) {
+            size_t rowStart = (y * size.z + z) * size.x;
+            count += std::count_if(storage.begin() + rowStart + min.x, storage.begin() + rowStart + max.x, [] (const std::optional<Block>& block) {
+              return block.has_value();
+            });
+          }
+        }
+        _brickBlockCounts[(brickY * _brickCount.z + brickZ) * _brickCount.x + brickX] = count;
+      }
+    }
+  }
 }
 
 const Block* BlocksMap::get(glm::ivec3 position) const {
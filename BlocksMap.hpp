@@ -3,23 +3,111 @@
 #include <vector>
 #include <optional>
 #include <algorithm>
+#include <cstdint>
 #include <glm/glm.hpp>
 #include "Block.hpp"
+#include "BlockRegistry.hpp"
+#include "MemoryTracking.hpp"
+
+// A box of cells from min (inclusive) to max (exclusive), in world space
+struct BlocksRegion {
+  glm::ivec3 min;
+  glm::ivec3 max;
+
+  bool empty() const { return max.x <= min.x || max.y <= min.y || max.z <= min.z; }
+  size_t volume() const { return empty() ? 0 : (size_t) (max.x - min.x) * (max.y - min.y) * (max.z - min.z); }
+};
+
+class BlocksMap;
+
+// Told about every edit of a BlocksMap it is attached to, for keeping something in step with the map such as a save
+class BlocksMapObserver {
+public:
+  virtual ~BlocksMapObserver() = default;
+  // Called after the edit, with the region it may have changed, the new cells can be read from the map
+  virtual void blocksChanged(const BlocksMap& blocksMap, const BlocksRegion& region) = 0;
+};
 
 class BlocksMap {
+private:
+  const BlockRegistry& _registry;
+  BlocksMapObserver* _observer = nullptr;
+  TaggedVector<uint64_t, MemoryTag::BLOCK_STORAGE> _solidBits; // one bit per element in storage, set if there is a solid block
+  TaggedVector<uint8_t, MemoryTag::BLOCK_STORAGE> _brickBlockCounts; // number of blocks in each brick
+  glm::ivec3 _brickCount; // along each axis
+
+  void setSolidBits(size_t begin, size_t end, bool solid);
+  // Bring the solid bits in the region up to date after storage was written directly
+  void updateSolidBits(const BlocksRegion& region);
+  void recountBricks(const BlocksRegion& region);
+
 public:
+  // Side length of the bricks the map is divided into for skipping empty space
+  static constexpr int BRICK_SIZE = 4;
+
   glm::ivec3 basePosition; // What the (0, 0, 0)th element in storage mean in world space
   glm::ivec3 size;
-  std::vector<std::optional<Block>> storage;
+  TaggedVector<std::optional<Block>, MemoryTag::BLOCK_STORAGE> storage; // read only, modify through set() or the bulk edits so that the solid bits stay in sync
+
+  BlocksMap(const BlockRegistry& registry_, glm::ivec3 basePosition_, glm::ivec3 size_);
 
-  BlocksMap(glm::ivec3 basePosition_, glm::ivec3 size_);
+  // The block types the blocks in the map belong to
+  const BlockRegistry& registry() const { return _registry; }
+
+  // At most one, nullptr to detach it
+  BlocksMapObserver* observer() const { return _observer; }
+  void observer(BlocksMapObserver* observer_) { _observer = observer_; }
 
-  std::optional<Block>& operator[](glm::ivec3 position);
   const std::optional<Block>& operator[](glm::ivec3 position) const;
 
+  // Place a block, or remove it with an empty optional
+  void set(glm::ivec3 position, const std::optional<Block>& block);
+
+  // The part of a region that is inside the map
+  BlocksRegion clip(const BlocksRegion& region) const;
+
+  // Bulk edits, the parts outside of the map are ignored
+  // They work on whole rows along x, and return the region that was changed, to be passed on to LightMap::regionChanged() and remeshed once
+  BlocksRegion fill(const BlocksRegion& region, const std::optional<Block>& block);
+  // Replace every block of type from with to, an empty to removes them
+  BlocksRegion replace(const BlocksRegion& region, BlockId from, const std::optional<Block>& to);
+  // A new map holding a copy of the region, cells outside of this map are empty
+  BlocksMap copy(const BlocksRegion& region) const;
+  // Write all cells of source, including the empty ones, with its base position moved to position
+  BlocksRegion paste(const BlocksMap& source, glm::ivec3 position);
+
+  // Whether there is a block that entities collide with at the position, positions outside of the map are empty
+  // Only reads the bitset, for collision tests over many cells
+  bool solid(glm::ivec3 position) const {
+    glm::ivec3 internalPosition = position - basePosition;
+    if (
+      (unsigned) internalPosition.x >= (unsigned) size.x ||
+      (unsigned) internalPosition.y >= (unsigned) size.y ||
+      (unsigned) internalPosition.z >= (unsigned) size.z
+    ) {
+      return false;
+    }
+    size_t storageLocation = internalPosition.y * size.x * size.z + internalPosition.z * size.x + internalPosition.x;
+    return (_solidBits[storageLocation / 64] >> (storageLocation % 64)) & 1;
+  }
+
   // Like operator[], but do not throw
   const Block* get(glm::ivec3 position) const;
 
+  // Whether the brick containing the position has no blocks, positions outside of the map are in empty bricks
+  bool brickEmpty(glm::ivec3 position) const {
+    glm::ivec3 internalPosition = position - basePosition;
+    if (
+      (unsigned) internalPosition.x >= (unsigned) size.x ||
+      (unsigned) internalPosition.y >= (unsigned) size.y ||
+      (unsigned) internalPosition.z >= (unsigned) size.z
+    ) {
+      return true;
+    }
+    glm::ivec3 brick = internalPosition / BRICK_SIZE;
+    return _brickBlockCounts[(brick.y * _brickCount.z + brick.z) * _brickCount.x + brick.x] == 0;
+  }
+
   std::optional<size_t> calculateStorageLocation(glm::ivec3 position) const;
   glm::ivec3 calculatePosition(size_t storageLocation) const;
 };
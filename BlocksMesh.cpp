@@ -1,57 +1,189 @@
-#include <algorithm>
+#include <array>
+#include <utility>
 #include "Block.hpp"
 #include "BlocksMesh.hpp"
+#include "MeshCache.hpp"
+#include "Metrics.hpp"
 
-BlocksMesh BlocksMesh::buildFromBlocksMap(const BlocksMap& blocksMap) {
+namespace {
+
+const std::array<glm::ivec3, 6> SIDE_DIRECTIONS = {{
+  {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1},
+}};
+
+// Whether a face on the side is hidden by the block in front of it
+bool faceHidden(const BlocksMap& blocksMap, glm::ivec3 adjacentPosition, int side, SideMask overlappedSubcells) {
+  const Block* adjacentBlock = blocksMap.get(adjacentPosition);
+  return adjacentBlock && blocksMap.registry().hidesFace(adjacentBlock->id(), side, overlappedSubcells);
+}
+
+void faceLight(const LightMap* lightMap, glm::ivec3 lightPosition, float& skyLight, float& blockLight) {
+  skyLight = lightMap ? lightMap->skyLight(lightPosition) / (float) LightMap::MAX_LIGHT : 1.f;
+  blockLight = lightMap ? lightMap->blockLight(lightPosition) / (float) LightMap::MAX_LIGHT : 0.f;
+}
+
+// One side of a full block, SIDE is a template parameter so that the corners are constants
+template <int SIDE>
+void addFullCubeFace(const BlocksMap& blocksMap, const LightMap* lightMap, glm::ivec3 position, const BakedFace& face, MeshVector<BlockVertex>& vertices, MeshVector<GLuint>& indices) {
+  glm::ivec3 adjacentPosition = position + SIDE_DIRECTIONS[SIDE];
+  if (faceHidden(blocksMap, adjacentPosition, SIDE, FULL_SIDE_MASK)) return;
+
+  float skyLight, blockLight;
+  faceLight(lightMap, adjacentPosition, skyLight, blockLight);
+
+  GLuint firstVertex = vertices.size();
+  for (const BlockVertex& corner : FULL_BLOCK_FACE_VERTICES[SIDE]) {
+    BlockVertex vertex = corner;
+    vertex.x += position.x;
+    vertex.y += position.y;
+    vertex.z += position.z;
+    vertex.tx = face.textureX;
+    vertex.ty = face.textureY;
+    vertex.skyLight = skyLight;
+    vertex.blockLight = blockLight;
+    vertices.push_back(vertex);
+  }
+  for (GLuint index : FULL_BLOCK_FACE_INDICES) {
+    indices.push_back(firstVertex + index);
+  }
+}
+
+template <int... SIDES>
+void addFullCubeFaces(const BlocksMap& blocksMap, const LightMap* lightMap, glm::ivec3 position, const BakedFace* faces, MeshVector<BlockVertex>& vertices, MeshVector<GLuint>& indices, std::integer_sequence<int, SIDES...>) {
+  (addFullCubeFace<SIDES>(blocksMap, lightMap, position, faces[SIDES], vertices, indices), ...);
+}
+
+// Add the exposed faces of the block at position, with their indices going into indices
+void addBlockFaces(const BlocksMap& blocksMap, const LightMap* lightMap, glm::ivec3 position, const Block& block, MeshVector<BlockVertex>& vertices, MeshVector<GLuint>& indices) {
+  const BlockRegistry& registry = blocksMap.registry();
+  const BakedModel& model = registry.model(block.id());
+  const BakedFace* faces = registry.bakedFaces().data() + model.firstFace;
+
+  if (model.fullCube) {
+    addFullCubeFaces(blocksMap, lightMap, position, faces, vertices, indices, std::make_integer_sequence<int, 6>());
+    return;
+  }
+
+  // Add the vertices of exposed faces to the mesh
+  for (const BakedFace* face = faces; face != faces + model.faceCount; face++) {
+    // A face is lit by the cell in front of it
+    glm::ivec3 lightPosition = position;
+    if (face->cullSide >= 0) {
+      lightPosition = position + SIDE_DIRECTIONS[face->cullSide];
+      if (faceHidden(blocksMap, lightPosition, face->cullSide, face->overlappedSubcells)) continue;
+    }
+
+    float skyLight, blockLight;
+    faceLight(lightMap, lightPosition, skyLight, blockLight);
+
+    // Add vertices to mesh
+    const BlockVertex* definedVertices = registry.bakedVertices().data() + face->firstVertex;
+    for (const BlockVertex* definedVertex = definedVertices; definedVertex != definedVertices + face->vertexCount; definedVertex++) {
+      BlockVertex vertex = *definedVertex;
+      // Move vertex position with respect to block position
+      vertex.x += position.x;
+      vertex.y += position.y;
+      vertex.z += position.z;
+      vertex.skyLight = skyLight;
+      vertex.blockLight = blockLight;
+
+      vertices.push_back(vertex);
+    }
+
+    // Add vertex indices to mesh
+    const GLuint* definedIndices = registry.bakedIndices().data() + face->firstIndex;
+    for (const GLuint* definedIndex = definedIndices; definedIndex != definedIndices + face->indexCount; definedIndex++) {
+      indices.push_back(vertices.size() - face->vertexCount + *definedIndex);
+    }
+  }
+}
+
+}
+
+BlocksMesh BlocksMesh::buildFromBlocksMap(const BlocksMap& blocksMap, const LightMap* lightMap) {
   BlocksMesh blocksMesh;
+  blocksMesh.rebuild(blocksMap, lightMap);
+  return blocksMesh;
+}
 
-  for (size_t i = 0; i < blocksMap.storage.size(); i++) {
-    glm::ivec3 position = blocksMap.calculatePosition(i);
-    const std::optional<Block>& block = blocksMap.storage[i];
-    if (!block) continue;
-
-    // Add the vertices of exposed faces to the mesh
-    for (const BlockFaceDefinition& face : block->blockType().faces()) {
-      // Determine whether this face is at or beyond the boundary of the block, and in which direction
-      std::optional<glm::ivec3> faceDirection;
-      if (std::all_of(face.vertices().begin(), face.vertices().end(), [] (const BlockVertex& vertex) { return vertex.x >= 0.5f; })) {
-        faceDirection.emplace(glm::ivec3(1, 0, 0));
-      } else if (std::all_of(face.vertices().begin(), face.vertices().end(), [] (const BlockVertex& vertex) { return vertex.x <= -0.5f; })) {
-        faceDirection.emplace(glm::ivec3(-1, 0, 0));
-      } else if (std::all_of(face.vertices().begin(), face.vertices().end(), [] (const BlockVertex& vertex) { return vertex.y >= 0.5f; })) {
-        faceDirection.emplace(glm::ivec3(0, 1, 0));
-      } else if (std::all_of(face.vertices().begin(), face.vertices().end(), [] (const BlockVertex& vertex) { return vertex.y <= -0.5f; })) {
-        faceDirection.emplace(glm::ivec3(0, -1, 0));
-      } else if (std::all_of(face.vertices().begin(), face.vertices().end(), [] (const BlockVertex& vertex) { return vertex.z >= 0.5f; })) {
-        faceDirection.emplace(glm::ivec3(0, 0, 1));
-      } else if (std::all_of(face.vertices().begin(), face.vertices().end(), [] (const BlockVertex& vertex) { return vertex.z <= -0.5f; })) {
-        faceDirection.emplace(glm::ivec3(0, 0, -1));
-      }
-      if (faceDirection) {
-        const Block* adjacentBlock = blocksMap.get(position + *faceDirection);
-        // Discard faces with non-transparent adjacent block
-        if (adjacentBlock && !adjacentBlock->blockType().attributes().transparent) continue;
+void BlocksMesh::meshSection(const BlocksMap& blocksMap, const LightMap* lightMap, glm::ivec3 sectionMin, glm::ivec3 sectionMax) {
+  for (int y = sectionMin.y; y < sectionMax.y; y++) {
+    for (int z = sectionMin.z; z < sectionMax.z; z++) {
+      for (int x = sectionMin.x; x < sectionMax.x; x++) {
+        glm::ivec3 position = blocksMap.basePosition + glm::ivec3(x, y, z);
+        const std::optional<Block>& block = blocksMap.storage[(y * blocksMap.size.z + z) * blocksMap.size.x + x];
+        if (!block) continue;
+        MeshVector<GLuint>& indices = blocksMap.registry().cutout(block->id()) ? _cutoutIndices : vertexIndices;
+        addBlockFaces(blocksMap, lightMap, position, *block, vertices, indices);
       }
+    }
+  }
+}
 
-      // Add vertices to mesh
-      blocksMesh.vertices.reserve(blocksMesh.vertices.size() + face.vertices().size());
-      for (const BlockVertex& definedVertex : face.vertices()) {
-        BlockVertex vertex = definedVertex;
-        // Move vertex position with respect to block position
-        vertex.x += position.x;
-        vertex.y += position.y;
-        vertex.z += position.z;
+void BlocksMesh::rebuild(const BlocksMap& blocksMap, const LightMap* lightMap, MeshCache* cache) {
+  // clear() keeps the capacity
+  vertices.clear();
+  vertexIndices.clear();
+  sections.clear();
+  _cutoutIndices.clear();
+  if (cache) cache->beginBuild(blocksMap);
 
-        blocksMesh.vertices.push_back(vertex);
-      }
+  glm::ivec3 sectionCount = (blocksMap.size + SECTION_SIZE - 1) / SECTION_SIZE;
+  for (int sectionY = 0; sectionY < sectionCount.y; sectionY++) {
+    for (int sectionZ = 0; sectionZ < sectionCount.z; sectionZ++) {
+      for (int sectionX = 0; sectionX < sectionCount.x; sectionX++) {
+        glm::ivec3 sectionMin = glm::ivec3(sectionX, sectionY, sectionZ) * SECTION_SIZE;
+        glm::ivec3 sectionMax = glm::min(sectionMin + SECTION_SIZE, blocksMap.size);
 
-      // Add vertex indices to mesh
-      blocksMesh.vertexIndices.reserve(face.vertexIndices().size());
-      for (GLuint definedVertexIndex : face.vertexIndices()) {
-        blocksMesh.vertexIndices.push_back(blocksMesh.vertices.size() - face.vertices().size() + definedVertexIndex);
+        Section section;
+        section.center = glm::vec3(blocksMap.basePosition) + glm::vec3(sectionMin + sectionMax) / 2.f - 0.5f;
+        section.opaque.first = vertexIndices.size();
+        section.cutout.first = _cutoutIndices.size();
+        GLuint firstVertex = vertices.size();
+
+        uint64_t cacheKey = 0;
+        const MeshCache::Entry* cached = nullptr;
+        if (cache) {
+          cacheKey = cache->sectionKey(blocksMap, lightMap, blocksMap.basePosition + sectionMin, blocksMap.basePosition + sectionMax);
+          cached = cache->find(cacheKey);
+        }
+        if (cached) {
+          vertices.insert(vertices.end(), cached->vertices, cached->vertices + cached->vertexCount);
+          for (size_t i = 0; i < cached->opaqueCount; i++) {
+            vertexIndices.push_back(firstVertex + cached->opaqueIndices[i]);
+          }
+          for (size_t i = 0; i < cached->cutoutCount; i++) {
+            _cutoutIndices.push_back(firstVertex + cached->cutoutIndices[i]);
+          }
+        } else {
+          meshSection(blocksMap, lightMap, sectionMin, sectionMax);
+          if (cache) {
+            cache->store(cacheKey, vertices.data() + firstVertex, vertices.size() - firstVertex, firstVertex,
+                         vertexIndices.data() + section.opaque.first, vertexIndices.size() - section.opaque.first,
+                         _cutoutIndices.data() + section.cutout.first, _cutoutIndices.size() - section.cutout.first);
+          }
+        }
+
+        section.opaque.count = vertexIndices.size() - section.opaque.first;
+        section.cutout.count = _cutoutIndices.size() - section.cutout.first;
+        if (section.opaque.count > 0 || section.cutout.count > 0) {
+          sections.push_back(section);
+        }
       }
     }
   }
 
-  return blocksMesh;
+  // Put the cutout indices after all opaque ones
+  size_t cutoutOffset = vertexIndices.size();
+  for (Section& section : sections) {
+    section.cutout.first += cutoutOffset;
+  }
+  vertexIndices.insert(vertexIndices.end(), _cutoutIndices.begin(), _cutoutIndices.end());
+
+  static Metric& meshVertices = Metrics::gauge("blocks_mesh.vertices");
+  static Metric& meshIndices = Metrics::gauge("blocks_mesh.indices");
+  static Metric& meshSections = Metrics::gauge("blocks_mesh.sections");
+  meshVertices.set(vertices.size());
+  meshIndices.set(vertexIndices.size());
+  meshSections.set(sections.size());
 }
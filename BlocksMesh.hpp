@@ -4,13 +4,49 @@
 #include <array>
 #include <GL/glew.h>
 #include "BlocksMap.hpp"
+#include "LightMap.hpp"
+#include "MemoryTracking.hpp"
+
+// The arrays of the block meshes, accounted together
+template <typename T>
+using MeshVector = TaggedVector<T, MemoryTag::MESHES>;
+
+class MeshCache;
 
 class BlocksMesh {
 public:
-  std::vector<BlockVertex> vertices;
-  std::vector<GLuint> vertexIndices;
+  static constexpr int SECTION_SIZE = 16;
+
+  // A run of vertexIndices
+  struct IndexRange {
+    size_t first;
+    size_t count;
+  };
+
+  // The geometry of a SECTION_SIZE^3 part of the map, so that it can be sorted by distance
+  // Opaque faces are drawn without alpha testing, so they keep early depth rejection, cutout faces (of transparent block types) are drawn after them with it
+  struct Section {
+    glm::vec3 center;
+    IndexRange opaque;
+    IndexRange cutout;
+  };
+
+  MeshVector<BlockVertex> vertices;
+  MeshVector<GLuint> vertexIndices; // opaque ranges of all sections first, then the cutout ranges
+  std::vector<Section> sections; // only the ones with any faces
+
+  // Without a light map, everything is in full sky light
+  static BlocksMesh buildFromBlocksMap(const BlocksMap& blocksMap, const LightMap* lightMap = nullptr);
+  // Replace the contents with a new mesh of the map, keeping the memory of the previous one
+  // Once the vectors have grown to fit the map, rebuilding it after edits does not allocate
+  // With a cache, sections found in it are copied from there instead of being meshed, and the others are added to it
+  void rebuild(const BlocksMap& blocksMap, const LightMap* lightMap = nullptr, MeshCache* cache = nullptr);
+
+private:
+  MeshVector<GLuint> _cutoutIndices; // scratch, moved behind the opaque indices at the end of a build
 
-  static BlocksMesh buildFromBlocksMap(const BlocksMap& blocksMap);
+  // Add the faces of the blocks from sectionMin to sectionMax, relative to the base position of the map
+  void meshSection(const BlocksMap& blocksMap, const LightMap* lightMap, glm::ivec3 sectionMin, glm::ivec3 sectionMax);
 };
 
 #endif
@@ -0,0 +1,56 @@
+#ifndef _BUFFER_TEXTURE_HPP_
+#define _BUFFER_TEXTURE_HPP_
+#include <GL/glew.h>
+#include "GLState.hpp"
+#include "Metrics.hpp"
+#include "MemoryTracking.hpp"
+
+// A buffer object read by shaders as a texture (GL_TEXTURE_BUFFER), with texelFetch
+class BufferTexture {
+private:
+  GLuint _bufferId;
+  GLuint _textureId;
+  size_t _size = 0;
+
+public:
+  BufferTexture(GLenum internalFormat) {
+    glGenBuffers(1, &_bufferId);
+    glGenTextures(1, &_textureId);
+    GLState::bindBuffer(GL_TEXTURE_BUFFER, _bufferId);
+    GLState::bindTexture(0, GL_TEXTURE_BUFFER, _textureId);
+    glTexBuffer(GL_TEXTURE_BUFFER, internalFormat, _bufferId);
+  }
+  ~BufferTexture() {
+    MemoryTracking::freed(MemoryTag::VRAM_BUFFERS, _size);
+    glDeleteTextures(1, &_textureId);
+    GLState::texturesDeleted(1, &_textureId);
+    glDeleteBuffers(1, &_bufferId);
+    GLState::bufferDeleted(_bufferId);
+  }
+
+  BufferTexture(const BufferTexture&) = delete;
+  BufferTexture& operator=(const BufferTexture&) = delete;
+
+  GLuint bufferId() const { return _bufferId; }
+  GLuint textureId() const { return _textureId; }
+
+  void bind(GLuint unit) {
+    GLState::bindTexture(unit, GL_TEXTURE_BUFFER, _textureId);
+  }
+
+  // The texture keeps referring to the buffer when its storage is reallocated
+  template <typename C>
+  void sendData(const C& dataContainer, GLenum usage) {
+    static Metric& uploadedBytes = Metrics::counter("gl.buffer_bytes_uploaded");
+    static Metric& uploads = Metrics::counter("gl.buffer_uploads");
+    uploadedBytes.add(dataContainer.size() * sizeof(typename C::value_type));
+    uploads.add();
+    MemoryTracking::freed(MemoryTag::VRAM_BUFFERS, _size);
+    _size = dataContainer.size() * sizeof(typename C::value_type);
+    MemoryTracking::allocated(MemoryTag::VRAM_BUFFERS, _size);
+    GLState::bindBuffer(GL_TEXTURE_BUFFER, _bufferId);
+    glBufferData(GL_TEXTURE_BUFFER, dataContainer.size() * sizeof(typename C::value_type), dataContainer.data(), usage);
+  }
+};
+
+#endif
@@ -0,0 +1,101 @@
+#include <cmath>
+#include "Collision.hpp"
+
+namespace {
+
+// Keeps boxes that are exactly touching a block from counting as overlapping it
+const float EPSILON = 1e-4f;
+// Blocks are centered on their positions, so the cell of the block at c spans [c - 0.5, c + 0.5)
+const glm::vec3 CELL_OFFSET(0.5f);
+// Distance below the box searched for the ground
+const float GROUND_PROBE_DISTANCE = 0.01f;
+
+// Cells that the box overlaps along an axis
+inline int firstCell(float min) { return (int) std::floor(min + EPSILON); }
+inline int lastCell(float max) { return (int) std::ceil(max - EPSILON) - 1; }
+
+// Whether any cell in the layer perpendicular to the axis, within the cross section of the box, is solid
+bool layerSolid(const BlocksMap& blocksMap, const AABB& box, int axis, int layer) {
+  int u = (axis + 1) % 3;
+  int v = (axis + 2) % 3;
+  int uFirst = firstCell(box.min[u]), uLast = lastCell(box.max[u]);
+  int vFirst = firstCell(box.min[v]), vLast = lastCell(box.max[v]);
+
+  glm::ivec3 cell;
+  cell[axis] = layer;
+  for (cell[u] = uFirst; cell[u] <= uLast; cell[u]++) {
+    for (cell[v] = vFirst; cell[v] <= vLast; cell[v]++) {
+      if (blocksMap.solid(cell)) return true;
+    }
+  }
+  return false;
+}
+
+}
+
+float sweepAxis(const BlocksMap& blocksMap, const AABB& worldBox, int axis, float distance) {
+  // Work in a space where cell c spans [c, c + 1)
+  AABB box = worldBox.translated(CELL_OFFSET);
+  if (distance > 0.f) {
+    // Layers beyond the one the leading face is in, a box already overlapping a block can still move out of it
+    int first = (int) std::floor(box.max[axis] - EPSILON) + 1;
+    int last = (int) std::ceil(box.max[axis] + distance) - 1;
+    for (int layer = first; layer <= last; layer++) {
+      if (layerSolid(blocksMap, box, axis, layer)) {
+        return std::max(layer - box.max[axis], 0.f);
+      }
+    }
+  } else if (distance < 0.f) {
+    int first = (int) std::ceil(box.min[axis] + EPSILON) - 2;
+    int last = (int) std::floor(box.min[axis] + distance);
+    for (int layer = first; layer >= last; layer--) {
+      if (layerSolid(blocksMap, box, axis, layer)) {
+        return std::min(layer + 1 - box.min[axis], 0.f);
+      }
+    }
+  }
+  return distance;
+}
+
+namespace {
+
+// Move along y, then x, then z
+MoveResult moveAxes(const BlocksMap& blocksMap, AABB box, const glm::vec3& displacement) {
+  MoveResult result{glm::vec3(0.f), glm::bvec3(false), false};
+  for (int axis : {1, 0, 2}) {
+    float moved = sweepAxis(blocksMap, box, axis, displacement[axis]);
+    result.blocked[axis] = moved != displacement[axis];
+    result.displacement[axis] = moved;
+    box.min[axis] += moved;
+    box.max[axis] += moved;
+  }
+  return result;
+}
+
+}
+
+MoveResult moveAndCollide(const BlocksMap& blocksMap, const AABB& box, const glm::vec3& displacement, float stepHeight, bool wasOnGround) {
+  MoveResult result = moveAxes(blocksMap, box, displacement);
+
+  bool blockedHorizontally = result.blocked.x || result.blocked.z;
+  bool grounded = wasOnGround || (result.blocked.y && displacement.y < 0.f);
+  if (blockedHorizontally && grounded && stepHeight > 0.f) {
+    // Go up, across, then back down onto whatever was stepped on
+    float up = sweepAxis(blocksMap, box, 1, stepHeight);
+    AABB raised = box.translated(glm::vec3(0.f, up, 0.f));
+    MoveResult across = moveAxes(blocksMap, raised, glm::vec3(displacement.x, 0.f, displacement.z));
+    AABB moved = raised.translated(across.displacement);
+    float down = sweepAxis(blocksMap, moved, 1, std::min(displacement.y, 0.f) - up);
+
+    glm::vec2 horizontal(result.displacement.x, result.displacement.z);
+    glm::vec2 steppedHorizontal(across.displacement.x, across.displacement.z);
+    if (glm::dot(steppedHorizontal, steppedHorizontal) > glm::dot(horizontal, horizontal)) {
+      result.displacement = glm::vec3(across.displacement.x, up + down, across.displacement.z);
+      result.blocked = glm::bvec3(across.blocked.x, false, across.blocked.z);
+    }
+  }
+
+  AABB moved = box.translated(result.displacement);
+  result.onGround = (result.blocked.y && displacement.y < 0.f) || sweepAxis(blocksMap, moved, 1, -GROUND_PROBE_DISTANCE) != -GROUND_PROBE_DISTANCE;
+  return result;
+}
@@ -0,0 +1,28 @@
+#ifndef _COLLISION_HPP_
+#define _COLLISION_HPP_
+#include <glm/glm.hpp>
+#include "BlocksMap.hpp"
+
+// Axis-aligned bounding box in world space
+struct AABB {
+  glm::vec3 min;
+  glm::vec3 max;
+
+  AABB translated(const glm::vec3& offset) const { return AABB{min + offset, max + offset}; }
+};
+
+struct MoveResult {
+  glm::vec3 displacement; // how far the box actually moved
+  glm::bvec3 blocked; // the movement was cut short along this axis
+  bool onGround;
+};
+
+// How far the box can move along one axis (0, 1, 2 for x, y, z) before touching a solid block, up to distance
+// Only the layers of cells between the box and its destination are tested, nearest first
+float sweepAxis(const BlocksMap& blocksMap, const AABB& box, int axis, float distance);
+
+// Move the box by displacement, resolved one axis at a time (y, then x and z) so that it slides along walls
+// If a horizontal move is blocked while on the ground, stepping up to stepHeight onto the obstacle is tried as well
+MoveResult moveAndCollide(const BlocksMap& blocksMap, const AABB& box, const glm::vec3& displacement, float stepHeight, bool wasOnGround);
+
+#endif
@@ -0,0 +1,253 @@
+#include <cstring>
+#include <cerrno>
+#include <utility>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "Connection.hpp"
+#include "Metrics.hpp"
+
+namespace {
+
+// Messages larger than this are treated as a broken stream
+const uint32_t MAX_MESSAGE_SIZE = 16 << 20;
+const size_t HEADER_SIZE = 5; // length and type
+
+NetworkException systemError(const std::string& what) {
+  std::string msg = strerror(errno);
+  return NetworkException(what + ": " + msg);
+}
+
+void setNonBlocking(int fd) {
+  int flags = fcntl(fd, F_GETFL);
+  if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+    throw systemError("Cannot make socket non-blocking");
+  }
+}
+
+const std::string UNIX_PREFIX = "unix:";
+
+sockaddr_un unixAddress(const std::string& path) {
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) {
+    throw NetworkException("Socket path is too long: " + path);
+  }
+  strcpy(address.sun_path, path.c_str());
+  return address;
+}
+
+// Resolve "HOST:PORT", the host may be empty to listen on all interfaces
+addrinfo* resolveTcp(const std::string& address, bool passive) {
+  size_t colon = address.rfind(':');
+  if (colon == std::string::npos) {
+    throw NetworkException("Expected unix:PATH or HOST:PORT, got " + address);
+  }
+  std::string host = address.substr(0, colon);
+  std::string port = address.substr(colon + 1);
+
+  addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  if (passive) hints.ai_flags = AI_PASSIVE;
+  addrinfo* result;
+  int err = getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &result);
+  if (err != 0) {
+    throw NetworkException("Cannot resolve " + address + ": " + gai_strerror(err));
+  }
+  return result;
+}
+
+}
+
+Connection::Connection(int fd_) : _fd(fd_) {
+  setNonBlocking(_fd);
+}
+
+Connection::~Connection() {
+  if (_fd >= 0) ::close(_fd);
+}
+
+Connection::Connection(Connection&& other) :
+  _fd(std::exchange(other._fd, -1)),
+  _readBuffer(std::move(other._readBuffer)), _readOffset(other._readOffset),
+  _writeBuffer(std::move(other._writeBuffer)), _writeOffset(other._writeOffset),
+  _closed(other._closed) {}
+
+Connection& Connection::operator=(Connection&& other) {
+  if (this != &other) {
+    if (_fd >= 0) ::close(_fd);
+    _fd = std::exchange(other._fd, -1);
+    _readBuffer = std::move(other._readBuffer);
+    _readOffset = other._readOffset;
+    _writeBuffer = std::move(other._writeBuffer);
+    _writeOffset = other._writeOffset;
+    _closed = other._closed;
+  }
+  return *this;
+}
+
+Connection Connection::connect(const std::string& address) {
+  if (address.compare(0, UNIX_PREFIX.size(), UNIX_PREFIX) == 0) {
+    sockaddr_un unixAddr = unixAddress(address.substr(UNIX_PREFIX.size()));
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) throw systemError("Cannot create socket");
+    if (::connect(fd, (sockaddr*) &unixAddr, sizeof(unixAddr)) < 0) {
+      NetworkException error = systemError("Cannot connect to " + address);
+      ::close(fd);
+      throw error;
+    }
+    return Connection(fd);
+  }
+
+  addrinfo* addresses = resolveTcp(address, false);
+  int fd = -1;
+  for (addrinfo* candidate = addresses; candidate; candidate = candidate->ai_next) {
+    fd = socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+    if (fd < 0) continue;
+    if (::connect(fd, candidate->ai_addr, candidate->ai_addrlen) == 0) break;
+    ::close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(addresses);
+  if (fd < 0) throw systemError("Cannot connect to " + address);
+
+  // Deltas are small and latency matters more than packet count
+  int noDelay = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+  return Connection(fd);
+}
+
+void Connection::close() {
+  if (_fd >= 0) ::close(_fd);
+  _fd = -1;
+  _closed = true;
+}
+
+void Connection::send(MessageType type, const std::vector<uint8_t>& payload) {
+  uint32_t size = payload.size();
+  uint8_t header[HEADER_SIZE] = {(uint8_t) size, (uint8_t) (size >> 8), (uint8_t) (size >> 16), (uint8_t) (size >> 24), (uint8_t) type};
+  _writeBuffer.insert(_writeBuffer.end(), header, header + HEADER_SIZE);
+  _writeBuffer.insert(_writeBuffer.end(), payload.begin(), payload.end());
+}
+
+void Connection::flush() {
+  while (!_closed && _writeOffset < _writeBuffer.size()) {
+    ssize_t written = ::send(_fd, _writeBuffer.data() + _writeOffset, _writeBuffer.size() - _writeOffset, MSG_NOSIGNAL);
+    if (written < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+      if (errno == EINTR) continue;
+      _closed = true;
+      break;
+    }
+    _writeOffset += written;
+    static Metric& sentBytes = Metrics::counter("network.bytes_sent");
+    sentBytes.add(written);
+  }
+  if (_writeOffset == _writeBuffer.size()) {
+    _writeBuffer.clear();
+    _writeOffset = 0;
+  }
+}
+
+std::optional<Message> Connection::receive() {
+  while (!_closed) {
+    uint8_t chunk[65536];
+    ssize_t received = recv(_fd, chunk, sizeof(chunk), 0);
+    if (received < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+      if (errno == EINTR) continue;
+      _closed = true;
+    } else if (received == 0) {
+      _closed = true;
+    } else {
+      _readBuffer.insert(_readBuffer.end(), chunk, chunk + received);
+      static Metric& receivedBytes = Metrics::counter("network.bytes_received");
+      receivedBytes.add(received);
+    }
+  }
+
+  // Messages that arrived before the peer closed are still handed out
+  size_t available = _readBuffer.size() - _readOffset;
+  if (available < HEADER_SIZE) return std::nullopt;
+  const uint8_t* header = _readBuffer.data() + _readOffset;
+  uint32_t size = header[0] | header[1] << 8 | header[2] << 16 | (uint32_t) header[3] << 24;
+  if (size > MAX_MESSAGE_SIZE) {
+    _closed = true;
+    return std::nullopt;
+  }
+  if (available < HEADER_SIZE + size) return std::nullopt;
+
+  Message message;
+  message.type = (MessageType) header[4];
+  message.payload.assign(header + HEADER_SIZE, header + HEADER_SIZE + size);
+  _readOffset += HEADER_SIZE + size;
+  // Drop the consumed bytes once they are most of the buffer
+  if (_readOffset > _readBuffer.size() / 2) {
+    _readBuffer.erase(_readBuffer.begin(), _readBuffer.begin() + _readOffset);
+    _readOffset = 0;
+  }
+  return message;
+}
+
+Listener::Listener(const std::string& address) {
+  if (address.compare(0, UNIX_PREFIX.size(), UNIX_PREFIX) == 0) {
+    std::string path = address.substr(UNIX_PREFIX.size());
+    sockaddr_un unixAddr = unixAddress(path);
+    _fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (_fd < 0) throw systemError("Cannot create socket");
+    // A stale socket file from a previous run would make bind() fail
+    unlink(path.c_str());
+    if (bind(_fd, (sockaddr*) &unixAddr, sizeof(unixAddr)) < 0) {
+      NetworkException error = systemError("Cannot listen on " + address);
+      ::close(_fd);
+      throw error;
+    }
+    _unixPath = path;
+  } else {
+    addrinfo* addresses = resolveTcp(address, true);
+    _fd = socket(addresses->ai_family, addresses->ai_socktype, addresses->ai_protocol);
+    if (_fd < 0) {
+      freeaddrinfo(addresses);
+      throw systemError("Cannot create socket");
+    }
+    int reuse = 1;
+    setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    int err = bind(_fd, addresses->ai_addr, addresses->ai_addrlen);
+    freeaddrinfo(addresses);
+    if (err < 0) {
+      NetworkException error = systemError("Cannot listen on " + address);
+      ::close(_fd);
+      throw error;
+    }
+  }
+
+  if (listen(_fd, 16) < 0) {
+    NetworkException error = systemError("Cannot listen on " + address);
+    ::close(_fd);
+    throw error;
+  }
+  setNonBlocking(_fd);
+}
+
+Listener::~Listener() {
+  ::close(_fd);
+  if (!_unixPath.empty()) unlink(_unixPath.c_str());
+}
+
+std::optional<Connection> Listener::accept() {
+  int fd = ::accept(_fd, nullptr, nullptr);
+  if (fd < 0) return std::nullopt;
+
+  sockaddr_storage address;
+  socklen_t addressLength = sizeof(address);
+  if (getsockname(fd, (sockaddr*) &address, &addressLength) == 0 && address.ss_family != AF_UNIX) {
+    int noDelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+  }
+  return Connection(fd);
+}
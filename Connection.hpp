@@ -0,0 +1,74 @@
+#ifndef _CONNECTION_HPP_
+#define _CONNECTION_HPP_
+#include <string>
+#include <vector>
+#include <optional>
+#include <cstdint>
+#include "ApplicationException.hpp"
+#include "Protocol.hpp"
+
+struct Message {
+  MessageType type;
+  std::vector<uint8_t> payload;
+};
+
+// A non-blocking stream socket carrying framed messages
+// Addresses are "unix:PATH" for a Unix domain socket, or "HOST:PORT" for TCP
+class Connection {
+private:
+  int _fd;
+  std::vector<uint8_t> _readBuffer; // received bytes not yet split into messages
+  size_t _readOffset = 0;
+  std::vector<uint8_t> _writeBuffer; // queued bytes not yet accepted by the socket
+  size_t _writeOffset = 0;
+  bool _closed = false;
+
+public:
+  // Takes ownership of a connected socket
+  explicit Connection(int fd_);
+  ~Connection();
+
+  Connection(Connection&& other);
+  Connection& operator=(Connection&& other);
+  Connection(const Connection&) = delete;
+  Connection& operator=(const Connection&) = delete;
+
+  // Blocks until connected
+  static Connection connect(const std::string& address);
+
+  // Queue a message, it is written out by flush()
+  void send(MessageType type, const std::vector<uint8_t>& payload);
+  // Write as much of the queue as the socket takes without blocking
+  void flush();
+  size_t pendingBytes() const { return _writeBuffer.size() - _writeOffset; }
+
+  // Read what has arrived without blocking, and take the next complete message if there is one
+  std::optional<Message> receive();
+
+  // Set once the peer has closed the connection or it failed
+  bool closed() const { return _closed; }
+  // Drop the connection, without sending what is still queued
+  void close();
+};
+
+// Accepts connections without blocking
+class Listener {
+private:
+  int _fd;
+  std::string _unixPath; // removed on destruction
+
+public:
+  Listener(const std::string& address);
+  ~Listener();
+
+  Listener(const Listener&) = delete;
+  Listener& operator=(const Listener&) = delete;
+
+  std::optional<Connection> accept();
+};
+
+class NetworkException : public ApplicationException {
+  using ApplicationException::ApplicationException;
+};
+
+#endif
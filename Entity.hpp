@@ -2,27 +2,42 @@
 #define _ENTITY_HPP_
 #include <string>
 #include <glm/glm.hpp>
+#include "EntityStore.hpp"
 
+// Owns an entity in an EntityStore, where its physical state is kept and updated together with all other entities
 class Entity {
 private:
   std::string _type;
+  EntityStore& _store;
+  EntityHandle _handle;
 
   glm::vec3 _direction;
   glm::vec2 _rotation; // (pitch, yaw)
 
 public:
-  glm::vec3 position;
-  glm::vec3 velocity;
-  glm::vec3 acceleration;
+  Entity(EntityStore& store, const std::string& type_);
+  ~Entity();
 
-  glm::vec3 desiredVelocity;
-
-  Entity(const std::string& type_) : _type(type_) {}
-  Entity(std::string&& type_) : _type(type_) {}
-
-  void processFrame(float deltaFrameTime);
+  Entity(const Entity&) = delete;
+  Entity& operator=(const Entity&) = delete;
 
   const std::string& type() const { return _type; }
+  EntityHandle handle() const { return _handle; }
+
+  glm::vec3 position() const { return _store.position(_handle); }
+  glm::vec3 velocity() const { return _store.velocity(_handle); }
+  glm::vec3 acceleration() const { return _store.acceleration(_handle); }
+  glm::vec3 desiredVelocity() const { return _store.desiredVelocity(_handle); }
+  void position(const glm::vec3& rhs) { _store.position(_handle, rhs); }
+  void velocity(const glm::vec3& rhs) { _store.velocity(_handle, rhs); }
+  void acceleration(const glm::vec3& rhs) { _store.acceleration(_handle, rhs); }
+  void desiredVelocity(const glm::vec3& rhs) { _store.desiredVelocity(_handle, rhs); }
+  glm::vec3 halfExtents() const { return _store.halfExtents(_handle); }
+  float stepHeight() const { return _store.stepHeight(_handle); }
+  void halfExtents(const glm::vec3& rhs) { _store.halfExtents(_handle, rhs); }
+  void stepHeight(float rhs) { _store.stepHeight(_handle, rhs); }
+  bool onGround() const { return _store.onGround(_handle); }
+
   const glm::vec3& direction() const { return _direction; }
   const glm::vec2& rotation() const { return _rotation; }
   void direction(const glm::vec3& rhs) {
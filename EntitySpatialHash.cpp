@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <bit>
+#include "EntitySpatialHash.hpp"
+
+EntitySpatialHash::EntitySpatialHash(float cellSize_) : _cellSize(cellSize_), _bucketStarts(2, 0) {}
+
+uint32_t EntitySpatialHash::bucketOf(const glm::ivec3& cell) const {
+  uint32_t h = (uint32_t) cell.x * 73856093u ^ (uint32_t) cell.y * 19349663u ^ (uint32_t) cell.z * 83492791u;
+  return h & _bucketMask;
+}
+
+void EntitySpatialHash::rebuild(const EntityStore& entities) {
+  size_t count = entities.size();
+  const Vec3Arrays& positions = entities.positions();
+
+  // About two buckets per entity keeps the collisions between distinct cells rare
+  _bucketMask = std::bit_ceil(std::max(count * 2, (size_t) 1)) - 1;
+  _bucketStarts.assign(_bucketMask + 2, 0);
+  _entityBuckets.resize(count);
+  for (size_t i = 0; i < count; i++) {
+    uint32_t bucket = bucketOf(cellOf(positions.get(i)));
+    _entityBuckets[i] = bucket;
+    _bucketStarts[bucket + 1]++;
+  }
+  for (size_t bucket = 1; bucket < _bucketStarts.size(); bucket++) {
+    _bucketStarts[bucket] += _bucketStarts[bucket - 1];
+  }
+
+  _indices.resize(count);
+  _positions.resize(count);
+  _cells.resize(count);
+  // Scatter with the starts as cursors, which leaves each one at the start of the next bucket
+  for (size_t i = 0; i < count; i++) {
+    uint32_t slot = _bucketStarts[_entityBuckets[i]]++;
+    glm::vec3 position = positions.get(i);
+    _indices[slot] = i;
+    _positions.set(slot, position);
+    _cells[slot] = cellOf(position);
+  }
+  std::copy_backward(_bucketStarts.begin(), _bucketStarts.end() - 1, _bucketStarts.end());
+  _bucketStarts[0] = 0;
+}
+
+template<typename Accept>
+void EntitySpatialHash::query(const glm::ivec3& cellMin, const glm::ivec3& cellMax, std::vector<uint32_t>& out, const Accept& accept) const {
+  // A query larger than the table is cheaper as a scan of every entity than as a walk over mostly empty cells
+  int64_t countX = (int64_t) cellMax.x - cellMin.x + 1;
+  int64_t countY = (int64_t) cellMax.y - cellMin.y + 1;
+  int64_t countZ = (int64_t) cellMax.z - cellMin.z + 1;
+  if (countX <= 0 || countY <= 0 || countZ <= 0) return;
+  if (countX * countY * countZ > (int64_t) _bucketMask + 1) {
+    for (size_t i = 0; i < _indices.size(); i++) {
+      if (accept(i)) out.push_back(_indices[i]);
+    }
+    return;
+  }
+
+  for (int z = cellMin.z; z <= cellMax.z; z++) {
+    for (int y = cellMin.y; y <= cellMax.y; y++) {
+      for (int x = cellMin.x; x <= cellMax.x; x++) {
+        glm::ivec3 cell(x, y, z);
+        uint32_t bucket = bucketOf(cell);
+        for (uint32_t i = _bucketStarts[bucket]; i < _bucketStarts[bucket + 1]; i++) {
+          // Other cells hashed to the same bucket are skipped, they are visited with their own cell if they are in range
+          if (_cells[i] == cell && accept(i)) out.push_back(_indices[i]);
+        }
+      }
+    }
+  }
+}
+
+void EntitySpatialHash::queryRadius(const glm::vec3& center, float radius, std::vector<uint32_t>& out) const {
+  float radiusSquared = radius * radius;
+  query(cellOf(center - radius), cellOf(center + radius), out, [this, center, radiusSquared] (size_t i) {
+    float dx = _positions.x[i] - center.x;
+    float dy = _positions.y[i] - center.y;
+    float dz = _positions.z[i] - center.z;
+    return dx * dx + dy * dy + dz * dz <= radiusSquared;
+  });
+}
+
+void EntitySpatialHash::queryBox(const glm::vec3& min, const glm::vec3& max, std::vector<uint32_t>& out) const {
+  query(cellOf(min), cellOf(max), out, [this, min, max] (size_t i) {
+    return _positions.x[i] >= min.x && _positions.x[i] <= max.x &&
+      _positions.y[i] >= min.y && _positions.y[i] <= max.y &&
+      _positions.z[i] >= min.z && _positions.z[i] <= max.z;
+  });
+}
@@ -0,0 +1,49 @@
+#ifndef _ENTITY_SPATIAL_HASH_HPP_
+#define _ENTITY_SPATIAL_HASH_HPP_
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "EntityStore.hpp"
+
+// Broad phase for finding the entities near a point or in a box, without testing every entity
+// Positions are bucketed in a uniform grid of cubic cells, hashed into a table sized for the entity count
+// The table is rebuilt from the store with a counting sort, so that the entities of a bucket are contiguous in flat arrays
+class EntitySpatialHash {
+private:
+  float _cellSize;
+  uint32_t _bucketMask = 0; // bucket count - 1, the count is a power of two
+
+  // Entity positions, sorted by bucket
+  std::vector<uint32_t> _bucketStarts; // offset of each bucket's first entity, with the total count at the end
+  std::vector<uint32_t> _indices; // into the dense arrays of the store
+  Vec3Arrays _positions;
+  std::vector<glm::ivec3> _cells;
+
+  std::vector<uint32_t> _entityBuckets; // reused while rebuilding
+
+  glm::ivec3 cellOf(const glm::vec3& position) const { return glm::ivec3(glm::floor(position / _cellSize)); }
+  uint32_t bucketOf(const glm::ivec3& cell) const;
+
+  // Append the entities in the cells from cellMin to cellMax inclusive for which accept(i) holds
+  template<typename Accept>
+  void query(const glm::ivec3& cellMin, const glm::ivec3& cellMax, std::vector<uint32_t>& out, const Accept& accept) const;
+
+public:
+  static constexpr float DEFAULT_CELL_SIZE = 4.f;
+
+  explicit EntitySpatialHash(float cellSize_ = DEFAULT_CELL_SIZE);
+
+  float cellSize() const { return _cellSize; }
+  size_t size() const { return _indices.size(); }
+
+  // Index the current positions of all entities in the store
+  // Only allocates when the store has grown since the last rebuild
+  void rebuild(const EntityStore& entities);
+
+  // Append the dense indices of the entities whose positions are within radius of center, or inside the box (bounds included)
+  // Indices refer to the store as of the last rebuild, they are invalidated by destroying entities
+  void queryRadius(const glm::vec3& center, float radius, std::vector<uint32_t>& out) const;
+  void queryBox(const glm::vec3& min, const glm::vec3& max, std::vector<uint32_t>& out) const;
+};
+
+#endif
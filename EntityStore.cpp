@@ -0,0 +1,220 @@
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include <glm/ext/scalar_constants.hpp>
+#include "EntityStore.hpp"
+#include "Collision.hpp"
+#include "Metrics.hpp"
+
+namespace {
+
+// Branch-free approximation of atan(x) for x >= 0, with an absolute error below 1e-5
+// Unlike std::atan it can be inlined into loops, so that the compiler is able to vectorize them
+// Both sides of every selection are computed unconditionally, a conditional division would count as control flow
+inline float atanNonNegative(float x) {
+  bool inverted = x > 1.f;
+  float inverse = 1.f / std::max(x, 1.f);
+  float t = inverted ? inverse : x;
+  float t2 = t * t;
+  float a = t * (0.9998660f + t2 * (-0.3302995f + t2 * (0.1801410f + t2 * (-0.0851330f + t2 * 0.0208351f))));
+  return inverted ? glm::pi<float>() / 2.f - a : a;
+}
+
+// A function that is close to 1 most of the time, but diminishes to 0 as it approaches 0
+// This function exists because when calculating accelerations to reach a desired velocity, multiplying a constant to vecsign(velocity) results in a value as big as the constant, even if the velocity is very close to (but not exactly) 0. Then after adding the resultant acceleration to the velocity, it overshoots to the other side of the desired velocity. On the following frames, this process repeats, velocity always oscillating around the desired velocity but never reaching it. To work around this problem, the aforementioned constant should be multiplied by this function, so that as velocity approaches 0, it will be less likely to overshoot. (It will probably still overshoot thus oscillate if the constant is large or framerate is low, but we don't care about those cases.)
+// Only called with lengths, so v >= 0
+inline float diminishTowardsZero(float v) {
+  return 2.f / glm::pi<float>() * atanNonNegative(v);
+}
+
+// Reciprocal of a length, or 0 if the length is 0, so that multiplying by it is like normalize(v) but gives 0 instead of NaN (vecsign)
+inline float inverseOrZero(float length) {
+  float inverse = 1.f / std::max(length, 1e-30f);
+  return length > 0.f ? inverse : 0.f;
+}
+
+// The arrays are passed as restrict parameters, GCC ignores restrict on local pointers and would give up on vectorizing because of the number of alias checks
+void updateVelocities(float deltaTime, size_t begin, size_t end,
+                      float* __restrict vx, float* __restrict vy, float* __restrict vz,
+                      float* __restrict ax, float* __restrict ay, float* __restrict az,
+                      float* __restrict dx, float* __restrict dy, float* __restrict dz) {
+  // Written without branches, every value is computed and then selected, so that the loop is vectorized
+  for (size_t i = begin; i < end; i++) {
+    float accelerationX = ax[i];
+    float accelerationY = ay[i];
+    float accelerationZ = az[i];
+
+    // Try to reach target velocity
+    float differenceX = dx[i] - vx[i];
+    float differenceY = dy[i] - vy[i];
+    float differenceZ = dz[i] - vz[i];
+    float differenceLength = std::sqrt(differenceX * differenceX + differenceY * differenceY + differenceZ * differenceZ);
+    float towardsDesired = 8.f * diminishTowardsZero(differenceLength) * inverseOrZero(differenceLength);
+    towardsDesired = (differenceLength > 0.001f) ? towardsDesired : 0.f;
+    accelerationX += differenceX * towardsDesired;
+    accelerationY += differenceY * towardsDesired;
+    accelerationZ += differenceZ * towardsDesired;
+
+    // Deceleration caused by friction/drag
+    float speed = std::sqrt(vx[i] * vx[i] + vy[i] * vy[i] + vz[i] * vz[i]);
+    float friction = (2.1f * diminishTowardsZero(speed) + 0.01f * speed * speed) * inverseOrZero(speed);
+    accelerationX -= vx[i] * friction;
+    accelerationY -= vy[i] * friction;
+    accelerationZ -= vz[i] * friction;
+
+    // Velocity can be so small but not quite 0 but friction becomes 0,
+    // so it keeps having this small value, just set it to 0 in thit case
+    float accelerationLength = std::sqrt(accelerationX * accelerationX + accelerationY * accelerationY + accelerationZ * accelerationZ);
+    bool rest = speed < 0.00001f && accelerationLength < 0.00001f;
+    float velocityX = vx[i] + accelerationX * deltaTime;
+    float velocityY = vy[i] + accelerationY * deltaTime;
+    float velocityZ = vz[i] + accelerationZ * deltaTime;
+    velocityX = rest ? 0.f : velocityX;
+    velocityY = rest ? 0.f : velocityY;
+    velocityZ = rest ? 0.f : velocityZ;
+    vx[i] = velocityX;
+    vy[i] = velocityY;
+    vz[i] = velocityZ;
+
+    // Reset parameters for the next frame
+    ax[i] = 0.f;
+    ay[i] = 0.f;
+    az[i] = 0.f;
+    dx[i] = 0.f;
+    dy[i] = 0.f;
+    dz[i] = 0.f;
+  }
+}
+
+void integratePositions(float deltaTime, size_t begin, size_t end,
+                        float* __restrict px, float* __restrict py, float* __restrict pz,
+                        const float* __restrict vx, const float* __restrict vy, const float* __restrict vz) {
+  for (size_t i = begin; i < end; i++) {
+    px[i] += vx[i] * deltaTime;
+    py[i] += vy[i] * deltaTime;
+    pz[i] += vz[i] * deltaTime;
+  }
+}
+
+}
+
+EntityHandle EntityStore::create(const glm::vec3& position) {
+  uint32_t slot;
+  if (!_freeSlots.empty()) {
+    slot = _freeSlots.back();
+    _freeSlots.pop_back();
+  } else {
+    slot = _slotToDense.size();
+    _slotToDense.push_back(0);
+    _slotGenerations.push_back(0);
+  }
+
+  _slotToDense[slot] = _denseToSlot.size();
+  _denseToSlot.push_back(slot);
+  _positions.push_back(position);
+  _velocities.push_back(glm::vec3(0.f));
+  _accelerations.push_back(glm::vec3(0.f));
+  _desiredVelocities.push_back(glm::vec3(0.f));
+  _halfExtents.push_back(glm::vec3(0.f));
+  _stepHeights.push_back(0.f);
+  _onGround.push_back(false);
+
+  return EntityHandle{slot, _slotGenerations[slot]};
+}
+
+void EntityStore::destroy(EntityHandle handle) {
+  if (!valid(handle)) {
+    throw std::invalid_argument("entity handle is not valid");
+  }
+
+  // Keep the arrays dense by moving the last entity into the hole
+  size_t index = _slotToDense[handle.slot];
+  size_t lastIndex = _denseToSlot.size() - 1;
+  if (index != lastIndex) {
+    _positions.set(index, _positions.get(lastIndex));
+    _velocities.set(index, _velocities.get(lastIndex));
+    _accelerations.set(index, _accelerations.get(lastIndex));
+    _desiredVelocities.set(index, _desiredVelocities.get(lastIndex));
+    _halfExtents.set(index, _halfExtents.get(lastIndex));
+    _stepHeights[index] = _stepHeights[lastIndex];
+    _onGround[index] = _onGround[lastIndex];
+    _denseToSlot[index] = _denseToSlot[lastIndex];
+    _slotToDense[_denseToSlot[index]] = index;
+  }
+  _positions.pop_back();
+  _velocities.pop_back();
+  _accelerations.pop_back();
+  _desiredVelocities.pop_back();
+  _halfExtents.pop_back();
+  _stepHeights.pop_back();
+  _onGround.pop_back();
+  _denseToSlot.pop_back();
+
+  _slotGenerations[handle.slot]++;
+  _freeSlots.push_back(handle.slot);
+}
+
+bool EntityStore::valid(EntityHandle handle) const {
+  return handle.slot < _slotGenerations.size() && _slotGenerations[handle.slot] == handle.generation;
+}
+
+void EntityStore::reserve(size_t count) {
+  _positions.reserve(count);
+  _velocities.reserve(count);
+  _accelerations.reserve(count);
+  _desiredVelocities.reserve(count);
+  _halfExtents.reserve(count);
+  _stepHeights.reserve(count);
+  _onGround.reserve(count);
+  _denseToSlot.reserve(count);
+}
+
+void EntityStore::positionsBySlot(std::vector<glm::vec3>& out) const {
+  out.resize(_slotToDense.size());
+  for (size_t i = 0; i < size(); i++) {
+    out[_denseToSlot[i]] = _positions.get(i);
+  }
+}
+
+void EntityStore::update(float deltaTime, const BlocksMap* blocksMap, ThreadPool* threadPool) {
+  size_t count = size();
+  static Metric& tickedEntities = Metrics::counter("entities.ticked");
+  tickedEntities.add(count);
+  size_t taskCount = threadPool ? std::min(threadPool->threadCount(), count / MIN_ENTITIES_PER_TASK) : 1;
+
+  if (taskCount <= 1) {
+    updateRange(deltaTime, blocksMap, 0, count);
+    return;
+  }
+
+  threadPool->run(taskCount, [this, deltaTime, blocksMap, count, taskCount] (size_t task) {
+    updateRange(deltaTime, blocksMap, count * task / taskCount, count * (task + 1) / taskCount);
+  });
+}
+
+void EntityStore::updateRange(float deltaTime, const BlocksMap* blocksMap, size_t begin, size_t end) {
+  updateVelocities(deltaTime, begin, end,
+                   _velocities.x.data(), _velocities.y.data(), _velocities.z.data(),
+                   _accelerations.x.data(), _accelerations.y.data(), _accelerations.z.data(),
+                   _desiredVelocities.x.data(), _desiredVelocities.y.data(), _desiredVelocities.z.data());
+
+  if (!blocksMap) {
+    integratePositions(deltaTime, begin, end,
+                       _positions.x.data(), _positions.y.data(), _positions.z.data(),
+                       _velocities.x.data(), _velocities.y.data(), _velocities.z.data());
+    return;
+  }
+
+  for (size_t i = begin; i < end; i++) {
+    glm::vec3 position = _positions.get(i);
+    glm::vec3 velocity = _velocities.get(i);
+    glm::vec3 halfExtents = _halfExtents.get(i);
+    AABB box{position - halfExtents, position + halfExtents};
+    MoveResult result = moveAndCollide(*blocksMap, box, velocity * deltaTime, _stepHeights[i], _onGround[i]);
+
+    _positions.set(i, position + result.displacement);
+    // Stop at walls instead of pushing against them, so that the velocity doesn't build up
+    _velocities.set(i, glm::mix(velocity, glm::vec3(0.f), glm::vec3(result.blocked)));
+    _onGround[i] = result.onGround;
+  }
+}
@@ -0,0 +1,90 @@
+#ifndef _ENTITY_STORE_HPP_
+#define _ENTITY_STORE_HPP_
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "ThreadPool.hpp"
+#include "BlocksMap.hpp"
+
+// Refers to an entity in an EntityStore, stays valid while other entities are created or destroyed
+struct EntityHandle {
+  uint32_t slot;
+  uint32_t generation;
+
+  bool operator==(const EntityHandle&) const = default;
+};
+
+// Three parallel arrays of the components of vectors
+struct Vec3Arrays {
+  std::vector<float> x, y, z;
+
+  glm::vec3 get(size_t i) const { return glm::vec3(x[i], y[i], z[i]); }
+  void set(size_t i, const glm::vec3& v) { x[i] = v.x; y[i] = v.y; z[i] = v.z; }
+  void push_back(const glm::vec3& v) { x.push_back(v.x); y.push_back(v.y); z.push_back(v.z); }
+  void pop_back() { x.pop_back(); y.pop_back(); z.pop_back(); }
+  void reserve(size_t n) { x.reserve(n); y.reserve(n); z.reserve(n); }
+  void resize(size_t n) { x.resize(n); y.resize(n); z.resize(n); }
+};
+
+// Physical state of all entities, stored as structure of arrays so that it can be updated in vectorized batches
+// Entities are kept densely packed, handles are translated to dense indices through slots
+class EntityStore {
+private:
+  Vec3Arrays _positions;
+  Vec3Arrays _velocities;
+  Vec3Arrays _accelerations;
+  Vec3Arrays _desiredVelocities;
+  Vec3Arrays _halfExtents; // of the bounding box centered on the position
+  std::vector<float> _stepHeights;
+  std::vector<uint8_t> _onGround;
+  std::vector<uint32_t> _denseToSlot;
+
+  std::vector<uint32_t> _slotToDense;
+  std::vector<uint32_t> _slotGenerations;
+  std::vector<uint32_t> _freeSlots;
+
+  void updateRange(float deltaTime, const BlocksMap* blocksMap, size_t begin, size_t end);
+
+public:
+  // Below this number of entities per thread, splitting the update is not worth it
+  static constexpr size_t MIN_ENTITIES_PER_TASK = 4096;
+
+  EntityHandle create(const glm::vec3& position);
+  void destroy(EntityHandle handle);
+  bool valid(EntityHandle handle) const;
+  size_t size() const { return _denseToSlot.size(); }
+  void reserve(size_t count);
+
+  size_t denseIndex(EntityHandle handle) const { return _slotToDense[handle.slot]; }
+  EntityHandle handle(size_t denseIndex_) const { uint32_t slot = _denseToSlot[denseIndex_]; return EntityHandle{slot, _slotGenerations[slot]}; }
+
+  glm::vec3 position(EntityHandle handle) const { return _positions.get(denseIndex(handle)); }
+  glm::vec3 velocity(EntityHandle handle) const { return _velocities.get(denseIndex(handle)); }
+  glm::vec3 acceleration(EntityHandle handle) const { return _accelerations.get(denseIndex(handle)); }
+  glm::vec3 desiredVelocity(EntityHandle handle) const { return _desiredVelocities.get(denseIndex(handle)); }
+  void position(EntityHandle handle, const glm::vec3& rhs) { _positions.set(denseIndex(handle), rhs); }
+  void velocity(EntityHandle handle, const glm::vec3& rhs) { _velocities.set(denseIndex(handle), rhs); }
+  void acceleration(EntityHandle handle, const glm::vec3& rhs) { _accelerations.set(denseIndex(handle), rhs); }
+  void desiredVelocity(EntityHandle handle, const glm::vec3& rhs) { _desiredVelocities.set(denseIndex(handle), rhs); }
+
+  // Collision shape, entities are points by default
+  glm::vec3 halfExtents(EntityHandle handle) const { return _halfExtents.get(denseIndex(handle)); }
+  float stepHeight(EntityHandle handle) const { return _stepHeights[denseIndex(handle)]; }
+  void halfExtents(EntityHandle handle, const glm::vec3& rhs) { _halfExtents.set(denseIndex(handle), rhs); }
+  void stepHeight(EntityHandle handle, float rhs) { _stepHeights[denseIndex(handle)] = rhs; }
+  // Standing on a block after the last update()
+  bool onGround(EntityHandle handle) const { return _onGround[denseIndex(handle)]; }
+
+  // Dense arrays for batch processing, indices are invalidated by destroy()
+  const Vec3Arrays& positions() const { return _positions; }
+  const Vec3Arrays& velocities() const { return _velocities; }
+  // Copy the positions out indexed by slot, so that they can still be found by handle after entities are destroyed
+  void positionsBySlot(std::vector<glm::vec3>& out) const;
+
+  // Apply the acceleration/friction model to all entities for one frame
+  // With a map, entities are moved with their bounding boxes colliding against its blocks, otherwise they pass through everything
+  // With a thread pool, large stores are split into chunks updated in parallel
+  void update(float deltaTime, const BlocksMap* blocksMap = nullptr, ThreadPool* threadPool = nullptr);
+};
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef _FRAMEBUFFER_HPP_
+#define _FRAMEBUFFER_HPP_
+#include <GL/glew.h>
+#include "ApplicationException.hpp"
+
+// Offscreen render target with a color and a depth renderbuffer
+class Framebuffer {
+private:
+  GLuint _id;
+  GLuint _colorRenderbuffer;
+  GLuint _depthRenderbuffer;
+  GLsizei _width;
+  GLsizei _height;
+
+public:
+  Framebuffer(GLsizei width_, GLsizei height_) : _width(width_), _height(height_) {
+    glGenFramebuffers(1, &_id);
+    glGenRenderbuffers(1, &_colorRenderbuffer);
+    glGenRenderbuffers(1, &_depthRenderbuffer);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, _colorRenderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, _width, _height);
+    glBindRenderbuffer(GL_RENDERBUFFER, _depthRenderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, _width, _height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, _id);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, _colorRenderbuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, _depthRenderbuffer);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+      throw ApplicationException("Offscreen framebuffer is incomplete");
+    }
+  }
+  ~Framebuffer() {
+    glDeleteFramebuffers(1, &_id);
+    glDeleteRenderbuffers(1, &_colorRenderbuffer);
+    glDeleteRenderbuffers(1, &_depthRenderbuffer);
+  }
+
+  Framebuffer(const Framebuffer&) = delete;
+  Framebuffer& operator=(const Framebuffer&) = delete;
+
+  GLuint id() const { return _id; }
+  GLsizei width() const { return _width; }
+  GLsizei height() const { return _height; }
+
+  void bind() {
+    glBindFramebuffer(GL_FRAMEBUFFER, _id);
+  }
+};
+
+#endif
@@ -1,18 +1,37 @@
 #ifndef _GL_BUFFER__HPP_
 #define _GL_BUFFER__HPP_
 #include <GL/glew.h>
+#include "GLState.hpp"
+#include "Metrics.hpp"
+#include "MemoryTracking.hpp"
 
 class GLBuffer {
 private:
   GLuint _id;
   GLenum _type;
+  size_t _size = 0; // of the storage allocated by the last sendData()
+
+  static void countUpload(size_t bytes) {
+    static Metric& uploadedBytes = Metrics::counter("gl.buffer_bytes_uploaded");
+    static Metric& uploads = Metrics::counter("gl.buffer_uploads");
+    uploadedBytes.add(bytes);
+    uploads.add();
+  }
+
+  void accountStorage(size_t size) {
+    MemoryTracking::freed(MemoryTag::VRAM_BUFFERS, _size);
+    MemoryTracking::allocated(MemoryTag::VRAM_BUFFERS, size);
+    _size = size;
+  }
 
 public:
   GLBuffer(GLenum type_) : _type(type_) {
     glGenBuffers(1, &_id);
   }
   ~GLBuffer() {
+    MemoryTracking::freed(MemoryTag::VRAM_BUFFERS, _size);
     glDeleteBuffers(1, &_id);
+    GLState::bufferDeleted(_id);
   }
 
   GLBuffer(const GLBuffer&) = delete;
@@ -21,17 +40,27 @@ public:
   GLuint id() const { return _id; }
 
   void bind() {
-    glBindBuffer(_type, _id);
+    GLState::bindBuffer(_type, _id);
   }
 
   template <typename C>
   void sendData(const C& dataContainer, GLenum usage) {
+    countUpload(dataContainer.size() * sizeof(typename C::value_type));
+    accountStorage(dataContainer.size() * sizeof(typename C::value_type));
     glBufferData(_type, dataContainer.size() * sizeof(typename C::value_type), dataContainer.data(), usage);
   }
 
   void sendData(size_t size, GLenum usage) {
+    accountStorage(size);
     glBufferData(_type, size, nullptr, usage);
   }
+
+  // Write into the storage allocated by sendData() from its start, without reallocating it
+  template <typename C>
+  void sendSubData(const C& dataContainer) {
+    countUpload(dataContainer.size() * sizeof(typename C::value_type));
+    glBufferSubData(_type, 0, dataContainer.size() * sizeof(typename C::value_type), dataContainer.data());
+  }
 };
 
 #endif
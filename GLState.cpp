@@ -0,0 +1,161 @@
+#include <limits>
+#include <vector>
+#include <unordered_map>
+#include "GLState.hpp"
+
+namespace {
+
+// Binding value that does not match any object name, so that the next bind is always issued
+constexpr GLuint UNKNOWN = std::numeric_limits<GLuint>::max();
+
+struct ShadowState {
+  // Objects that are not in the maps are bound to 0 when the state is known, or unknown after invalidate()
+  GLuint unlistedBinding = 0;
+
+  GLuint program = 0;
+  GLuint vertexArray = 0;
+  GLuint activeTextureUnit = 0;
+  std::unordered_map<GLenum, GLuint> buffers;
+  std::unordered_map<GLuint, GLuint> elementArrayBuffers; // keyed by VAO, because the binding is part of VAO state
+  std::vector<std::unordered_map<GLenum, GLuint>> textureUnits;
+
+  GLuint lookup(const std::unordered_map<GLenum, GLuint>& bindings, GLenum key) const {
+    auto it = bindings.find(key);
+    return it == bindings.end() ? unlistedBinding : it->second;
+  }
+};
+
+ShadowState state;
+GLState::Counters callCounters = {0, 0, 0, 0};
+
+// Record the new value, return whether the call needs to be issued
+bool update(GLuint& current, GLuint value) {
+  if (current == value && value != UNKNOWN) {
+    callCounters.elided++;
+    return false;
+  }
+  current = value;
+  callCounters.issued++;
+  return true;
+}
+
+}
+
+void GLState::useProgram(GLuint program) {
+  if (update(state.program, program)) {
+    glUseProgram(program);
+  }
+}
+
+void GLState::bindVertexArray(GLuint vertexArray) {
+  if (update(state.vertexArray, vertexArray)) {
+    glBindVertexArray(vertexArray);
+  }
+}
+
+void GLState::bindBuffer(GLenum target, GLuint buffer) {
+  if (target == GL_ELEMENT_ARRAY_BUFFER) {
+    if (state.vertexArray == UNKNOWN) {
+      callCounters.issued++;
+      glBindBuffer(target, buffer);
+      return;
+    }
+    GLuint current = state.lookup(state.elementArrayBuffers, state.vertexArray);
+    if (update(current, buffer)) {
+      state.elementArrayBuffers[state.vertexArray] = buffer;
+      glBindBuffer(target, buffer);
+    }
+    return;
+  }
+
+  GLuint current = state.lookup(state.buffers, target);
+  if (update(current, buffer)) {
+    state.buffers[target] = buffer;
+    glBindBuffer(target, buffer);
+  }
+}
+
+void GLState::bindTexture(GLuint unit, GLenum target, GLuint texture) {
+  if (state.textureUnits.size() <= unit) {
+    state.textureUnits.resize(unit + 1);
+  }
+
+  GLuint current = state.lookup(state.textureUnits[unit], target);
+  if (current == texture && texture != UNKNOWN) {
+    callCounters.elided++;
+    return;
+  }
+
+  if (update(state.activeTextureUnit, unit)) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+  }
+  callCounters.issued++;
+  state.textureUnits[unit][target] = texture;
+  glBindTexture(target, texture);
+}
+
+void GLState::drawElements(GLenum mode, GLsizei count, GLenum type, size_t offset) {
+  callCounters.drawCalls++;
+  if (mode == GL_TRIANGLES) {
+    callCounters.triangles += count / 3;
+  }
+  glDrawElements(mode, count, type, (void*) offset);
+}
+
+void GLState::drawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instanceCount) {
+  callCounters.drawCalls++;
+  if (mode == GL_TRIANGLES) {
+    callCounters.triangles += count / 3 * instanceCount;
+  }
+  glDrawArraysInstanced(mode, first, count, instanceCount);
+}
+
+void GLState::programDeleted(GLuint program) {
+  // A deleted program stays in use until another one is installed, but its name may be reused afterwards
+  if (state.program == program) {
+    state.program = UNKNOWN;
+  }
+}
+
+void GLState::vertexArrayDeleted(GLuint vertexArray) {
+  if (state.vertexArray == vertexArray) {
+    state.vertexArray = 0;
+  }
+  state.elementArrayBuffers.erase(vertexArray);
+}
+
+void GLState::bufferDeleted(GLuint buffer) {
+  for (auto& [target, binding] : state.buffers) {
+    if (binding == buffer) binding = 0;
+  }
+  for (auto& [vertexArray, binding] : state.elementArrayBuffers) {
+    // Only the bound VAO loses the attachment, other VAOs still refer to the deleted buffer
+    if (binding == buffer) binding = (vertexArray == state.vertexArray) ? 0 : UNKNOWN;
+  }
+}
+
+void GLState::texturesDeleted(GLsizei count, const GLuint* textures) {
+  for (GLsizei i = 0; i < count; i++) {
+    for (auto& unit : state.textureUnits) {
+      for (auto& [target, binding] : unit) {
+        if (binding == textures[i]) binding = 0;
+      }
+    }
+  }
+}
+
+void GLState::invalidate() {
+  state = ShadowState();
+  state.unlistedBinding = UNKNOWN;
+  state.program = UNKNOWN;
+  state.vertexArray = UNKNOWN;
+  state.activeTextureUnit = UNKNOWN;
+}
+
+const GLState::Counters& GLState::counters() {
+  return callCounters;
+}
+
+void GLState::resetCounters() {
+  callCounters = {0, 0, 0, 0};
+}
@@ -0,0 +1,39 @@
+#ifndef _GL_STATE_HPP_
+#define _GL_STATE_HPP_
+#include <cstddef>
+#include <GL/glew.h>
+
+// Shadows the binding state of the GL context (program, VAO, buffers, texture units), so that calls which would not change anything are not sent to the driver
+// All bindings done by the wrapper classes go through here, code that changes these bindings directly must call invalidate() afterwards
+class GLState {
+public:
+  struct Counters {
+    size_t issued; // calls sent to GL
+    size_t elided; // calls skipped because the state was already as requested
+    size_t drawCalls;
+    size_t triangles;
+  };
+
+  static void useProgram(GLuint program);
+  static void bindVertexArray(GLuint vertexArray);
+  static void bindBuffer(GLenum target, GLuint buffer);
+  static void bindTexture(GLuint unit, GLenum target, GLuint texture);
+
+  // Draw calls are not elided, they only go through here to be counted
+  static void drawElements(GLenum mode, GLsizei count, GLenum type, size_t offset);
+  static void drawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instanceCount);
+
+  // Deleting an object implicitly unbinds it, these keep the shadow state in sync
+  static void programDeleted(GLuint program);
+  static void vertexArrayDeleted(GLuint vertexArray);
+  static void bufferDeleted(GLuint buffer);
+  static void texturesDeleted(GLsizei count, const GLuint* textures);
+
+  // Forget everything, the next call to each binding function will be issued
+  static void invalidate();
+
+  static const Counters& counters();
+  static void resetCounters();
+};
+
+#endif
@@ -0,0 +1,79 @@
+#include <cstring>
+#include <cerrno>
+#include "InputRecording.hpp"
+
+namespace {
+
+const char MAGIC[4] = {'U', 'B', 'G', 'I'};
+const uint8_t VERSION = 1;
+const uint8_t HAS_CURSOR_DELTA = 1 << 7;
+
+template <typename T>
+void writeValue(std::ofstream& file, const T& value) {
+  file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool readValue(std::ifstream& file, T& value) {
+  return (bool) file.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+}
+
+InputRecorder::InputRecorder(const std::string& filename) : _file(filename, std::ios::binary | std::ios::trunc) {
+  if (!_file.is_open()) {
+    std::string msg = strerror(errno);
+    throw InputRecordingException("Cannot open input recording " + filename + " for writing: " + msg);
+  }
+  _file.write(MAGIC, sizeof(MAGIC));
+  writeValue(_file, VERSION);
+}
+
+void InputRecorder::record(const FrameInput& input) {
+  bool hasCursorDelta = input.cursorDelta != glm::vec2(0.f);
+  writeValue<uint8_t>(_file, input.keys | (hasCursorDelta ? HAS_CURSOR_DELTA : 0));
+  writeValue(_file, input.deltaTime);
+  if (hasCursorDelta) {
+    writeValue(_file, input.cursorDelta.x);
+    writeValue(_file, input.cursorDelta.y);
+  }
+  if (!_file.good()) {
+    throw InputRecordingException("Cannot write input recording");
+  }
+}
+
+InputReplayer::InputReplayer(const std::string& filename) : _file(filename, std::ios::binary) {
+  if (!_file.is_open()) {
+    std::string msg = strerror(errno);
+    throw InputRecordingException("Cannot open input recording " + filename + ": " + msg);
+  }
+
+  char magic[sizeof(MAGIC)];
+  uint8_t version;
+  if (!_file.read(magic, sizeof(magic)) || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || !readValue(_file, version)) {
+    throw InputRecordingException(filename + " is not an input recording");
+  }
+  if (version != VERSION) {
+    throw InputRecordingException("Unsupported input recording version " + std::to_string(version));
+  }
+}
+
+std::optional<FrameInput> InputReplayer::next() {
+  uint8_t flags;
+  if (!readValue(_file, flags)) return {};
+
+  FrameInput input;
+  input.keys = flags & ~HAS_CURSOR_DELTA;
+  input.cursorDelta = glm::vec2(0.f);
+  if (!readValue(_file, input.deltaTime)) {
+    throw InputRecordingException("Input recording is truncated");
+  }
+  if (flags & HAS_CURSOR_DELTA) {
+    if (!readValue(_file, input.cursorDelta.x) || !readValue(_file, input.cursorDelta.y)) {
+      throw InputRecordingException("Input recording is truncated");
+    }
+  }
+
+  _frameIndex++;
+  return input;
+}
@@ -0,0 +1,58 @@
+#ifndef _INPUT_RECORDING_HPP_
+#define _INPUT_RECORDING_HPP_
+#include <string>
+#include <fstream>
+#include <optional>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "ApplicationException.hpp"
+
+// Bits of FrameInput::keys
+enum InputKey : uint8_t {
+  INPUT_KEY_FORWARD = 1 << 0,
+  INPUT_KEY_BACKWARD = 1 << 1,
+  INPUT_KEY_LEFT = 1 << 2,
+  INPUT_KEY_RIGHT = 1 << 3,
+  INPUT_KEY_UP = 1 << 4,
+  INPUT_KEY_DOWN = 1 << 5,
+  INPUT_KEY_BREAK_BLOCK = 1 << 6, // clicked during the frame rather than held
+};
+
+// Everything from the user that affects the game during one frame
+struct FrameInput {
+  float deltaTime;
+  uint8_t keys; // held keys and clicks, bitmask of InputKey
+  glm::vec2 cursorDelta;
+};
+
+// File layout: "UBGI", version byte, then one record per frame:
+// flags byte (key bits, and bit 7 set if a cursor delta follows), frame delta time as float, optionally cursor delta as 2 floats
+// Floats are stored in host byte order
+class InputRecorder {
+private:
+  std::ofstream _file;
+
+public:
+  InputRecorder(const std::string& filename);
+
+  void record(const FrameInput& input);
+};
+
+class InputReplayer {
+private:
+  std::ifstream _file;
+  size_t _frameIndex = 0;
+
+public:
+  InputReplayer(const std::string& filename);
+
+  // Empty when the recording has ended
+  std::optional<FrameInput> next();
+  size_t frameIndex() const { return _frameIndex; }
+};
+
+class InputRecordingException : public ApplicationException {
+  using ApplicationException::ApplicationException;
+};
+
+#endif
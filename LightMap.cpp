@@ -0,0 +1,277 @@
+#include "LightMap.hpp"
+
+namespace {
+
+const glm::ivec3 NEIGHBOR_DIRECTIONS[6] = {
+  {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1},
+};
+const int DOWN = 3; // index in NEIGHBOR_DIRECTIONS
+
+}
+
+LightMap::LightMap(const BlocksMap& blocksMap_) : _blocksMap(blocksMap_) {
+  _sectionCount = (_blocksMap.size + SECTION_SIZE - 1) / SECTION_SIZE;
+  _sections.resize(_sectionCount.x * _sectionCount.y * _sectionCount.z);
+  recompute();
+}
+
+bool LightMap::inside(glm::ivec3 position) const {
+  glm::ivec3 internalPosition = position - _blocksMap.basePosition;
+  return
+    (unsigned) internalPosition.x < (unsigned) _blocksMap.size.x &&
+    (unsigned) internalPosition.y < (unsigned) _blocksMap.size.y &&
+    (unsigned) internalPosition.z < (unsigned) _blocksMap.size.z;
+}
+
+bool LightMap::opaque(glm::ivec3 position) const {
+  const Block* block = _blocksMap.get(position);
+  return block && _blocksMap.registry().opaque(block->id());
+}
+
+uint8_t LightMap::get(Channel channel, glm::ivec3 position) const {
+  glm::ivec3 internalPosition = position - _blocksMap.basePosition;
+  glm::ivec3 section = internalPosition / SECTION_SIZE;
+  glm::ivec3 local = internalPosition % SECTION_SIZE;
+  const Section& s = _sections[(section.y * _sectionCount.z + section.z) * _sectionCount.x + section.x];
+  size_t index = (local.y * SECTION_SIZE + local.z) * SECTION_SIZE + local.x;
+  const NibbleArray& nibbles = channel == SKY ? s.skyLight : s.blockLight;
+  return (nibbles[index / 2] >> (index % 2 * 4)) & 0xf;
+}
+
+void LightMap::set(Channel channel, glm::ivec3 position, uint8_t level) {
+  glm::ivec3 internalPosition = position - _blocksMap.basePosition;
+  glm::ivec3 section = internalPosition / SECTION_SIZE;
+  glm::ivec3 local = internalPosition % SECTION_SIZE;
+  Section& s = _sections[(section.y * _sectionCount.z + section.z) * _sectionCount.x + section.x];
+  size_t index = (local.y * SECTION_SIZE + local.z) * SECTION_SIZE + local.x;
+  NibbleArray& nibbles = channel == SKY ? s.skyLight : s.blockLight;
+  int shift = index % 2 * 4;
+  nibbles[index / 2] = (nibbles[index / 2] & ~(0xf << shift)) | (level << shift);
+}
+
+uint8_t LightMap::skyLight(glm::ivec3 position) const {
+  return inside(position) ? get(SKY, position) : MAX_LIGHT;
+}
+
+uint8_t LightMap::blockLight(glm::ivec3 position) const {
+  return inside(position) ? get(BLOCK, position) : 0;
+}
+
+void LightMap::recompute() {
+  for (Section& section : _sections) {
+    section.skyLight.fill(0);
+    section.blockLight.fill(0);
+  }
+
+  const glm::ivec3& base = _blocksMap.basePosition;
+  const glm::ivec3& size = _blocksMap.size;
+
+  // Sky light falls down every column until it hits an opaque block
+  // skyBottoms holds the lowest cell of each column in full sky light, or the top of the map if there is none
+  std::vector<int> skyBottoms(size.x * size.z);
+  for (int z = 0; z < size.z; z++) {
+    for (int x = 0; x < size.x; x++) {
+      int y = base.y + size.y;
+      while (y > base.y && !opaque(glm::ivec3(base.x + x, y - 1, base.z + z))) {
+        y--;
+        set(SKY, glm::ivec3(base.x + x, y, base.z + z), MAX_LIGHT);
+      }
+      skyBottoms[z * size.x + x] = y;
+    }
+  }
+
+  // Only lit cells next to a shadowed one have to spread sideways, those are the parts of a column below the sky bottom of a neighbouring column
+  // This keeps a generated world from having to visit every cell
+  _addQueue.clear();
+  for (int z = 0; z < size.z; z++) {
+    for (int x = 0; x < size.x; x++) {
+      int skyBottom = skyBottoms[z * size.x + x];
+      for (int direction = 0; direction < 6; direction++) {
+        const glm::ivec3& offset = NEIGHBOR_DIRECTIONS[direction];
+        if (offset.y != 0) continue;
+        int neighborX = x + offset.x, neighborZ = z + offset.z;
+        if (neighborX < 0 || neighborX >= size.x || neighborZ < 0 || neighborZ >= size.z) continue;
+        int neighborSkyBottom = skyBottoms[neighborZ * size.x + neighborX];
+        for (int y = skyBottom; y < neighborSkyBottom; y++) {
+          if (!opaque(glm::ivec3(base.x + neighborX, y, base.z + neighborZ))) {
+            _addQueue.push_back(AddNode{glm::ivec3(base.x + x, y, base.z + z)});
+          }
+        }
+      }
+    }
+  }
+  propagateAdditions(SKY);
+
+  _addQueue.clear();
+  for (size_t i = 0; i < _blocksMap.storage.size(); i++) {
+    const std::optional<Block>& block = _blocksMap.storage[i];
+    uint8_t emission = block ? _blocksMap.registry().lightEmission(block->id()) : 0;
+    if (emission > 0) {
+      glm::ivec3 position = _blocksMap.calculatePosition(i);
+      set(BLOCK, position, emission);
+      _addQueue.push_back(AddNode{position});
+    }
+  }
+  propagateAdditions(BLOCK);
+}
+
+void LightMap::blockChanged(glm::ivec3 position) {
+  if (!inside(position)) return;
+
+  const Block* block = _blocksMap.get(position);
+  uint8_t emission = block ? _blocksMap.registry().lightEmission(block->id()) : 0;
+  bool nowOpaque = opaque(position);
+
+  for (Channel channel : {SKY, BLOCK}) {
+    _addQueue.clear();
+    _removeQueue.clear();
+
+    // Take away the light of the cell and everything lit by it, then let the surroundings fill it in again
+    uint8_t level = get(channel, position);
+    if (level > 0) {
+      set(channel, position, 0);
+      _removeQueue.push_back(RemoveNode{position, level});
+    }
+    if (!nowOpaque) {
+      for (const glm::ivec3& direction : NEIGHBOR_DIRECTIONS) {
+        glm::ivec3 neighbor = position + direction;
+        if (inside(neighbor) && get(channel, neighbor) > 0) {
+          _addQueue.push_back(AddNode{neighbor});
+        }
+      }
+      if (channel == SKY && position.y == _blocksMap.basePosition.y + _blocksMap.size.y - 1) {
+        // The sky above the map
+        set(SKY, position, MAX_LIGHT);
+        _addQueue.push_back(AddNode{position});
+      }
+    }
+    if (channel == BLOCK && emission > 0) {
+      set(BLOCK, position, emission);
+      _addQueue.push_back(AddNode{position});
+    }
+
+    propagateRemovals(channel);
+    propagateAdditions(channel);
+  }
+}
+
+void LightMap::regionChanged(const BlocksRegion& region) {
+  if (region.empty()) return;
+
+  // Light reaches MAX_LIGHT cells from where it passes through the region, except for full sky light which reaches all the way down
+  BlocksRegion affected = _blocksMap.clip(BlocksRegion{
+    glm::ivec3(region.min.x - MAX_LIGHT, _blocksMap.basePosition.y, region.min.z - MAX_LIGHT),
+    region.max + glm::ivec3(MAX_LIGHT),
+  });
+  size_t mapVolume = (size_t) _blocksMap.size.x * _blocksMap.size.y * _blocksMap.size.z;
+  if (affected.volume() * 2 > mapVolume) {
+    recompute();
+    return;
+  }
+
+  for (int y = affected.min.y; y < affected.max.y; y++) {
+    for (int z = affected.min.z; z < affected.max.z; z++) {
+      for (int x = affected.min.x; x < affected.max.x; x++) {
+        set(SKY, glm::ivec3(x, y, z), 0);
+        set(BLOCK, glm::ivec3(x, y, z), 0);
+      }
+    }
+  }
+
+  int topY = _blocksMap.basePosition.y + _blocksMap.size.y - 1;
+  for (Channel channel : {SKY, BLOCK}) {
+    _addQueue.clear();
+
+    // The light outside of the affected part does not depend on the region, spread it back in from the cells around it
+    for (int y = affected.min.y - 1; y <= affected.max.y; y++) {
+      for (int z = affected.min.z - 1; z <= affected.max.z; z++) {
+        for (int x = affected.min.x - 1; x <= affected.max.x; x++) {
+          bool border =
+            x < affected.min.x || x >= affected.max.x ||
+            y < affected.min.y || y >= affected.max.y ||
+            z < affected.min.z || z >= affected.max.z;
+          // Skip ahead over the inside of the row
+          if (!border) {
+            x = affected.max.x - 1;
+            continue;
+          }
+          glm::ivec3 position(x, y, z);
+          if (inside(position) && get(channel, position) > 0) {
+            _addQueue.push_back(AddNode{position});
+          }
+        }
+      }
+    }
+
+    for (int z = affected.min.z; z < affected.max.z; z++) {
+      for (int x = affected.min.x; x < affected.max.x; x++) {
+        for (int y = affected.min.y; y < affected.max.y; y++) {
+          glm::ivec3 position(x, y, z);
+          if (channel == SKY) {
+            // The sky above the map
+            if (y == topY && !opaque(position)) {
+              set(SKY, position, MAX_LIGHT);
+              _addQueue.push_back(AddNode{position});
+            }
+          } else {
+            const Block* block = _blocksMap.get(position);
+            uint8_t emission = block ? _blocksMap.registry().lightEmission(block->id()) : 0;
+            if (emission > 0) {
+              set(BLOCK, position, emission);
+              _addQueue.push_back(AddNode{position});
+            }
+          }
+        }
+      }
+    }
+
+    propagateAdditions(channel);
+  }
+}
+
+void LightMap::propagateRemovals(Channel channel) {
+  for (size_t head = 0; head < _removeQueue.size(); head++) {
+    RemoveNode node = _removeQueue[head];
+    for (int direction = 0; direction < 6; direction++) {
+      glm::ivec3 neighbor = node.position + NEIGHBOR_DIRECTIONS[direction];
+      if (!inside(neighbor)) continue;
+      uint8_t neighborLevel = get(channel, neighbor);
+      if (neighborLevel == 0) continue;
+
+      bool litByNode = neighborLevel < node.level ||
+        (channel == SKY && direction == DOWN && node.level == MAX_LIGHT && neighborLevel == MAX_LIGHT);
+      if (litByNode) {
+        set(channel, neighbor, 0);
+        _removeQueue.push_back(RemoveNode{neighbor, neighborLevel});
+        // Light sources keep their own light
+        const Block* neighborBlock = _blocksMap.get(neighbor);
+        uint8_t emission = neighborBlock ? _blocksMap.registry().lightEmission(neighborBlock->id()) : 0;
+        if (channel == BLOCK && emission > 0) {
+          set(BLOCK, neighbor, emission);
+          _addQueue.push_back(AddNode{neighbor});
+        }
+      } else {
+        // Lit from elsewhere, spread that light back into the removed area
+        _addQueue.push_back(AddNode{neighbor});
+      }
+    }
+  }
+}
+
+void LightMap::propagateAdditions(Channel channel) {
+  for (size_t head = 0; head < _addQueue.size(); head++) {
+    glm::ivec3 position = _addQueue[head].position;
+    uint8_t level = get(channel, position);
+    if (level <= 1) continue;
+
+    for (int direction = 0; direction < 6; direction++) {
+      glm::ivec3 neighbor = position + NEIGHBOR_DIRECTIONS[direction];
+      if (!inside(neighbor) || opaque(neighbor)) continue;
+      uint8_t neighborLevel = (channel == SKY && direction == DOWN && level == MAX_LIGHT) ? MAX_LIGHT : level - 1;
+      if (get(channel, neighbor) < neighborLevel) {
+        set(channel, neighbor, neighborLevel);
+        _addQueue.push_back(AddNode{neighbor});
+      }
+    }
+  }
+}
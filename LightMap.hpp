@@ -0,0 +1,68 @@
+#ifndef _LIGHT_MAP_HPP_
+#define _LIGHT_MAP_HPP_
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "BlocksMap.hpp"
+
+// Sky light and block light levels of every cell in a BlocksMap, spread by flood fill
+// Light loses one level per step, except that full sky light goes straight down without loss, and does not enter opaque blocks
+class LightMap {
+public:
+  static constexpr int SECTION_SIZE = 16;
+  static constexpr uint8_t MAX_LIGHT = 15;
+
+private:
+  // 4 bits per cell, two cells per byte
+  using NibbleArray = std::array<uint8_t, SECTION_SIZE * SECTION_SIZE * SECTION_SIZE / 2>;
+
+  struct Section {
+    NibbleArray skyLight;
+    NibbleArray blockLight;
+  };
+
+  enum Channel { SKY, BLOCK };
+
+  struct AddNode {
+    glm::ivec3 position;
+  };
+  struct RemoveNode {
+    glm::ivec3 position;
+    uint8_t level; // before it was removed
+  };
+
+  const BlocksMap& _blocksMap;
+  glm::ivec3 _sectionCount; // along each axis
+  std::vector<Section> _sections;
+
+  // Reused between updates so that they don't allocate
+  std::vector<AddNode> _addQueue;
+  std::vector<RemoveNode> _removeQueue;
+
+  bool inside(glm::ivec3 position) const;
+  bool opaque(glm::ivec3 position) const;
+  uint8_t get(Channel channel, glm::ivec3 position) const;
+  void set(Channel channel, glm::ivec3 position, uint8_t level);
+
+  void propagateRemovals(Channel channel);
+  void propagateAdditions(Channel channel);
+
+public:
+  // Light the whole map
+  LightMap(const BlocksMap& blocksMap_);
+
+  // Positions outside of the map are in full sky light and no block light
+  uint8_t skyLight(glm::ivec3 position) const;
+  uint8_t blockLight(glm::ivec3 position) const;
+
+  // Recompute everything, after bulk changes to the map
+  void recompute();
+  // Update the light around a block that was just placed, removed or replaced, only the cells whose light changes are visited
+  void blockChanged(glm::ivec3 position);
+  // Update the light after a bulk edit of the map, with the region returned by it
+  // The light is cleared and spread again in the part of the map it can have reached through the region
+  void regionChanged(const BlocksRegion& region);
+};
+
+#endif
@@ -0,0 +1,35 @@
+#include "MemoryTracking.hpp"
+
+const char* MemoryTracking::name(MemoryTag tag) {
+  switch (tag) {
+    case MemoryTag::BLOCK_STORAGE:
+      return "block_storage";
+    case MemoryTag::MESHES:
+      return "meshes";
+    case MemoryTag::TEXTURE_STAGING:
+      return "texture_staging";
+    case MemoryTag::PNG_DECODE:
+      return "png_decode";
+    case MemoryTag::SHADER_SOURCES:
+      return "shader_sources";
+    case MemoryTag::VRAM_BUFFERS:
+      return "vram_buffers";
+    case MemoryTag::VRAM_TEXTURES:
+      return "vram_textures";
+    default:
+      return "";
+  }
+}
+
+const std::array<MemoryTracking::TagMetrics, (size_t) MemoryTag::COUNT>& MemoryTracking::tagMetrics() {
+  // Looked up once, after that tracking an allocation is a few relaxed atomic operations
+  static const std::array<TagMetrics, (size_t) MemoryTag::COUNT> metrics = [] () {
+    std::array<TagMetrics, (size_t) MemoryTag::COUNT> result;
+    for (size_t i = 0; i < result.size(); i++) {
+      std::string prefix = std::string("memory.") + name((MemoryTag) i);
+      result[i] = TagMetrics{&Metrics::gauge(prefix + ".bytes"), &Metrics::gauge(prefix + ".peak_bytes"), &Metrics::counter(prefix + ".allocations")};
+    }
+    return result;
+  }();
+  return metrics;
+}
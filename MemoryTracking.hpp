@@ -0,0 +1,85 @@
+#ifndef _MEMORY_TRACKING_HPP_
+#define _MEMORY_TRACKING_HPP_
+#include <vector>
+#include <string>
+#include <array>
+#include <new>
+#include <cstddef>
+#include <cstdint>
+#include "Metrics.hpp"
+
+// What a block of memory is used for, so that the memory of the process can be broken down by subsystem
+enum class MemoryTag : uint8_t {
+  BLOCK_STORAGE, // BlocksMap cells and solid bits
+  MESHES, // BlocksMesh and BlockFacesMesh arrays
+  TEXTURE_STAGING, // pixels on their way to StreamingTextures
+  PNG_DECODE, // libpng's working memory while decoding
+  SHADER_SOURCES,
+  // GPU memory, estimated from the sizes given to GL since drivers do not report it
+  VRAM_BUFFERS,
+  VRAM_TEXTURES,
+  COUNT,
+};
+
+// Current and peak bytes and allocation counts of every tag
+// They are Metrics ("memory.<tag>.bytes", ".peak_bytes" and ".allocations"), so they go out with the snapshots and can be read at any time
+class MemoryTracking {
+private:
+  struct TagMetrics {
+    Metric* bytes;
+    Metric* peakBytes;
+    Metric* allocations;
+  };
+
+  static const std::array<TagMetrics, (size_t) MemoryTag::COUNT>& tagMetrics();
+
+public:
+  static const char* name(MemoryTag tag);
+
+  static void allocated(MemoryTag tag, size_t bytes) {
+    const TagMetrics& metrics = tagMetrics()[(size_t) tag];
+    metrics.peakBytes->raise(metrics.bytes->add(bytes));
+    metrics.allocations->add();
+  }
+  static void freed(MemoryTag tag, size_t bytes) {
+    tagMetrics()[(size_t) tag].bytes->add(-(int64_t) bytes);
+  }
+
+  static int64_t currentBytes(MemoryTag tag) { return tagMetrics()[(size_t) tag].bytes->value(); }
+  static int64_t peakBytes(MemoryTag tag) { return tagMetrics()[(size_t) tag].peakBytes->value(); }
+  static int64_t allocations(MemoryTag tag) { return tagMetrics()[(size_t) tag].allocations->value(); }
+};
+
+// Standard allocator that accounts what it allocates to a tag, for the containers of the subsystems being tracked
+template <typename T, MemoryTag tag>
+class TaggedAllocator {
+public:
+  using value_type = T;
+
+  TaggedAllocator() = default;
+  template <typename U>
+  TaggedAllocator(const TaggedAllocator<U, tag>&) {}
+
+  template <typename U>
+  struct rebind { using other = TaggedAllocator<U, tag>; };
+
+  T* allocate(size_t n) {
+    T* ptr = static_cast<T*>(::operator new(n * sizeof(T)));
+    MemoryTracking::allocated(tag, n * sizeof(T));
+    return ptr;
+  }
+  void deallocate(T* ptr, size_t n) {
+    MemoryTracking::freed(tag, n * sizeof(T));
+    ::operator delete(ptr);
+  }
+
+  template <typename U>
+  bool operator==(const TaggedAllocator<U, tag>&) const { return true; }
+};
+
+template <typename T, MemoryTag tag>
+using TaggedVector = std::vector<T, TaggedAllocator<T, tag>>;
+template <MemoryTag tag>
+using TaggedString = std::basic_string<char, std::char_traits<char>, TaggedAllocator<char, tag>>;
+
+#endif
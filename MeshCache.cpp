@@ -0,0 +1,237 @@
+#include <fstream>
+#include <filesystem>
+#include <unordered_set>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "MeshCache.hpp"
+#include "Metrics.hpp"
+
+namespace {
+
+const char MAGIC[4] = {'U', 'B', 'G', 'C'};
+const uint32_t VERSION = 1;
+
+// File layout: magic, VERSION, MESHER_VERSION (uint32), then per section:
+// key (uint64), vertex, opaque index and cutout index counts (uint32), the vertices, the opaque indices, the cutout indices
+// Everything is a multiple of 4 bytes, so the arrays in the mapping are aligned for BlockVertex and GLuint
+const size_t HEADER_BYTES = sizeof(MAGIC) + 2 * sizeof(uint32_t);
+const size_t ENTRY_HEADER_BYTES = sizeof(uint64_t) + 3 * sizeof(uint32_t);
+
+// 64-bit FNV-1a over whole values rather than bytes, it only has to tell sections apart
+class Hasher {
+private:
+  uint64_t _hash = 0xcbf29ce484222325ull;
+
+public:
+  void add(uint64_t value) {
+    _hash = (_hash ^ value) * 0x100000001b3ull;
+  }
+  void add(const void* data, size_t size) {
+    uint32_t word;
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i + sizeof(word) <= size; i += sizeof(word)) {
+      memcpy(&word, bytes + i, sizeof(word));
+      add(word);
+    }
+    for (size_t i = size / sizeof(word) * sizeof(word); i < size; i++) {
+      add(bytes[i]);
+    }
+  }
+  uint64_t hash() const { return _hash ^ (_hash >> 29); }
+};
+
+// Everything of the block types the mesher reads, so that editing blocks.txt or the models does not bring back stale meshes
+uint64_t registryFingerprint(const BlockRegistry& registry) {
+  Hasher hasher;
+  for (BlockId id = 0; id < registry.size(); id++) {
+    const std::string& name = registry.type(id).blockId();
+    hasher.add(name.data(), name.size());
+    hasher.add(registry.cutout(id));
+    const BakedModel& model = registry.model(id);
+    hasher.add(model.firstFace);
+    hasher.add(model.faceCount);
+    hasher.add(model.fullCube);
+    for (SideMask coverage : model.sideCoverage) {
+      hasher.add(coverage);
+    }
+  }
+  for (const BakedFace& face : registry.bakedFaces()) {
+    hasher.add(face.firstVertex);
+    hasher.add(face.firstIndex);
+    hasher.add(face.vertexCount);
+    hasher.add(face.indexCount);
+    hasher.add((uint8_t) face.cullSide);
+    hasher.add(face.overlappedSubcells);
+    hasher.add(face.textureX);
+    hasher.add(face.textureY);
+  }
+  hasher.add(registry.bakedVertices().data(), registry.bakedVertices().size() * sizeof(BlockVertex));
+  hasher.add(registry.bakedIndices().data(), registry.bakedIndices().size() * sizeof(GLuint));
+  return hasher.hash();
+}
+
+template <typename T>
+void writeValue(std::ofstream& file, const T& value) {
+  file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+}
+
+MeshCache::MeshCache(const std::string& filename_) : _filename(filename_) {
+  loadMapping();
+}
+
+MeshCache::~MeshCache() {
+  if (_mapping) munmap(const_cast<uint8_t*>(_mapping), _mappingSize);
+}
+
+void MeshCache::loadMapping() {
+  int fd = open(_filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return;
+  struct stat status;
+  if (fstat(fd, &status) != 0 || (size_t) status.st_size < HEADER_BYTES) {
+    close(fd);
+    return;
+  }
+  // The mapping stays valid when save() replaces the file, the new one is written aside and renamed over
+  void* mapping = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) return;
+  _mapping = static_cast<const uint8_t*>(mapping);
+  _mappingSize = status.st_size;
+
+  uint32_t version, mesherVersion;
+  memcpy(&version, _mapping + sizeof(MAGIC), sizeof(version));
+  memcpy(&mesherVersion, _mapping + sizeof(MAGIC) + sizeof(version), sizeof(mesherVersion));
+  if (memcmp(_mapping, MAGIC, sizeof(MAGIC)) != 0 || version != VERSION || mesherVersion != MESHER_VERSION) return;
+
+  // A truncated file keeps the sections before the cut
+  size_t offset = HEADER_BYTES;
+  while (_mappingSize - offset >= ENTRY_HEADER_BYTES) {
+    uint64_t key;
+    uint32_t counts[3];
+    memcpy(&key, _mapping + offset, sizeof(key));
+    memcpy(counts, _mapping + offset + sizeof(key), sizeof(counts));
+    size_t entryBytes = ENTRY_HEADER_BYTES + (size_t) counts[0] * sizeof(BlockVertex) + ((size_t) counts[1] + counts[2]) * sizeof(GLuint);
+    if (_mappingSize - offset < entryBytes) break;
+
+    const uint8_t* data = _mapping + offset + ENTRY_HEADER_BYTES;
+    Entry entry;
+    entry.vertices = reinterpret_cast<const BlockVertex*>(data);
+    entry.vertexCount = counts[0];
+    entry.opaqueIndices = reinterpret_cast<const GLuint*>(data + entry.vertexCount * sizeof(BlockVertex));
+    entry.opaqueCount = counts[1];
+    entry.cutoutIndices = entry.opaqueIndices + entry.opaqueCount;
+    entry.cutoutCount = counts[2];
+    _entries.emplace(key, entry);
+    offset += entryBytes;
+  }
+}
+
+void MeshCache::beginBuild(const BlocksMap& blocksMap) {
+  if (_fingerprintedRegistry != &blocksMap.registry()) {
+    _fingerprintedRegistry = &blocksMap.registry();
+    _registryFingerprint = registryFingerprint(blocksMap.registry());
+  }
+
+  // Sections meshed in this run that the last build did not use are out of date, those in the file cost nothing to keep until the next save
+  std::unordered_set<uint64_t> used(_used.begin(), _used.end());
+  for (auto it = _built.begin(); it != _built.end();) {
+    if (used.count(it->first)) {
+      ++it;
+    } else {
+      _entries.erase(it->first);
+      it = _built.erase(it);
+    }
+  }
+  _used.clear();
+}
+
+uint64_t MeshCache::sectionKey(const BlocksMap& blocksMap, const LightMap* lightMap, glm::ivec3 min, glm::ivec3 max) const {
+  Hasher hasher;
+  hasher.add(MESHER_VERSION);
+  hasher.add(_registryFingerprint);
+  hasher.add(lightMap != nullptr);
+  hasher.add(&min, sizeof(min));
+  hasher.add(&max, sizeof(max));
+  // Faces are hidden by and lit from the cells next to them, so the cells one further out in every direction count too
+  for (int y = min.y - 1; y <= max.y; y++) {
+    for (int z = min.z - 1; z <= max.z; z++) {
+      for (int x = min.x - 1; x <= max.x; x++) {
+        glm::ivec3 position(x, y, z);
+        const Block* block = blocksMap.get(position);
+        uint64_t cell = block ? block->id() + 1 : 0;
+        if (lightMap) cell |= (uint64_t) lightMap->skyLight(position) << 32 | (uint64_t) lightMap->blockLight(position) << 40;
+        hasher.add(cell);
+      }
+    }
+  }
+  return hasher.hash();
+}
+
+const MeshCache::Entry* MeshCache::find(uint64_t key) {
+  static Metric& hits = Metrics::counter("mesh_cache.hits");
+  static Metric& misses = Metrics::counter("mesh_cache.misses");
+  auto it = _entries.find(key);
+  if (it == _entries.end()) {
+    misses.add();
+    return nullptr;
+  }
+  hits.add();
+  _used.push_back(key);
+  return &it->second;
+}
+
+void MeshCache::store(uint64_t key, const BlockVertex* vertices, size_t vertexCount, GLuint firstVertex,
+                      const GLuint* opaqueIndices, size_t opaqueCount, const GLuint* cutoutIndices, size_t cutoutCount) {
+  BuiltEntry& built = _built[key];
+  built.vertices.assign(vertices, vertices + vertexCount);
+  built.indices.resize(opaqueCount + cutoutCount);
+  for (size_t i = 0; i < opaqueCount; i++) {
+    built.indices[i] = opaqueIndices[i] - firstVertex;
+  }
+  for (size_t i = 0; i < cutoutCount; i++) {
+    built.indices[opaqueCount + i] = cutoutIndices[i] - firstVertex;
+  }
+  built.opaqueCount = opaqueCount;
+
+  _entries[key] = Entry{built.vertices.data(), vertexCount, built.indices.data(), opaqueCount, built.indices.data() + opaqueCount, cutoutCount};
+  _used.push_back(key);
+}
+
+void MeshCache::save() {
+  std::string temporaryFilename = _filename + ".tmp";
+  {
+    std::ofstream file(temporaryFilename, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+      std::string msg = strerror(errno);
+      throw MeshCacheException("Cannot open mesh cache " + temporaryFilename + " for writing: " + msg);
+    }
+    file.write(MAGIC, sizeof(MAGIC));
+    writeValue(file, VERSION);
+    writeValue(file, MESHER_VERSION);
+    for (uint64_t key : _used) {
+      const Entry& entry = _entries.at(key);
+      writeValue(file, key);
+      writeValue(file, (uint32_t) entry.vertexCount);
+      writeValue(file, (uint32_t) entry.opaqueCount);
+      writeValue(file, (uint32_t) entry.cutoutCount);
+      file.write(reinterpret_cast<const char*>(entry.vertices), entry.vertexCount * sizeof(BlockVertex));
+      file.write(reinterpret_cast<const char*>(entry.opaqueIndices), entry.opaqueCount * sizeof(GLuint));
+      file.write(reinterpret_cast<const char*>(entry.cutoutIndices), entry.cutoutCount * sizeof(GLuint));
+    }
+    if (!file.good()) {
+      throw MeshCacheException("Cannot write mesh cache " + temporaryFilename);
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::rename(temporaryFilename, _filename, error);
+  if (error) {
+    throw MeshCacheException("Cannot replace mesh cache " + _filename + ": " + error.message());
+  }
+}
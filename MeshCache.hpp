@@ -0,0 +1,82 @@
+#ifndef _MESH_CACHE_HPP_
+#define _MESH_CACHE_HPP_
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "ApplicationException.hpp"
+#include "BlocksMap.hpp"
+#include "LightMap.hpp"
+#include "BlocksMesh.hpp"
+
+// Finished section meshes of BlocksMesh kept in a file across runs, so that a world that did not change is not meshed again when it is loaded
+// A section is keyed by a hash of everything its mesh is made from: the blocks and light of the section and of the cells around it,
+// its position, the models of the block types and MESHER_VERSION
+// The file is mapped into memory, a hit is copied from the mapping into the mesh that goes to the GL buffers
+// Sections are stored in host byte order, the cache is only meant for the machine that wrote it
+class MeshCache {
+public:
+  // Bump when the mesher changes what it makes of the same blocks, so that the meshes of older builds are not used
+  static constexpr uint32_t MESHER_VERSION = 1;
+
+  // Vertices of a section, indices relative to its first vertex
+  struct Entry {
+    const BlockVertex* vertices;
+    size_t vertexCount;
+    const GLuint* opaqueIndices;
+    size_t opaqueCount;
+    const GLuint* cutoutIndices;
+    size_t cutoutCount;
+  };
+
+private:
+  struct BuiltEntry {
+    MeshVector<BlockVertex> vertices;
+    MeshVector<GLuint> indices; // opaque then cutout
+    size_t opaqueCount;
+  };
+
+  std::string _filename;
+  const uint8_t* _mapping = nullptr;
+  size_t _mappingSize = 0;
+  std::unordered_map<uint64_t, Entry> _entries; // into the file or _built
+  std::unordered_map<uint64_t, BuiltEntry> _built; // meshed by this run, nodes do not move so the entries can point into them
+  std::vector<uint64_t> _used; // keys of the last build, the ones save() writes
+
+  const BlockRegistry* _fingerprintedRegistry = nullptr;
+  uint64_t _registryFingerprint = 0;
+
+  void loadMapping();
+
+public:
+  // An unreadable or outdated file is an empty cache
+  MeshCache(const std::string& filename_);
+  ~MeshCache();
+
+  MeshCache(const MeshCache&) = delete;
+  MeshCache& operator=(const MeshCache&) = delete;
+
+  const std::string& filename() const { return _filename; }
+  size_t size() const { return _used.size(); }
+
+  // Called by a build before it looks up its sections, the entries that no section is found with in it are dropped
+  void beginBuild(const BlocksMap& blocksMap);
+  // Key of the section from min (inclusive) to max (exclusive), in world space
+  uint64_t sectionKey(const BlocksMap& blocksMap, const LightMap* lightMap, glm::ivec3 min, glm::ivec3 max) const;
+  // nullptr on a miss, the entry stays valid until the next build
+  const Entry* find(uint64_t key);
+  // Add the mesh of a section after a miss, indices are rebased from firstVertex
+  void store(uint64_t key, const BlockVertex* vertices, size_t vertexCount, GLuint firstVertex,
+             const GLuint* opaqueIndices, size_t opaqueCount, const GLuint* cutoutIndices, size_t cutoutCount);
+
+  // Write the sections of the last build to the file, replacing it
+  void save();
+};
+
+class MeshCacheException : public ApplicationException {
+  using ApplicationException::ApplicationException;
+};
+
+#endif
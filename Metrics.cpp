@@ -0,0 +1,129 @@
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "Metrics.hpp"
+
+namespace {
+
+struct Registry {
+  std::mutex mutex;
+  // Nodes of a map never move, so the metrics can be handed out by reference
+  std::map<std::string, Metric, std::less<>> counters;
+  std::map<std::string, Metric, std::less<>> gauges;
+};
+
+// Constructed on first use, hot paths may register their metrics from static initializers
+// Never destroyed, so that the memory freed by static destructors can still be accounted
+Registry& registry() {
+  static Registry& instance = *new Registry;
+  return instance;
+}
+
+Metric& lookUp(std::map<std::string, Metric, std::less<>>& metrics, const std::string& name) {
+  std::lock_guard lock(registry().mutex);
+  return metrics.try_emplace(name).first->second;
+}
+
+// Names are identifiers chosen in the code, they need no escaping
+void writeObject(std::ostream& out, const std::map<std::string, Metric, std::less<>>& metrics) {
+  out << "{";
+  bool first = true;
+  for (const auto& [name, metric] : metrics) {
+    if (!first) out << ",";
+    first = false;
+    out << "\"" << name << "\":" << metric.value();
+  }
+  out << "}";
+}
+
+const std::string UNIX_PREFIX = "unix:";
+
+}
+
+Metric& Metrics::counter(const std::string& name) {
+  return lookUp(registry().counters, name);
+}
+
+Metric& Metrics::gauge(const std::string& name) {
+  return lookUp(registry().gauges, name);
+}
+
+void Metrics::writeSnapshot(std::ostream& out) {
+  auto time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch());
+  std::lock_guard lock(registry().mutex);
+  out << "{\"time_ms\":" << time.count() << ",\"counters\":";
+  writeObject(out, registry().counters);
+  out << ",\"gauges\":";
+  writeObject(out, registry().gauges);
+  out << "}" << std::endl;
+}
+
+MetricsExporter::MetricsExporter(const std::string& destination, std::chrono::milliseconds interval) : _destination(destination), _interval(interval) {
+  if (_destination.compare(0, UNIX_PREFIX.size(), UNIX_PREFIX) == 0) {
+    if (_destination.size() - UNIX_PREFIX.size() >= sizeof(sockaddr_un::sun_path)) {
+      throw MetricsException("Socket path is too long: " + _destination);
+    }
+  } else {
+    // Fail early on a file that cannot be written, rather than silently on the exporting thread
+    std::ofstream file(_destination, std::ios::app);
+    if (!file) throw MetricsException("Cannot open " + _destination);
+  }
+  _thread = std::thread(&MetricsExporter::threadLoop, this);
+}
+
+MetricsExporter::~MetricsExporter() {
+  {
+    std::lock_guard lock(_mutex);
+    _stopping = true;
+  }
+  _stopRequested.notify_one();
+  _thread.join();
+  if (_socket >= 0) close(_socket);
+}
+
+void MetricsExporter::threadLoop() {
+  std::unique_lock lock(_mutex);
+  bool stopping = false;
+  while (!stopping) {
+    stopping = _stopRequested.wait_for(lock, _interval, [this] { return _stopping; });
+    lock.unlock();
+    std::ostringstream snapshot;
+    Metrics::writeSnapshot(snapshot);
+    exportSnapshot(snapshot.str());
+    lock.lock();
+  }
+}
+
+void MetricsExporter::exportSnapshot(const std::string& snapshot) {
+  if (_destination.compare(0, UNIX_PREFIX.size(), UNIX_PREFIX) != 0) {
+    std::ofstream file(_destination, std::ios::app);
+    file << snapshot;
+    return;
+  }
+
+  if (_socket < 0) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, _destination.c_str() + UNIX_PREFIX.size());
+    _socket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (_socket < 0) return;
+    if (connect(_socket, (sockaddr*) &address, sizeof(address)) < 0) {
+      close(_socket);
+      _socket = -1;
+      return;
+    }
+  }
+
+  // Never waits for a collector that is not reading, a snapshot that does not fit is dropped together with the connection
+  // Closing rather than leaving half a line, so that every line the collector gets is whole
+  ssize_t written = send(_socket, snapshot.data(), snapshot.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+  if (written != (ssize_t) snapshot.size()) {
+    close(_socket);
+    _socket = -1;
+  }
+}
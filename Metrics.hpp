@@ -0,0 +1,77 @@
+#ifndef _METRICS_HPP_
+#define _METRICS_HPP_
+#include <string>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <ostream>
+#include <cstdint>
+#include "ApplicationException.hpp"
+
+// A named value that any thread can update without locking, updates are relaxed so they cost about as much as a plain add
+class Metric {
+private:
+  std::atomic<int64_t> _value = 0;
+
+public:
+  // Returns the value after adding
+  int64_t add(int64_t n = 1) { return _value.fetch_add(n, std::memory_order_relaxed) + n; }
+  void set(int64_t value_) { _value.store(value_, std::memory_order_relaxed); }
+  // Set to value_ if it is larger, for high-water marks
+  void raise(int64_t value_) {
+    int64_t current = _value.load(std::memory_order_relaxed);
+    while (current < value_ && !_value.compare_exchange_weak(current, value_, std::memory_order_relaxed)) {}
+  }
+  int64_t value() const { return _value.load(std::memory_order_relaxed); }
+};
+
+// Process-wide registry of what the engine is doing, beyond the frame timings of Profiler
+// Counters only go up (bytes uploaded, entities ticked), the collector takes the rate from consecutive snapshots
+// Gauges hold a current amount (vertices in the mesh, texture cells in use)
+// Looking a metric up takes a lock, hot paths look it up once and keep the reference:
+//   static Metric& uploadedBytes = Metrics::counter("gl.buffer_bytes_uploaded");
+class Metrics {
+public:
+  // References stay valid for the lifetime of the process
+  static Metric& counter(const std::string& name);
+  static Metric& gauge(const std::string& name);
+
+  // One JSON object on one line, with the wall clock time in milliseconds and every metric by name
+  static void writeSnapshot(std::ostream& out);
+};
+
+// Writes a snapshot of Metrics every interval on a background thread
+// The destination is "unix:PATH" for a Unix domain stream socket that a collector listens on, or a file that snapshots are appended to
+// A socket that cannot be reached is retried on the next snapshot, so the collector can come and go
+class MetricsExporter {
+private:
+  std::string _destination;
+  std::chrono::milliseconds _interval;
+  int _socket = -1;
+
+  std::thread _thread;
+  std::mutex _mutex;
+  std::condition_variable _stopRequested;
+  bool _stopping = false;
+
+  void threadLoop();
+  void exportSnapshot(const std::string& snapshot);
+
+public:
+  static constexpr std::chrono::milliseconds DEFAULT_INTERVAL{1000};
+
+  MetricsExporter(const std::string& destination, std::chrono::milliseconds interval = DEFAULT_INTERVAL);
+  // Writes a last snapshot before returning
+  ~MetricsExporter();
+
+  MetricsExporter(const MetricsExporter&) = delete;
+  MetricsExporter& operator=(const MetricsExporter&) = delete;
+};
+
+class MetricsException : public ApplicationException {
+  using ApplicationException::ApplicationException;
+};
+
+#endif
@@ -0,0 +1,198 @@
+#include <algorithm>
+#include "ParticleSystem.hpp"
+#include "Metrics.hpp"
+
+namespace {
+
+const float BREAK_PARTICLE_SIZE = 0.15f;
+const float LEAF_PARTICLE_SIZE = 0.1f;
+const float LEAF_GRAVITY_SCALE = 0.02f; // falls at about 0.4 blocks per second against the drag
+const float AMBIENT_ATTEMPTS_PER_SECOND = 1000.f;
+const float GROUND_FRICTION = 8.f; // per second, of the horizontal velocity of particles lying on a block
+const float SHRINK_TIME = 0.25f; // particles shrink away over the end of their lifetime instead of popping out
+
+// SplitMix64, the particles only need to look random
+uint64_t nextRandom(uint64_t& state) {
+  uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+// Without branches and on restrict parameters like the entity update, so that the loops are vectorized
+void integrateVelocities(float deltaTime, size_t count,
+                         float* __restrict vx, float* __restrict vy, float* __restrict vz,
+                         const float* __restrict gravityScales, float* __restrict ages) {
+  float fall = ParticleSystem::GRAVITY * deltaTime;
+  float damping = 1.f / (1.f + ParticleSystem::DRAG * deltaTime);
+  for (size_t i = 0; i < count; i++) {
+    vx[i] *= damping;
+    vy[i] = (vy[i] - fall * gravityScales[i]) * damping;
+    vz[i] *= damping;
+    ages[i] += deltaTime;
+  }
+}
+
+void integratePositions(float deltaTime, size_t count,
+                        float* __restrict px, float* __restrict py, float* __restrict pz,
+                        const float* __restrict vx, const float* __restrict vy, const float* __restrict vz) {
+  for (size_t i = 0; i < count; i++) {
+    px[i] += vx[i] * deltaTime;
+    py[i] += vy[i] * deltaTime;
+    pz[i] += vz[i] * deltaTime;
+  }
+}
+
+}
+
+ParticleSystem::ParticleSystem(const BlockRegistry& registry_) : _registry(registry_) {
+  // The whole pool up front, so that emitting never allocates
+  _positions.reserve(MAX_PARTICLES);
+  _velocities.reserve(MAX_PARTICLES);
+  _ages.reserve(MAX_PARTICLES);
+  _lifetimes.reserve(MAX_PARTICLES);
+  _gravityScales.reserve(MAX_PARTICLES);
+  _sizes.reserve(MAX_PARTICLES);
+  _textures.reserve(MAX_PARTICLES);
+}
+
+float ParticleSystem::random(float min, float max) {
+  return min + (max - min) * (nextRandom(_randomState) >> 40) / (float) (1 << 24);
+}
+
+uint32_t ParticleSystem::randomTexture(uint16_t textureCell) {
+  uint64_t r = nextRandom(_randomState);
+  return textureCell | (r % TEXTURE_SUBCELLS) << 16 | (r / TEXTURE_SUBCELLS % TEXTURE_SUBCELLS) << 18;
+}
+
+bool ParticleSystem::emit(const glm::vec3& position, const glm::vec3& velocity, float lifetime, float gravityScale, float size, uint16_t textureCell) {
+  if (this->size() >= MAX_PARTICLES) return false;
+  _positions.push_back(position);
+  _velocities.push_back(velocity);
+  _ages.push_back(0.f);
+  _lifetimes.push_back(lifetime);
+  _gravityScales.push_back(gravityScale);
+  _sizes.push_back(size);
+  _textures.push_back(randomTexture(textureCell));
+  return true;
+}
+
+void ParticleSystem::emitBlockBreak(glm::ivec3 position, BlockId id) {
+  const BakedModel& model = _registry.model(id);
+  if (model.faceCount == 0) return;
+  uint16_t textureCell = _registry.bakedFaces()[model.firstFace].textureCell;
+
+  for (int z = 0; z < BREAK_PARTICLES_PER_SIDE; z++) {
+    for (int y = 0; y < BREAK_PARTICLES_PER_SIDE; y++) {
+      for (int x = 0; x < BREAK_PARTICLES_PER_SIDE; x++) {
+        // Outwards from the center of the block and a little upwards
+        glm::vec3 offset = (glm::vec3(x, y, z) + 0.5f) / (float) BREAK_PARTICLES_PER_SIDE - 0.5f;
+        glm::vec3 velocity = offset * random(2.f, 4.f) + glm::vec3(0.f, random(1.f, 3.f), 0.f);
+        if (!emit(glm::vec3(position) + offset, velocity, random(0.5f, 1.2f), 1.f, BREAK_PARTICLE_SIZE, textureCell)) return;
+      }
+    }
+  }
+}
+
+void ParticleSystem::emitAmbient(const BlocksMap& blocksMap, const glm::vec3& center, float radius, float deltaTime) {
+  // Rounded randomly, so that the rate is kept at any frame rate
+  size_t attempts = (size_t) (AMBIENT_ATTEMPTS_PER_SECOND * deltaTime + random(0.f, 1.f));
+  for (size_t i = 0; i < attempts; i++) {
+    glm::vec3 offset(random(-radius, radius), random(-radius, radius), random(-radius, radius));
+    glm::ivec3 position(glm::floor(center + offset + 0.5f));
+    const Block* block = blocksMap.get(position);
+    if (!block || !_registry.cutout(block->id()) || blocksMap.get(position - glm::ivec3(0, 1, 0))) continue;
+
+    const BakedModel& model = _registry.model(block->id());
+    if (model.faceCount == 0) continue;
+    glm::vec3 start = glm::vec3(position) + glm::vec3(random(-0.4f, 0.4f), -0.55f, random(-0.4f, 0.4f));
+    glm::vec3 velocity(random(-0.3f, 0.3f), 0.f, random(-0.3f, 0.3f));
+    if (!emit(start, velocity, random(3.f, 5.f), LEAF_GRAVITY_SCALE, LEAF_PARTICLE_SIZE, _registry.bakedFaces()[model.firstFace].textureCell)) return;
+  }
+}
+
+void ParticleSystem::update(float deltaTime, const BlocksMap* blocksMap) {
+  integrateVelocities(deltaTime, size(),
+                      _velocities.x.data(), _velocities.y.data(), _velocities.z.data(),
+                      _gravityScales.data(), _ages.data());
+  if (blocksMap) {
+    integrateWithCollisions(deltaTime, *blocksMap);
+  } else {
+    integratePositions(deltaTime, size(),
+                       _positions.x.data(), _positions.y.data(), _positions.z.data(),
+                       _velocities.x.data(), _velocities.y.data(), _velocities.z.data());
+  }
+  removeDead();
+
+  static Metric& liveParticles = Metrics::gauge("particles.live");
+  liveParticles.set(size());
+}
+
+void ParticleSystem::integrateWithCollisions(float deltaTime, const BlocksMap& blocksMap) {
+  float groundDamping = std::max(0.f, 1.f - GROUND_FRICTION * deltaTime);
+  for (size_t i = 0; i < size(); i++) {
+    glm::vec3 position = _positions.get(i);
+    glm::vec3 velocity = _velocities.get(i);
+    // Most moves stay within the block the particle is already in, which needs no test
+    glm::vec3 target = position + velocity * deltaTime;
+    if (glm::floor(target + 0.5f) == glm::floor(position + 0.5f)) {
+      _positions.set(i, target);
+      continue;
+    }
+    // One axis at a time, so that a particle hitting a wall or the ground keeps sliding along it
+    for (int axis = 0; axis < 3; axis++) {
+      glm::vec3 moved = position;
+      moved[axis] += velocity[axis] * deltaTime;
+      if (!blocksMap.solid(glm::ivec3(glm::floor(moved + 0.5f)))) {
+        position = moved;
+      } else {
+        velocity[axis] = 0.f;
+        if (axis == 1) {
+          velocity.x *= groundDamping;
+          velocity.z *= groundDamping;
+        }
+      }
+    }
+    _positions.set(i, position);
+    _velocities.set(i, velocity);
+  }
+}
+
+void ParticleSystem::removeDead() {
+  size_t count = size();
+  size_t alive = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (_ages[i] >= _lifetimes[i]) continue;
+    if (alive != i) {
+      _positions.set(alive, _positions.get(i));
+      _velocities.set(alive, _velocities.get(i));
+      _ages[alive] = _ages[i];
+      _lifetimes[alive] = _lifetimes[i];
+      _gravityScales[alive] = _gravityScales[i];
+      _sizes[alive] = _sizes[i];
+      _textures[alive] = _textures[i];
+    }
+    alive++;
+  }
+  _positions.resize(alive);
+  _velocities.resize(alive);
+  _ages.resize(alive);
+  _lifetimes.resize(alive);
+  _gravityScales.resize(alive);
+  _sizes.resize(alive);
+  _textures.resize(alive);
+}
+
+void ParticleSystem::fillInstances(std::vector<ParticleInstance>& out, const LightMap* lightMap) const {
+  out.resize(size());
+  for (size_t i = 0; i < size(); i++) {
+    glm::vec3 position = _positions.get(i);
+    unsigned light = LightMap::MAX_LIGHT;
+    if (lightMap) {
+      glm::ivec3 cell(glm::floor(position + 0.5f));
+      light = std::max(lightMap->skyLight(cell), lightMap->blockLight(cell));
+    }
+    float shrunkSize = _sizes[i] * std::min(1.f, (_lifetimes[i] - _ages[i]) / SHRINK_TIME);
+    out[i] = ParticleInstance{position.x, position.y, position.z, shrunkSize, _textures[i] | light << 20};
+  }
+}
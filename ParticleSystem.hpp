@@ -0,0 +1,71 @@
+#ifndef _PARTICLE_SYSTEM_HPP_
+#define _PARTICLE_SYSTEM_HPP_
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "EntityStore.hpp"
+#include "BlockRegistry.hpp"
+#include "BlocksMap.hpp"
+#include "LightMap.hpp"
+
+// Per-instance data of the particle draw, one textured quad facing the camera
+// texture packs the atlas cell (bits 0-15), the subcell of the cell shown (2 bits each for u and v) and the light level (bits 20-23)
+struct ParticleInstance {
+  float x, y, z;
+  float size;
+  uint32_t texture;
+};
+
+// Short-lived cosmetic particles, block break debris and leaves falling from trees
+// Unlike entities they have no handles, they are kept in fixed-capacity arrays of components and compacted as they die
+class ParticleSystem {
+public:
+  // Emitting beyond this many live particles drops the new ones, so that bursts cost a bounded amount per frame
+  static constexpr size_t MAX_PARTICLES = 1 << 16;
+  // Each particle shows a square of 1/TEXTURE_SUBCELLS of its texture cell's side, like a chip of the block
+  static constexpr unsigned TEXTURE_SUBCELLS = 4;
+  static constexpr int BREAK_PARTICLES_PER_SIDE = 4; // debris of a broken block, on a grid filling the block
+
+private:
+  const BlockRegistry& _registry;
+  Vec3Arrays _positions;
+  Vec3Arrays _velocities;
+  std::vector<float> _ages;
+  std::vector<float> _lifetimes;
+  std::vector<float> _gravityScales; // leaves drift down slower than debris falls
+  std::vector<float> _sizes;
+  std::vector<uint32_t> _textures; // cell and subcell, as in ParticleInstance without the light
+  uint64_t _randomState = 0x853c49e6748fea9bull;
+
+  float random(float min, float max);
+  uint32_t randomTexture(uint16_t textureCell);
+  void integrateWithCollisions(float deltaTime, const BlocksMap& blocksMap);
+  void removeDead();
+
+public:
+  static constexpr float GRAVITY = 20.f;
+  static constexpr float DRAG = 1.f; // fraction of the velocity lost per second, roughly
+
+  ParticleSystem(const BlockRegistry& registry_);
+
+  ParticleSystem(const ParticleSystem&) = delete;
+  ParticleSystem& operator=(const ParticleSystem&) = delete;
+
+  size_t size() const { return _ages.size(); }
+
+  // False if the system is full
+  bool emit(const glm::vec3& position, const glm::vec3& velocity, float lifetime, float gravityScale, float size, uint16_t textureCell);
+  // Chips of the block flying out of where it was, textured like its first face
+  void emitBlockBreak(glm::ivec3 position, BlockId id);
+  // Leaves dropping out from under the cutout blocks of the map, in a cube of radius around center, at a steady rate over deltaTime
+  void emitAmbient(const BlocksMap& blocksMap, const glm::vec3& center, float radius, float deltaTime);
+
+  // Apply gravity and drag, move the particles and remove the ones that have lived out their lifetime
+  // With a map, particles stop against its solid blocks instead of passing through them
+  void update(float deltaTime, const BlocksMap* blocksMap = nullptr);
+
+  // Resize out to the live particles and fill in what the draw needs, without a light map everything is in full sky light
+  void fillInstances(std::vector<ParticleInstance>& out, const LightMap* lightMap = nullptr) const;
+};
+
+#endif
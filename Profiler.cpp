@@ -0,0 +1,248 @@
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iomanip>
+#include "Profiler.hpp"
+
+namespace {
+
+double percentile(const std::vector<double>& sortedValues, double p) {
+  if (sortedValues.empty()) return 0.;
+  size_t index = std::min(sortedValues.size() - 1, (size_t) (p * (sortedValues.size() - 1) + 0.5));
+  return sortedValues[index];
+}
+
+void writeJsonString(std::ostream& out, const char* str) {
+  out << '"';
+  for (const char* c = str; *c; c++) {
+    if (*c == '"' || *c == '\\') out << '\\';
+    out << *c;
+  }
+  out << '"';
+}
+
+}
+
+Profiler::Profiler() : _finishedFrames(std::make_unique<SPSCRingBuffer<Frame, 64>>()) {
+  _epochNs = 0;
+  _epochNs = now();
+}
+
+uint64_t Profiler::now() const {
+  auto sinceEpoch = std::chrono::steady_clock::now().time_since_epoch();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(sinceEpoch).count() - _epochNs;
+}
+
+void Profiler::enableGpuTiming() {
+  if (_gpuTiming) return;
+  if (!GLEW_ARB_timer_query) return;
+
+  for (PendingFrame& pending : _pendingFrames) {
+    glGenQueries(pending.queries.size(), pending.queries.data());
+  }
+  _gpuTiming = true;
+}
+
+void Profiler::disableGpuTiming() {
+  if (!_gpuTiming) return;
+
+  // Frames still waiting for results are published without GPU times
+  while (_oldestPendingFrame < _frameIndex) {
+    publishResolvedFrames(true);
+  }
+  for (PendingFrame& pending : _pendingFrames) {
+    glDeleteQueries(pending.queries.size(), pending.queries.data());
+  }
+  _gpuTiming = false;
+}
+
+void Profiler::beginFrame() {
+  // Reusing the slot of a frame whose results are still not available, stop waiting for them
+  if (_frameIndex - _oldestPendingFrame >= GPU_LATENCY) {
+    publishResolvedFrames(true);
+  }
+
+  PendingFrame& pending = currentFrame();
+  pending.inUse = true;
+  pending.gpuZoneCount = 0;
+  pending.frame.index = _frameIndex;
+  pending.frame.startNs = now();
+  pending.frame.zoneCount = 0;
+  _inFrame = true;
+  _depth = 0;
+}
+
+void Profiler::endFrame() {
+  if (!_inFrame) return;
+
+  PendingFrame& pending = currentFrame();
+  pending.frame.cpuNs = now() - pending.frame.startNs;
+  _inFrame = false;
+  _frameIndex++;
+
+  publishResolvedFrames(false);
+}
+
+size_t Profiler::beginZone(const char* name, bool gpu) {
+  PendingFrame& pending = currentFrame();
+  if (!_inFrame || pending.frame.zoneCount == MAX_ZONES) return NO_ZONE;
+
+  size_t zoneIndex = pending.frame.zoneCount++;
+  Zone& zone = pending.frame.zones[zoneIndex];
+  zone.name = name;
+  zone.depth = _depth++;
+  zone.cpuNs = 0;
+  zone.gpuNs = -1;
+
+  if (gpu && _gpuTiming && _activeGpuZone == NO_ZONE && pending.gpuZoneCount < MAX_GPU_ZONES) {
+    glBeginQuery(GL_TIME_ELAPSED, pending.queries[pending.gpuZoneCount]);
+    pending.gpuZoneIndices[pending.gpuZoneCount++] = zoneIndex;
+    _activeGpuZone = zoneIndex;
+  }
+
+  // Taken last so that issuing the query is not counted towards the zone
+  zone.startNs = now();
+  return zoneIndex;
+}
+
+void Profiler::endZone(size_t zoneIndex) {
+  if (zoneIndex == NO_ZONE) return;
+
+  Zone& zone = currentFrame().frame.zones[zoneIndex];
+  zone.cpuNs = now() - zone.startNs;
+  _depth--;
+
+  if (zoneIndex == _activeGpuZone) {
+    glEndQuery(GL_TIME_ELAPSED);
+    _activeGpuZone = NO_ZONE;
+  }
+}
+
+void Profiler::publishResolvedFrames(bool forceOldest) {
+  // Frames are published in order, so stop at the first one whose GPU results are not available yet
+  while (_oldestPendingFrame < _frameIndex) {
+    PendingFrame& pending = _pendingFrames[_oldestPendingFrame % GPU_LATENCY];
+
+    if (pending.gpuZoneCount > 0) {
+      GLuint available = GL_FALSE;
+      glGetQueryObjectuiv(pending.queries[pending.gpuZoneCount - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+      if (!available && !forceOldest) break;
+
+      if (available) {
+        // Queries finish in order, so all of the previous ones are available too
+        for (size_t i = 0; i < pending.gpuZoneCount; i++) {
+          GLuint64 elapsed;
+          glGetQueryObjectui64v(pending.queries[i], GL_QUERY_RESULT, &elapsed);
+          pending.frame.zones[pending.gpuZoneIndices[i]].gpuNs = elapsed;
+        }
+      }
+    }
+    forceOldest = false;
+
+    if (!_finishedFrames->push(pending.frame)) {
+      _droppedFrames.fetch_add(1, std::memory_order_relaxed);
+    }
+    pending.inUse = false;
+    _oldestPendingFrame++;
+  }
+}
+
+void Profiler::collect() {
+  Frame frame;
+  while (_finishedFrames->pop(frame)) {
+    _history.push_back(frame);
+    if (_history.size() > HISTORY_SIZE) {
+      _history.pop_front();
+    }
+  }
+}
+
+void Profiler::printPercentiles(std::ostream& out) const {
+  std::vector<double> frameMs;
+  // Zones of the same name in a frame are summed up, names are indented by depth and kept in order of first appearance
+  struct ZoneTimes {
+    double cpuMs = 0.;
+    double gpuMs = 0.;
+    bool hasGpu = false;
+  };
+  std::vector<std::string> zoneNames;
+  std::map<std::string, std::vector<double>> zoneCpuMs;
+  std::map<std::string, std::vector<double>> zoneGpuMs;
+
+  for (const Frame& frame : _history) {
+    frameMs.push_back(frame.cpuNs / 1e6);
+
+    std::map<std::string, ZoneTimes> frameZones;
+    for (size_t i = 0; i < frame.zoneCount; i++) {
+      const Zone& zone = frame.zones[i];
+      std::string name = std::string(zone.depth * 2, ' ') + zone.name;
+      if (std::find(zoneNames.begin(), zoneNames.end(), name) == zoneNames.end()) {
+        zoneNames.push_back(name);
+      }
+      ZoneTimes& times = frameZones[name];
+      times.cpuMs += zone.cpuNs / 1e6;
+      if (zone.gpuNs >= 0) {
+        times.gpuMs += zone.gpuNs / 1e6;
+        times.hasGpu = true;
+      }
+    }
+    for (const auto& [name, times] : frameZones) {
+      zoneCpuMs[name].push_back(times.cpuMs);
+      if (times.hasGpu) zoneGpuMs[name].push_back(times.gpuMs);
+    }
+  }
+
+  auto printRow = [&out] (const std::string& label, std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    out << "  " << std::left << std::setw(32) << label << std::right << std::fixed << std::setprecision(3);
+    for (double p : {0.5, 0.9, 0.99}) {
+      out << std::setw(10) << percentile(values, p);
+    }
+    out << std::setw(10) << (values.empty() ? 0. : values.back()) << std::endl;
+  };
+
+  out << "Frame time percentiles over " << _history.size() << " frames (ms, " << droppedFrames() << " dropped):" << std::endl;
+  out << "  " << std::left << std::setw(32) << "" << std::right;
+  for (const char* heading : {"p50", "p90", "p99", "max"}) {
+    out << std::setw(10) << heading;
+  }
+  out << std::endl;
+
+  printRow("frame", frameMs);
+  for (const std::string& name : zoneNames) {
+    printRow(name, zoneCpuMs[name]);
+    if (zoneGpuMs.contains(name)) {
+      printRow(name + " [GPU]", zoneGpuMs[name]);
+    }
+  }
+}
+
+void Profiler::writeChromeTrace(std::ostream& out) const {
+  // CPU zones go on thread 1, GPU times on thread 2
+  // Timer queries do not tell when the GPU started the work, so GPU events are placed at the start of the CPU zone
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::endl;
+  out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}}," << std::endl;
+  out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+
+  out << std::fixed << std::setprecision(3);
+  auto writeEvent = [&out] (const char* name, int threadId, uint64_t startNs, uint64_t durationNs) {
+    out << "," << std::endl << "{\"name\":";
+    writeJsonString(out, name);
+    out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << threadId << ",\"ts\":" << startNs / 1e3 << ",\"dur\":" << durationNs / 1e3 << "}";
+  };
+
+  for (const Frame& frame : _history) {
+    writeEvent("frame", 1, frame.startNs, frame.cpuNs);
+    for (size_t i = 0; i < frame.zoneCount; i++) {
+      const Zone& zone = frame.zones[i];
+      writeEvent(zone.name, 1, zone.startNs, zone.cpuNs);
+      if (zone.gpuNs >= 0) {
+        writeEvent(zone.name, 2, zone.startNs, zone.gpuNs);
+      }
+    }
+  }
+
+  out << std::endl << "]}" << std::endl;
+}
@@ -0,0 +1,110 @@
+#ifndef _PROFILER_HPP_
+#define _PROFILER_HPP_
+#include <array>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <ostream>
+#include <cstdint>
+#include <GL/glew.h>
+#include "SPSCRingBuffer.hpp"
+
+// Records where the time of each frame goes, as nested CPU scopes, some of which are also timed on the GPU
+// Frames are produced on the render thread and handed to the consumer side (collect(), reports) through a lock-free buffer
+class Profiler {
+public:
+  static constexpr size_t MAX_ZONES = 32;
+  static constexpr size_t MAX_GPU_ZONES = 8;
+  static constexpr size_t GPU_LATENCY = 4; // frames to wait for timer query results before giving up on them
+  static constexpr size_t HISTORY_SIZE = 600;
+  static constexpr size_t NO_ZONE = SIZE_MAX; // returned by beginZone() when the zone is not recorded
+
+  struct Zone {
+    const char* name; // must be a string with static storage duration
+    uint32_t depth;
+    uint64_t startNs; // since the creation of the profiler
+    uint64_t cpuNs;
+    int64_t gpuNs; // -1 if not measured
+  };
+
+  struct Frame {
+    uint64_t index;
+    uint64_t startNs;
+    uint64_t cpuNs;
+    uint32_t zoneCount;
+    std::array<Zone, MAX_ZONES> zones;
+  };
+
+  // Times the enclosing block
+  class Scope {
+  private:
+    Profiler& _profiler;
+    size_t _zoneIndex;
+
+  public:
+    Scope(Profiler& profiler_, const char* name, bool gpu = false) : _profiler(profiler_), _zoneIndex(profiler_.beginZone(name, gpu)) {}
+    ~Scope() { _profiler.endZone(_zoneIndex); }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+  };
+
+private:
+  struct PendingFrame {
+    Frame frame;
+    bool inUse = false;
+    size_t gpuZoneCount = 0;
+    std::array<uint32_t, MAX_GPU_ZONES> gpuZoneIndices;
+    std::array<GLuint, MAX_GPU_ZONES> queries;
+  };
+
+  uint64_t _epochNs;
+  bool _gpuTiming = false;
+
+  // Producer side
+  uint64_t _frameIndex = 0;
+  bool _inFrame = false;
+  uint32_t _depth = 0;
+  size_t _activeGpuZone = NO_ZONE;
+  std::array<PendingFrame, GPU_LATENCY> _pendingFrames;
+  uint64_t _oldestPendingFrame = 0;
+  std::unique_ptr<SPSCRingBuffer<Frame, 64>> _finishedFrames;
+  std::atomic<size_t> _droppedFrames = 0;
+
+  // Consumer side
+  std::deque<Frame> _history;
+
+  uint64_t now() const;
+  PendingFrame& currentFrame() { return _pendingFrames[_frameIndex % GPU_LATENCY]; }
+  void publishResolvedFrames(bool forceOldest);
+
+public:
+  Profiler();
+
+  Profiler(const Profiler&) = delete;
+  Profiler& operator=(const Profiler&) = delete;
+
+  // Needs a current GL context supporting GL_ARB_timer_query, otherwise GPU zones are only timed on the CPU
+  void enableGpuTiming();
+  // Must be called before the GL context is destroyed
+  void disableGpuTiming();
+  bool gpuTiming() const { return _gpuTiming; }
+
+  void beginFrame();
+  void endFrame();
+  // GPU timer queries cannot nest, so a GPU zone inside another GPU zone is only timed on the CPU
+  size_t beginZone(const char* name, bool gpu = false);
+  void endZone(size_t zoneIndex);
+
+  // Move finished frames into the history, may be called from a different thread than the producer functions
+  void collect();
+  const std::deque<Frame>& history() const { return _history; }
+  size_t droppedFrames() const { return _droppedFrames.load(std::memory_order_relaxed); }
+
+  // Percentiles of frame time and of every zone over the history
+  void printPercentiles(std::ostream& out) const;
+  // Chrome trace event format, loadable in chrome://tracing or Perfetto
+  void writeChromeTrace(std::ostream& out) const;
+};
+
+#endif
@@ -0,0 +1,228 @@
+#include <cstring>
+#include "Protocol.hpp"
+
+namespace {
+
+class Writer {
+private:
+  std::vector<uint8_t> _bytes;
+
+public:
+  void u8(uint8_t value) { _bytes.push_back(value); }
+  void u16(uint16_t value) { u8(value); u8(value >> 8); }
+  void u32(uint32_t value) { u16(value); u16(value >> 16); }
+  void i32(int32_t value) { u32((uint32_t) value); }
+  void f32(float value) {
+    uint8_t bytes[sizeof(float)];
+    memcpy(bytes, &value, sizeof(float));
+    _bytes.insert(_bytes.end(), bytes, bytes + sizeof(float));
+  }
+  void ivec3(glm::ivec3 value) { i32(value.x); i32(value.y); i32(value.z); }
+  void vec3(glm::vec3 value) { f32(value.x); f32(value.y); f32(value.z); }
+  void string(const std::string& value) {
+    u16(value.size());
+    _bytes.insert(_bytes.end(), value.begin(), value.end());
+  }
+  void region(const BlocksRegion& value) { ivec3(value.min); ivec3(value.max); }
+
+  std::vector<uint8_t> bytes() { return std::move(_bytes); }
+};
+
+class Reader {
+private:
+  const std::vector<uint8_t>& _bytes;
+  size_t _offset = 0;
+
+  const uint8_t* take(size_t count) {
+    if (_bytes.size() - _offset < count) {
+      throw ProtocolException("Message is truncated");
+    }
+    const uint8_t* data = _bytes.data() + _offset;
+    _offset += count;
+    return data;
+  }
+
+public:
+  Reader(const std::vector<uint8_t>& bytes_) : _bytes(bytes_) {}
+
+  uint8_t u8() { return *take(1); }
+  uint16_t u16() { const uint8_t* b = take(2); return b[0] | b[1] << 8; }
+  uint32_t u32() { uint32_t low = u16(); return low | (uint32_t) u16() << 16; }
+  int32_t i32() { return (int32_t) u32(); }
+  float f32() {
+    float value;
+    memcpy(&value, take(sizeof(float)), sizeof(float));
+    return value;
+  }
+  glm::ivec3 ivec3() { int32_t x = i32(), y = i32(), z = i32(); return glm::ivec3(x, y, z); }
+  glm::vec3 vec3() { float x = f32(), y = f32(), z = f32(); return glm::vec3(x, y, z); }
+  std::string string() {
+    uint16_t size = u16();
+    const uint8_t* data = take(size);
+    return std::string(data, data + size);
+  }
+  BlocksRegion region() { glm::ivec3 min = ivec3(); return BlocksRegion{min, ivec3()}; }
+
+  void end() {
+    if (_offset != _bytes.size()) {
+      throw ProtocolException("Unexpected data at the end of a message");
+    }
+  }
+};
+
+// Sections are at most BlocksMesh::SECTION_SIZE^3 in practice, this only keeps a bad message from allocating without bound
+const size_t MAX_SECTION_CELLS = 1 << 20;
+
+}
+
+std::vector<uint8_t> encode(const WorldInfoMessage& message) {
+  Writer writer;
+  writer.ivec3(message.basePosition);
+  writer.ivec3(message.size);
+  writer.u16(message.blockTypes.size());
+  for (const std::string& blockType : message.blockTypes) {
+    writer.string(blockType);
+  }
+  return writer.bytes();
+}
+
+std::vector<uint8_t> encode(const SectionMessage& message) {
+  Writer writer;
+  writer.region(message.region);
+  // Runs of (length, cell)
+  for (size_t i = 0; i < message.cells.size();) {
+    size_t runEnd = i + 1;
+    while (runEnd < message.cells.size() && message.cells[runEnd] == message.cells[i] && runEnd - i < UINT16_MAX) runEnd++;
+    writer.u16(runEnd - i);
+    writer.u16(message.cells[i]);
+    i = runEnd;
+  }
+  return writer.bytes();
+}
+
+std::vector<uint8_t> encode(const SectionUnloadMessage& message) {
+  Writer writer;
+  writer.region(message.region);
+  return writer.bytes();
+}
+
+std::vector<uint8_t> encode(const BlockDeltasMessage& message) {
+  Writer writer;
+  writer.u32(message.deltas.size());
+  for (const BlockDelta& delta : message.deltas) {
+    writer.ivec3(delta.position);
+    writer.u16(delta.cell);
+  }
+  return writer.bytes();
+}
+
+std::vector<uint8_t> encode(const PlayerPositionMessage& message) {
+  Writer writer;
+  writer.vec3(message.position);
+  return writer.bytes();
+}
+
+std::vector<uint8_t> encode(const BreakBlockMessage& message) {
+  Writer writer;
+  writer.ivec3(message.position);
+  return writer.bytes();
+}
+
+void decode(const std::vector<uint8_t>& payload, WorldInfoMessage& message) {
+  Reader reader(payload);
+  message.basePosition = reader.ivec3();
+  message.size = reader.ivec3();
+  message.blockTypes.resize(reader.u16());
+  for (std::string& blockType : message.blockTypes) {
+    blockType = reader.string();
+  }
+  reader.end();
+}
+
+void decode(const std::vector<uint8_t>& payload, SectionMessage& message) {
+  Reader reader(payload);
+  message.region = reader.region();
+  size_t volume = message.region.volume();
+  if (volume > MAX_SECTION_CELLS) {
+    throw ProtocolException("Section is too large");
+  }
+  message.cells.clear();
+  while (message.cells.size() < volume) {
+    uint16_t length = reader.u16();
+    BlockCell cell = reader.u16();
+    if (length == 0 || message.cells.size() + length > volume) {
+      throw ProtocolException("Runs of a section do not add up to its size");
+    }
+    message.cells.insert(message.cells.end(), length, cell);
+  }
+  reader.end();
+}
+
+void decode(const std::vector<uint8_t>& payload, SectionUnloadMessage& message) {
+  Reader reader(payload);
+  message.region = reader.region();
+  reader.end();
+}
+
+void decode(const std::vector<uint8_t>& payload, BlockDeltasMessage& message) {
+  Reader reader(payload);
+  uint32_t count = reader.u32();
+  // Each delta takes 14 bytes, checked before allocating for them
+  if (count > payload.size() / 14) {
+    throw ProtocolException("Message is truncated");
+  }
+  message.deltas.resize(count);
+  for (BlockDelta& delta : message.deltas) {
+    delta.position = reader.ivec3();
+    delta.cell = reader.u16();
+  }
+  reader.end();
+}
+
+void decode(const std::vector<uint8_t>& payload, PlayerPositionMessage& message) {
+  Reader reader(payload);
+  message.position = reader.vec3();
+  reader.end();
+}
+
+void decode(const std::vector<uint8_t>& payload, BreakBlockMessage& message) {
+  Reader reader(payload);
+  message.position = reader.ivec3();
+  reader.end();
+}
+
+BlockCell blockCell(const std::optional<Block>& block) {
+  return block ? block->id() + 1 : 0;
+}
+
+SectionMessage sectionOfMap(const BlocksMap& blocksMap, const BlocksRegion& region) {
+  SectionMessage message;
+  message.region = blocksMap.clip(region);
+  message.cells.reserve(message.region.volume());
+  for (int y = message.region.min.y; y < message.region.max.y; y++) {
+    for (int z = message.region.min.z; z < message.region.max.z; z++) {
+      for (int x = message.region.min.x; x < message.region.max.x; x++) {
+        message.cells.push_back(blockCell(blocksMap[glm::ivec3(x, y, z)]));
+      }
+    }
+  }
+  return message;
+}
+
+BlocksRegion applySection(BlocksMap& blocksMap, const SectionMessage& message, const std::vector<std::optional<Block>>& blocksByCell) {
+  const BlocksRegion& region = message.region;
+  if (message.cells.size() != region.volume() || blocksMap.clip(region).volume() != region.volume()) {
+    throw ProtocolException("Section does not fit in the map");
+  }
+
+  // Build the section on its own and paste it, so that the map is updated a row at a time
+  BlocksMap section(blocksMap.registry(), region.min, region.max - region.min);
+  for (size_t i = 0; i < message.cells.size(); i++) {
+    BlockCell cell = message.cells[i];
+    if (cell >= blocksByCell.size()) {
+      throw ProtocolException("Unknown block type in a section");
+    }
+    if (cell != 0) section.set(section.calculatePosition(i), blocksByCell[cell]);
+  }
+  return blocksMap.paste(section, region.min);
+}
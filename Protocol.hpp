@@ -0,0 +1,90 @@
+#ifndef _PROTOCOL_HPP_
+#define _PROTOCOL_HPP_
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "ApplicationException.hpp"
+#include "BlocksMap.hpp"
+
+// Messages between mc-clone-server and the game
+// On the wire each one is framed by Connection as payload length (uint32), MessageType (uint8), payload
+// Integers are little endian, floats are stored in host byte order like in InputRecording
+enum class MessageType : uint8_t {
+  // Server to client
+  WORLD_INFO = 1,
+  SECTION,
+  SECTION_UNLOAD,
+  BLOCK_DELTAS,
+  // Client to server
+  PLAYER_POSITION,
+  BREAK_BLOCK,
+};
+
+// Blocks travel as cells: block ID + 1, or 0 for no block
+using BlockCell = uint16_t;
+
+// First message to a client, the map it should allocate and the block types the IDs in cells refer to
+struct WorldInfoMessage {
+  glm::ivec3 basePosition;
+  glm::ivec3 size;
+  std::vector<std::string> blockTypes; // in the order of the server's IDs
+};
+
+// All cells of a box of the map, x fastest then z then y like BlocksMap::storage
+// Run-length encoded on the wire, which shrinks the mostly uniform sections of a terrain to a few runs
+struct SectionMessage {
+  BlocksRegion region;
+  std::vector<BlockCell> cells;
+};
+
+// The client stops receiving changes to the box and should forget it
+struct SectionUnloadMessage {
+  BlocksRegion region;
+};
+
+struct BlockDelta {
+  glm::ivec3 position;
+  BlockCell cell;
+};
+
+// Changes to blocks in sections the client has, batched per server tick
+struct BlockDeltasMessage {
+  std::vector<BlockDelta> deltas;
+};
+
+struct PlayerPositionMessage {
+  glm::vec3 position;
+};
+
+struct BreakBlockMessage {
+  glm::ivec3 position;
+};
+
+std::vector<uint8_t> encode(const WorldInfoMessage& message);
+std::vector<uint8_t> encode(const SectionMessage& message);
+std::vector<uint8_t> encode(const SectionUnloadMessage& message);
+std::vector<uint8_t> encode(const BlockDeltasMessage& message);
+std::vector<uint8_t> encode(const PlayerPositionMessage& message);
+std::vector<uint8_t> encode(const BreakBlockMessage& message);
+
+// Throw ProtocolException for malformed payloads
+void decode(const std::vector<uint8_t>& payload, WorldInfoMessage& message);
+void decode(const std::vector<uint8_t>& payload, SectionMessage& message);
+void decode(const std::vector<uint8_t>& payload, SectionUnloadMessage& message);
+void decode(const std::vector<uint8_t>& payload, BlockDeltasMessage& message);
+void decode(const std::vector<uint8_t>& payload, PlayerPositionMessage& message);
+void decode(const std::vector<uint8_t>& payload, BreakBlockMessage& message);
+
+BlockCell blockCell(const std::optional<Block>& block);
+// Cells of the part of region inside the map
+SectionMessage sectionOfMap(const BlocksMap& blocksMap, const BlocksRegion& region);
+// Write the cells into the map, blocksByCell translates them to the client's block types
+// Returns the region that was written, as the bulk edits of BlocksMap do
+BlocksRegion applySection(BlocksMap& blocksMap, const SectionMessage& message, const std::vector<std::optional<Block>>& blocksByCell);
+
+class ProtocolException : public ApplicationException {
+  using ApplicationException::ApplicationException;
+};
+
+#endif
@@ -0,0 +1,152 @@
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include "Raycast.hpp"
+
+namespace {
+
+const float INFINITE_DISTANCE = std::numeric_limits<float>::infinity();
+// Below this number of rays per thread, splitting a batch is not worth it
+const size_t MIN_RAYS_PER_TASK = 256;
+// Blocks are centered on their positions, shifting the ray by this makes the cell of the block at c span [c, c + 1)
+const glm::vec3 CELL_OFFSET(0.5f);
+
+// Traversal state, the ray is at distance t in cell, the next cell boundary along each axis is at nextBoundary
+struct Traversal {
+  glm::vec3 origin;
+  glm::vec3 direction;
+  glm::ivec3 step;
+  glm::vec3 deltaDistance; // distance between cell boundaries along each axis
+
+  float t;
+  glm::ivec3 cell;
+  glm::vec3 nextBoundary;
+  glm::ivec3 normal;
+
+  // Start at distance t_, having crossed the boundary perpendicular to axis (or -1 at the origin)
+  // Along that axis the cell is known exactly, recomputing it from the position could land on the wrong side of the boundary
+  void enter(float t_, int axis, int boundary) {
+    t = t_;
+    glm::vec3 position = origin + direction * t;
+    normal = glm::ivec3(0);
+    for (int i = 0; i < 3; i++) {
+      cell[i] = (int) std::floor(position[i]);
+    }
+    if (axis >= 0) {
+      cell[axis] = step[axis] > 0 ? boundary : boundary - 1;
+      normal[axis] = -step[axis];
+    }
+    for (int i = 0; i < 3; i++) {
+      if (step[i] == 0) {
+        nextBoundary[i] = INFINITE_DISTANCE;
+      } else {
+        float boundaryPosition = (float) (step[i] > 0 ? cell[i] + 1 : cell[i]);
+        nextBoundary[i] = (boundaryPosition - origin[i]) / direction[i];
+      }
+    }
+  }
+};
+
+}
+
+std::optional<RaycastHit> raycast(const BlocksMap& blocksMap, const Ray& ray) {
+  float length = glm::length(ray.direction);
+  if (length == 0.f) return {};
+
+  Traversal traversal;
+  glm::vec3 origin = ray.origin + CELL_OFFSET;
+  traversal.origin = origin;
+  traversal.direction = ray.direction / length;
+  for (int i = 0; i < 3; i++) {
+    traversal.step[i] = (traversal.direction[i] > 0.f) - (traversal.direction[i] < 0.f);
+    traversal.deltaDistance[i] = traversal.step[i] ? std::abs(1.f / traversal.direction[i]) : INFINITE_DISTANCE;
+  }
+
+  // Clip the ray to the map, outside of it there are no blocks
+  glm::vec3 mapMin(blocksMap.basePosition);
+  glm::vec3 mapMax(blocksMap.basePosition + blocksMap.size);
+  float tEnter = 0.f;
+  float tExit = ray.maxDistance;
+  int enterAxis = -1;
+  int enterBoundary = 0;
+  for (int i = 0; i < 3; i++) {
+    if (traversal.step[i] == 0) {
+      if (origin[i] < mapMin[i] || origin[i] >= mapMax[i]) return {};
+      continue;
+    }
+    float near = ((traversal.step[i] > 0 ? mapMin[i] : mapMax[i]) - origin[i]) / traversal.direction[i];
+    float far = ((traversal.step[i] > 0 ? mapMax[i] : mapMin[i]) - origin[i]) / traversal.direction[i];
+    if (near > tEnter) {
+      tEnter = near;
+      enterAxis = i;
+      enterBoundary = (int) (traversal.step[i] > 0 ? mapMin[i] : mapMax[i]);
+    }
+    tExit = std::min(tExit, far);
+  }
+  if (tEnter > tExit) return {};
+
+  traversal.enter(tEnter, enterAxis, enterBoundary);
+  while (traversal.t <= tExit) {
+    const glm::ivec3& cell = traversal.cell;
+    // Rounding can put the last cell just outside of the map
+    if (!blocksMap.calculateStorageLocation(cell)) return {};
+
+    if (blocksMap.brickEmpty(cell)) {
+      // Jump to where the ray leaves the brick
+      glm::ivec3 brickMin = blocksMap.basePosition + (cell - blocksMap.basePosition) / BlocksMap::BRICK_SIZE * BlocksMap::BRICK_SIZE;
+      float tLeave = INFINITE_DISTANCE;
+      int leaveAxis = -1;
+      int leaveBoundary = 0;
+      for (int i = 0; i < 3; i++) {
+        if (traversal.step[i] == 0) continue;
+        int boundary = traversal.step[i] > 0 ? brickMin[i] + BlocksMap::BRICK_SIZE : brickMin[i];
+        float tBoundary = (boundary - origin[i]) / traversal.direction[i];
+        if (tBoundary < tLeave) {
+          tLeave = tBoundary;
+          leaveAxis = i;
+          leaveBoundary = boundary;
+        }
+      }
+      if (tLeave > tExit) return {};
+      // If rounding put the cell in a brick the ray is already leaving, take a normal step instead so that it keeps going forward
+      if (tLeave > traversal.t) {
+        traversal.enter(tLeave, leaveAxis, leaveBoundary);
+        continue;
+      }
+    } else if (const Block* block = blocksMap.get(cell)) {
+      // Not only solid blocks, non-solid ones can be broken too
+      return RaycastHit{block, cell, traversal.normal, traversal.t};
+    }
+
+    // Step into the neighbouring cell whose boundary is closest
+    int axis = 0;
+    if (traversal.nextBoundary[1] < traversal.nextBoundary[axis]) axis = 1;
+    if (traversal.nextBoundary[2] < traversal.nextBoundary[axis]) axis = 2;
+    traversal.t = traversal.nextBoundary[axis];
+    traversal.cell[axis] += traversal.step[axis];
+    traversal.nextBoundary[axis] += traversal.deltaDistance[axis];
+    traversal.normal = glm::ivec3(0);
+    traversal.normal[axis] = -traversal.step[axis];
+  }
+  return {};
+}
+
+void raycast(const BlocksMap& blocksMap, std::span<const Ray> rays, std::span<std::optional<RaycastHit>> hits, ThreadPool* threadPool) {
+  size_t count = std::min(rays.size(), hits.size());
+  size_t taskCount = threadPool ? std::min(threadPool->threadCount(), count / MIN_RAYS_PER_TASK) : 1;
+
+  auto castRange = [&] (size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      hits[i] = raycast(blocksMap, rays[i]);
+    }
+  };
+
+  if (taskCount <= 1) {
+    castRange(0, count);
+    return;
+  }
+
+  threadPool->run(taskCount, [&castRange, count, taskCount] (size_t task) {
+    castRange(count * task / taskCount, count * (task + 1) / taskCount);
+  });
+}
@@ -0,0 +1,30 @@
+#ifndef _RAYCAST_HPP_
+#define _RAYCAST_HPP_
+#include <optional>
+#include <span>
+#include <glm/glm.hpp>
+#include "BlocksMap.hpp"
+#include "ThreadPool.hpp"
+
+struct Ray {
+  glm::vec3 origin;
+  glm::vec3 direction; // does not need to be normalized
+  float maxDistance;
+};
+
+struct RaycastHit {
+  const Block* block;
+  glm::ivec3 position; // of the block
+  glm::ivec3 normal; // of the face the ray entered through, 0 if the ray starts inside the block
+  float distance; // from the origin to where the ray enters the block
+};
+
+// Find the first block along the ray, by walking through the cells it crosses (Amanatides & Woo)
+// Bricks without any block are crossed in one step, so rays through open air only touch a few cells
+std::optional<RaycastHit> raycast(const BlocksMap& blocksMap, const Ray& ray);
+
+// Cast many rays at once, hits[i] is the result of rays[i]
+// With a thread pool, large batches are split across threads
+void raycast(const BlocksMap& blocksMap, std::span<const Ray> rays, std::span<std::optional<RaycastHit>> hits, ThreadPool* threadPool = nullptr);
+
+#endif
@@ -0,0 +1,62 @@
+#include <algorithm>
+#include <numeric>
+#include <iomanip>
+#include <glm/ext/scalar_constants.hpp>
+#include "RenderBenchmark.hpp"
+
+RenderBenchmark::RenderBenchmark(size_t frameCount_, glm::vec3 center_, float radius_, float height_) {
+  _frameCount = frameCount_;
+  _center = center_;
+  _radius = radius_;
+  _height = height_;
+  _frameTimesMs.reserve(_frameCount);
+}
+
+void RenderBenchmark::beginFrame(Entity& camera) {
+  // One full orbit over the measured frames, bobbing up and down twice so that both the top and sides of the terrain are seen
+  float t = (float) _frameIndex / (WARMUP_FRAMES + _frameCount);
+  float angle = 2.f * glm::pi<float>() * t;
+  glm::vec3 offset(glm::cos(angle) * _radius, _height * (0.75f + 0.25f * glm::sin(2.f * angle)), glm::sin(angle) * _radius);
+
+  camera.position(_center + offset);
+  camera.direction(glm::normalize(-offset));
+
+  _countersAtFrameStart = GLState::counters();
+  _frameStart = std::chrono::steady_clock::now();
+}
+
+void RenderBenchmark::endFrame() {
+  auto frameEnd = std::chrono::steady_clock::now();
+
+  if (_frameIndex >= WARMUP_FRAMES) {
+    _frameTimesMs.push_back(std::chrono::duration<double, std::milli>(frameEnd - _frameStart).count());
+    _drawCalls += GLState::counters().drawCalls - _countersAtFrameStart.drawCalls;
+    _triangles += GLState::counters().triangles - _countersAtFrameStart.triangles;
+  }
+  _frameIndex++;
+}
+
+void RenderBenchmark::printReport(std::ostream& out) const {
+  if (_frameTimesMs.empty()) {
+    out << "Benchmark: no frames measured" << std::endl;
+    return;
+  }
+
+  std::vector<double> sorted = _frameTimesMs;
+  std::sort(sorted.begin(), sorted.end());
+  auto percentile = [&sorted] (double p) {
+    return sorted[std::min(sorted.size() - 1, (size_t) (p * (sorted.size() - 1) + 0.5))];
+  };
+  double mean = std::accumulate(sorted.begin(), sorted.end(), 0.) / sorted.size();
+
+  out << std::fixed << std::setprecision(3);
+  out << "Benchmark: " << sorted.size() << " frames" << std::endl;
+  out << "  frame time (ms): min " << sorted.front()
+    << ", mean " << mean
+    << ", p50 " << percentile(0.5)
+    << ", p99 " << percentile(0.99)
+    << ", max " << sorted.back() << std::endl;
+  out << "  draw calls: " << _drawCalls << " (" << (double) _drawCalls / sorted.size() << " per frame)" << std::endl;
+  out << "  triangles: " << _triangles << " (" << (double) _triangles / sorted.size() << " per frame)" << std::endl;
+  out << "  GL binding calls: " << GLState::counters().issued << " issued, " << GLState::counters().elided << " elided" << std::endl;
+}
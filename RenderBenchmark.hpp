@@ -0,0 +1,41 @@
+#ifndef _RENDER_BENCHMARK_HPP_
+#define _RENDER_BENCHMARK_HPP_
+#include <vector>
+#include <ostream>
+#include <chrono>
+#include <glm/glm.hpp>
+#include "Entity.hpp"
+#include "GLState.hpp"
+
+// Drives the camera along a fixed path for a fixed number of frames and collects frame statistics, so that rendering performance can be compared between builds
+class RenderBenchmark {
+private:
+  size_t _frameCount;
+  glm::vec3 _center; // the camera orbits around and looks at this point
+  float _radius;
+  float _height;
+
+  size_t _frameIndex = 0;
+  std::chrono::steady_clock::time_point _frameStart;
+  GLState::Counters _countersAtFrameStart;
+
+  std::vector<double> _frameTimesMs;
+  size_t _drawCalls = 0;
+  size_t _triangles = 0;
+
+public:
+  static constexpr size_t WARMUP_FRAMES = 10; // not included in the statistics
+
+  RenderBenchmark(size_t frameCount_, glm::vec3 center_, float radius_, float height_);
+
+  bool finished() const { return _frameIndex >= WARMUP_FRAMES + _frameCount; }
+
+  // Place the camera for the current frame on the path
+  void beginFrame(Entity& camera);
+  // Must be called after the frame is finished on the GPU
+  void endFrame();
+
+  void printReport(std::ostream& out) const;
+};
+
+#endif
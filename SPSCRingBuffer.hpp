@@ -0,0 +1,37 @@
+#ifndef _SPSC_RING_BUFFER_HPP_
+#define _SPSC_RING_BUFFER_HPP_
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Fixed-capacity lock-free queue for exactly one producer thread and one consumer thread
+template <typename T, size_t N>
+class SPSCRingBuffer {
+private:
+  std::array<T, N> _items;
+  alignas(64) std::atomic<size_t> _writeIndex = 0;
+  alignas(64) std::atomic<size_t> _readIndex = 0;
+
+public:
+  // Returns false if the buffer is full, the item is not added in this case
+  bool push(const T& item) {
+    size_t writeIndex = _writeIndex.load(std::memory_order_relaxed);
+    if (writeIndex - _readIndex.load(std::memory_order_acquire) == N) return false;
+    _items[writeIndex % N] = item;
+    _writeIndex.store(writeIndex + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Returns false if the buffer is empty
+  bool pop(T& item) {
+    size_t readIndex = _readIndex.load(std::memory_order_relaxed);
+    if (readIndex == _writeIndex.load(std::memory_order_acquire)) return false;
+    item = _items[readIndex % N];
+    _readIndex.store(readIndex + 1, std::memory_order_release);
+    return true;
+  }
+
+  static constexpr size_t capacity() { return N; }
+};
+
+#endif
@@ -4,6 +4,13 @@
 #include <cstring>
 #include "Shader.hpp"
 #include "build_config.h"
+#include "MemoryTracking.hpp"
+
+namespace {
+
+using SourceString = TaggedString<MemoryTag::SHADER_SOURCES>;
+
+}
 
 void Shader::loadFromString(const char* source) {
   glShaderSource(_id, 1, &source, NULL);
@@ -31,7 +38,7 @@ void Shader::loadFromString(const std::string& source) {
   loadFromString(source.c_str());
 }
 
-void Shader::loadFromFile(const std::string& filename) {
+void Shader::loadFromFile(const std::string& filename, const std::vector<std::string>& defines) {
   std::filesystem::path path(APP_RESOURCE_PATH);
   path.append(filename);
 
@@ -40,13 +47,24 @@ void Shader::loadFromFile(const std::string& filename) {
     std::string msg = strerror(errno);
     throw ShaderException("Cannot open shader source file " + path.string() + ": " + msg);
   }
-  std::ostringstream text;
+  std::basic_ostringstream<char, std::char_traits<char>, SourceString::allocator_type> text;
   text << file.rdbuf();
   if (!file.good() && !file.eof()) {
     throw ShaderException("Cannot read shader source file " + path.string());
   }
 
-  loadFromString(text.str());
+  SourceString source = text.str();
+  if (!defines.empty()) {
+    // #version has to stay the first line
+    size_t versionLineEnd = source.starts_with("#version") ? source.find('\n') + 1 : 0;
+    std::string defineLines;
+    for (const std::string& define : defines) {
+      defineLines += "#define " + define + "\n";
+    }
+    source.insert(versionLineEnd, defineLines);
+  }
+
+  loadFromString(source.c_str());
 }
 
 const char* Shader::getShaderTypeStr(GLenum shaderType) {
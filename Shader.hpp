@@ -8,6 +8,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include "ApplicationException.hpp"
+#include "GLState.hpp"
 
 class Shader {
 private:
@@ -30,7 +31,8 @@ public:
 
   void loadFromString(const char* source);
   void loadFromString(const std::string& source);
-  void loadFromFile(const std::string& filename);
+  // Each of defines is added as "#define <define>" right after the #version line, for compiling variants of one source
+  void loadFromFile(const std::string& filename, const std::vector<std::string>& defines = {});
 
   static const char* getShaderTypeStr(GLenum shaderType);
 };
@@ -49,6 +51,7 @@ public:
   }
   ~ShaderProgram() {
     glDeleteProgram(_id);
+    GLState::programDeleted(_id);
   }
 
   ShaderProgram(const ShaderProgram&) = delete;
@@ -61,16 +64,21 @@ public:
     glAttachShader(_id, shader->id());
   }
 
-  void loadAndAttachShader(GLenum shaderType, const std::string& filename) {
+  void loadAndAttachShader(GLenum shaderType, const std::string& filename, const std::vector<std::string>& defines = {}) {
     auto shader = std::make_shared<Shader>(shaderType);
-    shader->loadFromFile(filename);
+    shader->loadFromFile(filename, defines);
     attachShader(shader);
   }
 
+  // Must be called before link(), so that variants of a program can share a VAO
+  void bindAttribLocation(GLuint index, const std::string& name) {
+    glBindAttribLocation(_id, index, name.c_str());
+  }
+
   void link();
 
   void use() {
-    glUseProgram(_id);
+    GLState::useProgram(_id);
   }
 
   GLint getUniformLocation(const std::string& name) {
@@ -0,0 +1,125 @@
+#include <algorithm>
+#include "Simulation.hpp"
+
+Simulation::Simulation(EntityStore& entities_, const BlocksMap& blocksMap_, float tickLength_, ThreadPool* threadPool_) :
+  _entities(entities_), _blocksMap(blocksMap_), _threadPool(threadPool_), _tickLength(tickLength_) {
+  // Both published ticks start as the initial state, so that there is something to interpolate from
+  publish();
+  publish();
+}
+
+Simulation::~Simulation() {
+  stop();
+}
+
+uint64_t Simulation::tickCount() const {
+  std::lock_guard lock(_snapshotsMutex);
+  return _currentSnapshot.tick;
+}
+
+void Simulation::start() {
+  if (_running) return;
+  _stopping = false;
+  _running = true;
+  _thread = std::thread(&Simulation::threadLoop, this);
+}
+
+void Simulation::stop() {
+  if (!_running) return;
+  {
+    std::lock_guard lock(_threadMutex);
+    _stopping = true;
+  }
+  _stopRequested.notify_all();
+  _thread.join();
+  _running = false;
+}
+
+void Simulation::advance(float deltaTime) {
+  _accumulatedTime += deltaTime;
+  int ticks = 0;
+  while (_accumulatedTime >= _tickLength) {
+    _accumulatedTime -= _tickLength;
+    if (ticks++ < MAX_CATCH_UP_TICKS) {
+      tick();
+      publish();
+    }
+  }
+}
+
+void Simulation::desiredVelocity(EntityHandle handle, const glm::vec3& velocity) {
+  std::lock_guard lock(_controlsMutex);
+  auto it = std::find_if(_desiredVelocities.begin(), _desiredVelocities.end(), [handle] (const auto& control) { return control.first == handle; });
+  if (it != _desiredVelocities.end()) {
+    it->second = velocity;
+  } else {
+    _desiredVelocities.emplace_back(handle, velocity);
+  }
+}
+
+glm::vec3 Simulation::interpolatedPosition(EntityHandle handle) const {
+  std::lock_guard lock(_snapshotsMutex);
+  if (handle.slot >= _currentSnapshot.positions.size() || handle.slot >= _previousSnapshot.positions.size()) {
+    return glm::vec3(0.f);
+  }
+
+  float alpha;
+  if (_running) {
+    std::chrono::duration<float> sincePublish = std::chrono::steady_clock::now() - _currentSnapshot.publishTime;
+    alpha = sincePublish.count() / _tickLength;
+  } else {
+    alpha = _accumulatedTime / _tickLength;
+  }
+  alpha = glm::clamp(alpha, 0.f, 1.f);
+  return glm::mix(_previousSnapshot.positions[handle.slot], _currentSnapshot.positions[handle.slot], alpha);
+}
+
+void Simulation::tick() {
+  {
+    std::lock_guard lock(_controlsMutex);
+    for (const auto& [handle, velocity] : _desiredVelocities) {
+      if (_entities.valid(handle)) _entities.desiredVelocity(handle, velocity);
+    }
+  }
+
+  {
+    std::shared_lock lock(_worldMutex);
+    _entities.update(_tickLength, &_blocksMap, _threadPool);
+  }
+  _nearbyEntities.rebuild(_entities);
+  if (_blockTicks) {
+    std::unique_lock lock(_worldMutex);
+    _blockTicks->tick(_threadPool);
+  }
+  _tickCount++;
+}
+
+void Simulation::publish() {
+  _nextSnapshot.tick = _tickCount;
+  _entities.positionsBySlot(_nextSnapshot.positions);
+  _nextSnapshot.publishTime = std::chrono::steady_clock::now();
+
+  // Rotate the buffers, the previous snapshot's memory is reused for the next tick
+  std::lock_guard lock(_snapshotsMutex);
+  std::swap(_previousSnapshot, _currentSnapshot);
+  std::swap(_currentSnapshot, _nextSnapshot);
+}
+
+void Simulation::threadLoop() {
+  auto tickDuration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(_tickLength));
+  auto nextTickTime = std::chrono::steady_clock::now() + tickDuration;
+
+  std::unique_lock lock(_threadMutex);
+  while (!_stopRequested.wait_until(lock, nextTickTime, [this] { return _stopping; })) {
+    lock.unlock();
+    tick();
+    publish();
+    lock.lock();
+
+    nextTickTime += tickDuration;
+    auto now = std::chrono::steady_clock::now();
+    if (now - nextTickTime > tickDuration * MAX_CATCH_UP_TICKS) {
+      nextTickTime = now;
+    }
+  }
+}
@@ -0,0 +1,103 @@
+#ifndef _SIMULATION_HPP_
+#define _SIMULATION_HPP_
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "EntityStore.hpp"
+#include "EntitySpatialHash.hpp"
+#include "BlocksMap.hpp"
+#include "ThreadPool.hpp"
+#include "BlockTickScheduler.hpp"
+
+// Runs the game logic in ticks of a fixed length, independent of the frame rate
+// Either on its own thread in real time (start()), or driven by the caller (advance()) for replays and benchmarks
+// The renderer does not touch the EntityStore while running, it reads positions interpolated between the last two published ticks
+class Simulation {
+public:
+  // State of the entities after a tick, as seen by the renderer
+  struct Snapshot {
+    uint64_t tick;
+    std::vector<glm::vec3> positions; // indexed by entity slot
+    std::chrono::steady_clock::time_point publishTime;
+  };
+
+  static constexpr float DEFAULT_TICK_LENGTH = 1.f / 60.f;
+  // When the simulation falls behind by more than this many ticks, it skips ahead instead of trying to catch up
+  static constexpr int MAX_CATCH_UP_TICKS = 10;
+
+private:
+  EntityStore& _entities;
+  const BlocksMap& _blocksMap;
+  ThreadPool* _threadPool;
+  BlockTickScheduler* _blockTicks = nullptr;
+  EntitySpatialHash _nearbyEntities;
+  float _tickLength;
+  uint64_t _tickCount = 0;
+  float _accumulatedTime = 0.f; // not yet simulated, when driven by advance()
+
+  // Desired velocities set by the caller, reapplied on every tick
+  std::mutex _controlsMutex;
+  std::vector<std::pair<EntityHandle, glm::vec3>> _desiredVelocities;
+
+  // Previous and current tick, swapped in when a tick is published
+  mutable std::mutex _snapshotsMutex;
+  Snapshot _previousSnapshot;
+  Snapshot _currentSnapshot;
+  Snapshot _nextSnapshot; // only touched by the simulating thread
+
+  std::shared_mutex _worldMutex;
+
+  std::thread _thread;
+  std::mutex _threadMutex;
+  std::condition_variable _stopRequested;
+  bool _stopping = false;
+  std::atomic<bool> _running = false;
+
+  void tick();
+  void publish();
+  void threadLoop();
+
+public:
+  Simulation(EntityStore& entities_, const BlocksMap& blocksMap_, float tickLength_ = DEFAULT_TICK_LENGTH, ThreadPool* threadPool_ = nullptr);
+  ~Simulation();
+
+  Simulation(const Simulation&) = delete;
+  Simulation& operator=(const Simulation&) = delete;
+
+  float tickLength() const { return _tickLength; }
+  uint64_t tickCount() const;
+
+  // Start or stop ticking in real time on a separate thread
+  // Entities must not be created or destroyed while it is running
+  void start();
+  void stop();
+  bool running() const { return _running; }
+
+  // Without the thread, run as many ticks as fit in deltaTime, carrying the remainder over to the next call
+  void advance(float deltaTime);
+
+  // The entity keeps trying to reach this velocity until it is changed
+  void desiredVelocity(EntityHandle handle, const glm::vec3& velocity);
+
+  // Also run the block updates on every tick, after the entities, with the world mutex held exclusively
+  // Must not be changed while running
+  void blockTicks(BlockTickScheduler* blockTicks_) { _blockTicks = blockTicks_; }
+
+  // Positions of the entities after the entity update of the current tick, for the logic that runs after it
+  // Only to be used from the simulating thread, or while not running
+  const EntitySpatialHash& nearbyEntities() const { return _nearbyEntities; }
+
+  // Held shared by the entity update of every tick, lock it exclusively to modify the blocks map
+  std::shared_mutex& worldMutex() { return _worldMutex; }
+
+  // Position of the entity between the last two ticks, according to how much time has passed since the last one
+  glm::vec3 interpolatedPosition(EntityHandle handle) const;
+};
+
+#endif
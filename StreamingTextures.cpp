@@ -1,7 +1,9 @@
 #include <optional>
 #include <GL/glew.h>
 #include "load_png.hpp"
+#include "GLState.hpp"
 #include "StreamingTextures.hpp"
+#include "Metrics.hpp"
 
 StreamingTextures::StreamingTextures(size_t cellSideLength_, size_t cellCountPerSide_, std::vector<GLenum>&& textureFormats_, std::function<void(size_t, GLuint)> configFunc) {
   _cellSideLength = cellSideLength_;
@@ -19,24 +21,26 @@ StreamingTextures::StreamingTextures(size_t cellSideLength_, size_t cellCountPer
   glGenTextures(_textureIds.size(), _textureIds.data());
 
   for (size_t i = 0; i < _textureIds.size(); i++) {
-    glBindTexture(GL_TEXTURE_2D, _textureIds[i]);
+    GLState::bindTexture(0, GL_TEXTURE_2D, _textureIds[i]);
     glTexStorage2D(GL_TEXTURE_2D, 1, _textureFormats[i], _cellSideLength * _cellCountPerSide, _cellSideLength * _cellCountPerSide);
     configFunc(i, _textureIds[i]);
   }
+  MemoryTracking::allocated(MemoryTag::VRAM_TEXTURES, textureBytes());
 }
 
 StreamingTextures::~StreamingTextures() {
+  MemoryTracking::freed(MemoryTag::VRAM_TEXTURES, textureBytes());
   glDeleteTextures(_textureIds.size(), _textureIds.data());
+  GLState::texturesDeleted(_textureIds.size(), _textureIds.data());
 }
 
 void StreamingTextures::bind() {
   for (size_t i = 0; i < _textureIds.size(); i++) {
-    glActiveTexture(GL_TEXTURE0 + i);
-    glBindTexture(GL_TEXTURE_2D, _textureIds[i]);
+    GLState::bindTexture(i, GL_TEXTURE_2D, _textureIds[i]);
   }
 }
 
-std::shared_ptr<StreamingTexturesPart> StreamingTextures::allocate(const std::vector<std::vector<uint8_t>>& data) {
+std::shared_ptr<StreamingTexturesPart> StreamingTextures::allocate(const std::vector<CellData>& data) {
   if (data.size() != _textureIds.size()) {
     throw std::invalid_argument("number of data is inconsistent with number of textures");
   }
@@ -59,8 +63,10 @@ std::shared_ptr<StreamingTexturesPart> StreamingTextures::allocate(const std::ve
   size_t yOffset = yLocation * _cellSideLength;
 
   // Store texture data into the designated area
+  static Metric& uploadedBytes = Metrics::counter("gl.texture_bytes_uploaded");
   for(size_t i = 0; i < _textureIds.size(); i++) {
-    glBindTexture(GL_TEXTURE_2D, _textureIds[i]);
+    uploadedBytes.add(_cellSideLength * _cellSideLength * sizedInternalFormatToPixelSize(_textureFormats[i]));
+    GLState::bindTexture(0, GL_TEXTURE_2D, _textureIds[i]);
     glTexSubImage2D(GL_TEXTURE_2D, 0, xOffset, yOffset, _cellSideLength, _cellSideLength, sizedInternalFormatToBaseInternalFormat(_textureFormats[i]), GL_UNSIGNED_BYTE, data[i].data());
   }
 
@@ -72,7 +78,7 @@ std::shared_ptr<StreamingTexturesPart> StreamingTextures::allocateFromFiles(cons
     throw std::invalid_argument("number of data is inconsistent with number of textures");
   }
 
-  std::vector<std::vector<uint8_t>> data(_textureIds.size());
+  std::vector<CellData> data(_textureIds.size());
 
   for (size_t i = 0; i < _textureIds.size(); i++) {
     data[i].resize(_cellSideLength * _cellSideLength * sizedInternalFormatToPixelSize(_textureFormats[i]));
@@ -83,6 +89,15 @@ std::shared_ptr<StreamingTexturesPart> StreamingTextures::allocateFromFiles(cons
   return allocate(data);
 }
 
+size_t StreamingTextures::textureBytes() const {
+  size_t pixelCount = _cellSideLength * _cellCountPerSide * _cellSideLength * _cellCountPerSide;
+  size_t bytes = 0;
+  for (GLenum format : _textureFormats) {
+    bytes += pixelCount * sizedInternalFormatToPixelSize(format);
+  }
+  return bytes;
+}
+
 GLenum StreamingTextures::sizedInternalFormatToBaseInternalFormat(GLenum sizedInternalFormat) {
   switch (sizedInternalFormat) {
     case GL_R8:
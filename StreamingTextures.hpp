@@ -6,6 +6,8 @@
 #include <functional>
 #include <stdexcept>
 #include <GL/glew.h>
+#include "Metrics.hpp"
+#include "MemoryTracking.hpp"
 
 class StreamingTexturesPart;
 
@@ -32,15 +34,24 @@ public:
   const std::vector<GLuint>& textureIds() const { return _textureIds; }
   const std::vector<GLenum>& textureFormats() const { return _textureFormats; }
 
+  // Pixels of one cell of one texture
+  using CellData = TaggedVector<uint8_t, MemoryTag::TEXTURE_STAGING>;
+
   // Bind the textures to texture image units 0, 1, 2 ...
   void bind();
   // Allocate a new cell in the grid to store new data
-  std::shared_ptr<StreamingTexturesPart> allocate(const std::vector<std::vector<uint8_t>>& data);
+  std::shared_ptr<StreamingTexturesPart> allocate(const std::vector<CellData>& data);
   std::shared_ptr<StreamingTexturesPart> allocateFromFiles(const std::vector<std::string>& filenames);
 
   static GLenum sizedInternalFormatToBaseInternalFormat(GLenum sizedInternalFormat);
   static size_t sizedInternalFormatToPixelSize(GLenum sizedInternalFormat);
 
+private:
+  // Size of the storage of all the textures, as an estimate of the VRAM they take
+  size_t textureBytes() const;
+
+public:
+
   friend class StreamingTexturesPart;
 
   class AllocationError : public std::runtime_error {
@@ -56,7 +67,14 @@ private:
   size_t _yLocation;
 
   // Do not allow an instance to be created freely
-  StreamingTexturesPart(StreamingTextures& manager_, size_t xLocation_, size_t yLocation_) : _manager(manager_), _xLocation(xLocation_), _yLocation(yLocation_) {}
+  StreamingTexturesPart(StreamingTextures& manager_, size_t xLocation_, size_t yLocation_) : _manager(manager_), _xLocation(xLocation_), _yLocation(yLocation_) {
+    cellsInUse().add(1);
+  }
+
+  static Metric& cellsInUse() {
+    static Metric& metric = Metrics::gauge("textures.cells_in_use");
+    return metric;
+  }
 
 public:
   StreamingTexturesPart(const StreamingTexturesPart&) = delete;
@@ -65,6 +83,7 @@ public:
   ~StreamingTexturesPart() {
     // Remove itself from the manager
     _manager._registry[_yLocation * _manager._cellCountPerSide + _xLocation] = false;
+    cellsInUse().add(-1);
   }
 
   StreamingTextures& manager() const { return _manager; }
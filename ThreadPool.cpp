@@ -0,0 +1,83 @@
+#include <algorithm>
+#include "ThreadPool.hpp"
+
+ThreadPool::ThreadPool(size_t threadCount) {
+  size_t workerCount = std::max<size_t>(threadCount, 1) - 1;
+  _workers.reserve(workerCount);
+  for (size_t i = 0; i < workerCount; i++) {
+    _workers.emplace_back(&ThreadPool::workerLoop, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard lock(_mutex);
+    _stopping = true;
+  }
+  _workAvailable.notify_all();
+  for (std::thread& worker : _workers) {
+    worker.join();
+  }
+}
+
+void ThreadPool::run(size_t taskCount, const std::function<void(size_t)>& task) {
+  if (taskCount == 0) return;
+  if (_workers.empty() || taskCount == 1) {
+    for (size_t i = 0; i < taskCount; i++) task(i);
+    return;
+  }
+
+  {
+    std::lock_guard lock(_mutex);
+    _task = &task;
+    _taskCount = taskCount;
+    _nextTask.store(0, std::memory_order_relaxed);
+    _remainingTasks.store(taskCount, std::memory_order_relaxed);
+    _generation++;
+  }
+  _workAvailable.notify_all();
+
+  executeTasks(task, taskCount);
+
+  // Also wait for the workers to leave the loop, so that the next run() can safely replace the task
+  std::unique_lock lock(_mutex);
+  _workDone.wait(lock, [this] { return _remainingTasks.load(std::memory_order_acquire) == 0 && _activeWorkers == 0; });
+  _task = nullptr;
+}
+
+void ThreadPool::executeTasks(const std::function<void(size_t)>& task, size_t taskCount) {
+  while (true) {
+    size_t taskIndex = _nextTask.fetch_add(1, std::memory_order_relaxed);
+    if (taskIndex >= taskCount) break;
+    task(taskIndex);
+    if (_remainingTasks.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      std::lock_guard lock(_mutex);
+      _workDone.notify_all();
+    }
+  }
+}
+
+void ThreadPool::workerLoop() {
+  uint64_t seenGeneration = 0;
+  while (true) {
+    const std::function<void(size_t)>* task;
+    size_t taskCount;
+    {
+      std::unique_lock lock(_mutex);
+      _workAvailable.wait(lock, [this, seenGeneration] { return _stopping || (_generation != seenGeneration && _task); });
+      if (_stopping) return;
+      seenGeneration = _generation;
+      task = _task;
+      taskCount = _taskCount;
+      _activeWorkers++;
+    }
+
+    executeTasks(*task, taskCount);
+
+    {
+      std::lock_guard lock(_mutex);
+      _activeWorkers--;
+    }
+    _workDone.notify_all();
+  }
+}
@@ -0,0 +1,47 @@
+#ifndef _THREAD_POOL_HPP_
+#define _THREAD_POOL_HPP_
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <cstdint>
+
+// Fixed set of worker threads for running data-parallel loops
+class ThreadPool {
+private:
+  std::vector<std::thread> _workers;
+
+  std::mutex _mutex;
+  std::condition_variable _workAvailable;
+  std::condition_variable _workDone;
+  uint64_t _generation = 0; // incremented for every run()
+  bool _stopping = false;
+
+  // State of the current run(), only changed while no worker is active
+  const std::function<void(size_t)>* _task = nullptr;
+  size_t _taskCount = 0;
+  std::atomic<size_t> _nextTask = 0;
+  std::atomic<size_t> _remainingTasks = 0;
+  size_t _activeWorkers = 0;
+
+  void workerLoop();
+  void executeTasks(const std::function<void(size_t)>& task, size_t taskCount);
+
+public:
+  // threadCount includes the thread calling run()
+  ThreadPool(size_t threadCount = std::thread::hardware_concurrency());
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  size_t threadCount() const { return _workers.size() + 1; }
+
+  // Call task(i) for every i in [0, taskCount) on the workers and the calling thread, return when all of them are done
+  // Not reentrant, run() must not be called from inside a task
+  void run(size_t taskCount, const std::function<void(size_t)>& task);
+};
+
+#endif
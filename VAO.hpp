@@ -1,6 +1,7 @@
 #ifndef _VAO_HPP_
 #define _VAO_HPP_
 #include <GL/glew.h>
+#include "GLState.hpp"
 
 class VAO {
 private:
@@ -12,6 +13,7 @@ public:
   }
   ~VAO() {
     glDeleteVertexArrays(1, &_id);
+    GLState::vertexArrayDeleted(_id);
   }
 
   VAO(const VAO&) = delete;
@@ -20,7 +22,7 @@ public:
   GLuint id() const { return _id; }
 
   void bind() {
-    glBindVertexArray(_id);
+    GLState::bindVertexArray(_id);
   }
 
   void enableAndSetAttribPointer(GLint location, GLint size, GLenum type, GLboolean normalize, GLsizei stride, size_t offset) {
@@ -32,6 +34,11 @@ public:
     glEnableVertexAttribArray(location);
     glVertexAttribIPointer(location, size, type, stride, (void*) offset);
   }
+
+  // Advance the attribute once per this many instances instead of once per vertex (GL_ARB_instanced_arrays)
+  void setAttribDivisor(GLint location, GLuint divisor) {
+    glVertexAttribDivisorARB(location, divisor);
+  }
 };
 
 #endif
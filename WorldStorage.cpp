@@ -0,0 +1,568 @@
+#include <iostream>
+#include <fstream>
+#include <array>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include "WorldStorage.hpp"
+#include "Metrics.hpp"
+
+namespace {
+
+const char SECTIONS_MAGIC[4] = {'U', 'B', 'G', 'W'};
+const char JOURNAL_MAGIC[4] = {'U', 'B', 'G', 'J'};
+const uint8_t VERSION = 1;
+const std::string SECTIONS_FILENAME = "sections";
+const std::string JOURNAL_PREFIX = "journal.";
+
+const size_t SLOT_BYTES = WorldStorage::SECTION_SIZE * WorldStorage::SECTION_SIZE * WorldStorage::SECTION_SIZE * sizeof(BlockCell);
+const size_t RECORD_HEADER_BYTES = 8; // payload length and CRC-32, both uint32
+const size_t RUN_BYTES = 16; // start as 3 int32, length, cell
+
+// Little endian, like the protocol
+void putU8(std::vector<uint8_t>& bytes, uint8_t value) { bytes.push_back(value); }
+void putU16(std::vector<uint8_t>& bytes, uint16_t value) { putU8(bytes, value); putU8(bytes, value >> 8); }
+void putU32(std::vector<uint8_t>& bytes, uint32_t value) { putU16(bytes, value); putU16(bytes, value >> 16); }
+void putIvec3(std::vector<uint8_t>& bytes, glm::ivec3 value) { putU32(bytes, value.x); putU32(bytes, value.y); putU32(bytes, value.z); }
+
+uint16_t getU16(const uint8_t* b) { return b[0] | b[1] << 8; }
+uint32_t getU32(const uint8_t* b) { return getU16(b) | (uint32_t) getU16(b + 2) << 16; }
+glm::ivec3 getIvec3(const uint8_t* b) { return glm::ivec3((int32_t) getU32(b), (int32_t) getU32(b + 4), (int32_t) getU32(b + 8)); }
+
+class Reader {
+private:
+  const std::vector<uint8_t>& _bytes;
+  std::string _name;
+  size_t _offset = 0;
+
+public:
+  Reader(const std::vector<uint8_t>& bytes_, const std::string& name_) : _bytes(bytes_), _name(name_) {}
+
+  size_t offset() const { return _offset; }
+  size_t remaining() const { return _bytes.size() - _offset; }
+
+  const uint8_t* take(size_t count) {
+    if (remaining() < count) throw WorldStorageException(_name + " is truncated");
+    const uint8_t* data = _bytes.data() + _offset;
+    _offset += count;
+    return data;
+  }
+  uint8_t u8() { return *take(1); }
+  uint16_t u16() { return getU16(take(2)); }
+  glm::ivec3 ivec3() { return getIvec3(take(12)); }
+  std::string string() {
+    uint16_t size = u16();
+    const uint8_t* data = take(size);
+    return std::string(data, data + size);
+  }
+};
+
+uint32_t crc32(const uint8_t* data, size_t size) {
+  static const std::array<uint32_t, 256> table = [] () {
+    std::array<uint32_t, 256> result;
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (int bit = 0; bit < 8; bit++) {
+        c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+      }
+      result[i] = c;
+    }
+    return result;
+  }();
+  uint32_t crc = 0xffffffffu;
+  for (size_t i = 0; i < size; i++) {
+    crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  }
+  return crc ^ 0xffffffffu;
+}
+
+// Names of the block types by ID, so that a world survives the IDs changing when blocks.txt does
+void putBlockTypes(std::vector<uint8_t>& bytes, const BlockRegistry& registry) {
+  putU16(bytes, registry.size());
+  for (size_t id = 0; id < registry.size(); id++) {
+    const std::string& name = registry.type(id).blockId();
+    putU16(bytes, name.size());
+    bytes.insert(bytes.end(), name.begin(), name.end());
+  }
+}
+
+std::vector<std::string> readBlockTypes(Reader& reader) {
+  std::vector<std::string> names(reader.u16());
+  for (std::string& name : names) {
+    name = reader.string();
+  }
+  return names;
+}
+
+void readMagic(Reader& reader, const char magic[4], const std::string& name) {
+  if (memcmp(reader.take(4), magic, 4) != 0) {
+    throw WorldStorageException(name + " is not part of a saved world");
+  }
+  uint8_t version = reader.u8();
+  if (version != VERSION) {
+    throw WorldStorageException("Unsupported version " + std::to_string(version) + " of " + name);
+  }
+}
+
+// Whether cells written with the names are the cells of the registry
+bool sameBlockTypes(const BlockRegistry& registry, const std::vector<std::string>& names) {
+  if (names.size() != registry.size()) return false;
+  for (size_t id = 0; id < names.size(); id++) {
+    if (names[id] != registry.type(id).blockId()) return false;
+  }
+  return true;
+}
+
+std::vector<std::optional<Block>> blocksByCell(const BlockRegistry& registry, const std::vector<std::string>& names) {
+  std::vector<std::optional<Block>> blocks;
+  blocks.emplace_back();
+  for (const std::string& name : names) {
+    blocks.emplace_back(Block(registry.type(registry.id(name))));
+  }
+  return blocks;
+}
+
+// The whole records at the start of data, stops at the first one that is cut short or corrupt
+template <typename F>
+void forEachRun(const uint8_t* data, size_t size, F&& callback) {
+  while (size >= RECORD_HEADER_BYTES) {
+    uint32_t payloadBytes = getU32(data);
+    uint32_t checksum = getU32(data + 4);
+    const uint8_t* payload = data + RECORD_HEADER_BYTES;
+    if (
+      payloadBytes > size - RECORD_HEADER_BYTES ||
+      payloadBytes % RUN_BYTES != 0 ||
+      crc32(payload, payloadBytes) != checksum
+    ) {
+      return;
+    }
+    for (const uint8_t* run = payload; run < payload + payloadBytes; run += RUN_BYTES) {
+      callback(WorldStorage::Run{getIvec3(run), getU16(run + 12), getU16(run + 14)});
+    }
+    data += RECORD_HEADER_BYTES + payloadBytes;
+    size -= RECORD_HEADER_BYTES + payloadBytes;
+  }
+}
+
+std::vector<uint8_t> readFile(const std::filesystem::path& path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    std::string msg = strerror(errno);
+    throw WorldStorageException("Cannot open " + path.string() + ": " + msg);
+  }
+  std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  if (file.bad()) {
+    throw WorldStorageException("Cannot read " + path.string());
+  }
+  return bytes;
+}
+
+int openFile(const std::filesystem::path& path, int flags) {
+  int fd = open(path.c_str(), flags | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    std::string msg = strerror(errno);
+    throw WorldStorageException("Cannot open " + path.string() + ": " + msg);
+  }
+  return fd;
+}
+
+bool writeAll(int fd, const uint8_t* data, size_t size, off_t offset) {
+  while (size > 0) {
+    ssize_t written = pwrite(fd, data, size, offset);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    data += written;
+    size -= written;
+    offset += written;
+  }
+  return true;
+}
+
+// Makes files created, renamed or removed in the directory durable
+void syncDirectory(const std::filesystem::path& directory) {
+  int fd = openFile(directory, O_RDONLY | O_DIRECTORY);
+  fsync(fd);
+  close(fd);
+}
+
+}
+
+std::optional<BlocksRegion> WorldStorage::savedBounds(const std::string& directory) {
+  std::filesystem::path path = std::filesystem::path(directory) / SECTIONS_FILENAME;
+  if (!std::filesystem::exists(path)) return {};
+
+  std::ifstream file(path, std::ios::binary);
+  std::vector<uint8_t> header(4 + 1 + 2 * 12);
+  if (!file.read(reinterpret_cast<char*>(header.data()), header.size())) {
+    throw WorldStorageException(path.string() + " is truncated");
+  }
+  Reader reader(header, path.string());
+  readMagic(reader, SECTIONS_MAGIC, path.string());
+  glm::ivec3 basePosition = reader.ivec3();
+  return BlocksRegion{basePosition, basePosition + reader.ivec3()};
+}
+
+WorldStorage::WorldStorage(const std::string& directory, BlocksMap& blocksMap_) : _directory(directory), _blocksMap(blocksMap_) {
+  _basePosition = _blocksMap.basePosition;
+  _size = _blocksMap.size;
+  _sectionCount = (_size + SECTION_SIZE - 1) / SECTION_SIZE;
+
+  std::error_code error;
+  std::filesystem::create_directories(_directory, error);
+  if (error) {
+    throw WorldStorageException("Cannot create " + _directory.string() + ": " + error.message());
+  }
+
+  std::vector<uint64_t> generations = journalGenerations();
+  if (std::filesystem::exists(_directory / SECTIONS_FILENAME)) {
+    load();
+  } else {
+    writeSnapshot();
+  }
+
+  _journalHeader.insert(_journalHeader.end(), JOURNAL_MAGIC, JOURNAL_MAGIC + sizeof(JOURNAL_MAGIC));
+  putU8(_journalHeader, VERSION);
+  putBlockTypes(_journalHeader, _blocksMap.registry());
+  // Never appended to a journal of an earlier run, whose last record may be torn
+  _journalGeneration = generations.empty() ? 0 : generations.back() + 1;
+  _journal = createJournal(_journalGeneration);
+  _journalBytes = _journalHeader.size();
+
+  _blocksMap.observer(this);
+  _writerThread = std::thread(&WorldStorage::writerLoop, this);
+  _compactorThread = std::thread(&WorldStorage::compactorLoop, this);
+}
+
+WorldStorage::~WorldStorage() {
+  _blocksMap.observer(nullptr);
+  {
+    std::lock_guard lock(_mutex);
+    _stopping = true;
+  }
+  _writerWake.notify_one();
+  _compactorWake.notify_one();
+  _writerThread.join();
+  _compactorThread.join();
+  close(_journal);
+}
+
+std::filesystem::path WorldStorage::journalPath(uint64_t generation) const {
+  return _directory / (JOURNAL_PREFIX + std::to_string(generation));
+}
+
+void WorldStorage::removeJournal(uint64_t generation) const {
+  std::error_code error;
+  std::filesystem::remove(journalPath(generation), error);
+  if (error) {
+    throw WorldStorageException("Cannot remove " + journalPath(generation).string() + ": " + error.message());
+  }
+}
+
+std::vector<uint64_t> WorldStorage::journalGenerations() const {
+  std::vector<uint64_t> generations;
+  std::error_code error;
+  std::filesystem::directory_iterator entries(_directory, error);
+  if (error) {
+    throw WorldStorageException("Cannot list " + _directory.string() + ": " + error.message());
+  }
+  for (const std::filesystem::directory_entry& entry : entries) {
+    std::string name = entry.path().filename().string();
+    if (name.size() <= JOURNAL_PREFIX.size() || name.compare(0, JOURNAL_PREFIX.size(), JOURNAL_PREFIX) != 0) continue;
+    std::string digits = name.substr(JOURNAL_PREFIX.size());
+    if (!std::all_of(digits.begin(), digits.end(), [] (char c) { return c >= '0' && c <= '9'; })) continue;
+    generations.push_back(std::stoull(digits));
+  }
+  std::sort(generations.begin(), generations.end());
+  return generations;
+}
+
+BlocksRegion WorldStorage::sectionRegion(size_t section) const {
+  glm::ivec3 sectionPosition(section % _sectionCount.x, section / (_sectionCount.x * _sectionCount.z), section / _sectionCount.x % _sectionCount.z);
+  glm::ivec3 min = _basePosition + sectionPosition * SECTION_SIZE;
+  return BlocksRegion{min, glm::min(min + SECTION_SIZE, _basePosition + _size)};
+}
+
+void WorldStorage::load() {
+  const BlockRegistry& registry = _blocksMap.registry();
+  std::filesystem::path sectionsPath = _directory / SECTIONS_FILENAME;
+  std::vector<uint8_t> sections = readFile(sectionsPath);
+  Reader reader(sections, sectionsPath.string());
+  readMagic(reader, SECTIONS_MAGIC, sectionsPath.string());
+  glm::ivec3 basePosition = reader.ivec3();
+  glm::ivec3 size = reader.ivec3();
+  if (basePosition != _basePosition || size != _size) {
+    throw WorldStorageException("The world saved in " + _directory.string() + " does not have the bounds of the map");
+  }
+  std::vector<std::string> names = readBlockTypes(reader);
+  bool upToDate = sameBlockTypes(registry, names);
+  std::vector<std::optional<Block>> sectionBlocks = blocksByCell(registry, names);
+
+  _sectionsHeaderBytes = reader.offset();
+  size_t sectionCount = (size_t) _sectionCount.x * _sectionCount.y * _sectionCount.z;
+  if (reader.remaining() != sectionCount * SLOT_BYTES) {
+    throw WorldStorageException(sectionsPath.string() + " does not have a slot for every section");
+  }
+  for (size_t section = 0; section < sectionCount; section++) {
+    SectionMessage message{sectionRegion(section), {}};
+    const uint8_t* slot = reader.take(SLOT_BYTES);
+    message.cells.resize(message.region.volume());
+    for (size_t i = 0; i < message.cells.size(); i++) {
+      message.cells[i] = getU16(slot + i * sizeof(BlockCell));
+    }
+    try {
+      applySection(_blocksMap, message, sectionBlocks);
+    } catch (const ProtocolException& e) {
+      throw WorldStorageException(sectionsPath.string() + " is corrupt: " + e.what());
+    }
+  }
+
+  // The journals left by the last run, in the order they were written
+  std::vector<uint64_t> generations = journalGenerations();
+  for (uint64_t generation : generations) {
+    std::vector<uint8_t> journal = readFile(journalPath(generation));
+    Reader journalReader(journal, journalPath(generation).string());
+    // A journal is only written to once its header is committed, one that stops within the header has no records
+    if (journal.size() < sizeof(JOURNAL_MAGIC) + 1) continue;
+    readMagic(journalReader, JOURNAL_MAGIC, journalPath(generation).string());
+    std::vector<std::string> journalNames;
+    try {
+      journalNames = readBlockTypes(journalReader);
+    } catch (const WorldStorageException& e) {
+      continue;
+    }
+    upToDate = upToDate && sameBlockTypes(registry, journalNames);
+    std::vector<std::optional<Block>> journalBlocks = blocksByCell(registry, journalNames);
+    forEachRun(journal.data() + journalReader.offset(), journalReader.remaining(), [&] (const Run& run) {
+      if (run.cell >= journalBlocks.size()) {
+        throw WorldStorageException(journalPath(generation).string() + " refers to an unknown block type");
+      }
+      _blocksMap.fill(BlocksRegion{run.start, run.start + glm::ivec3(run.length, 1, 1)}, journalBlocks[run.cell]);
+    });
+  }
+
+  if (upToDate) {
+    _sealedJournals.assign(generations.begin(), generations.end());
+  } else {
+    // The compactor copies cells as they are, so the saved cells are brought to the IDs of the registry once here
+    writeSnapshot();
+  }
+}
+
+void WorldStorage::writeSnapshot() {
+  std::vector<uint8_t> bytes(SECTIONS_MAGIC, SECTIONS_MAGIC + sizeof(SECTIONS_MAGIC));
+  putU8(bytes, VERSION);
+  putIvec3(bytes, _basePosition);
+  putIvec3(bytes, _size);
+  putBlockTypes(bytes, _blocksMap.registry());
+  _sectionsHeaderBytes = bytes.size();
+
+  size_t sectionCount = (size_t) _sectionCount.x * _sectionCount.y * _sectionCount.z;
+  bytes.reserve(bytes.size() + sectionCount * SLOT_BYTES);
+  for (size_t section = 0; section < sectionCount; section++) {
+    size_t slotStart = bytes.size();
+    for (BlockCell cell : sectionOfMap(_blocksMap, sectionRegion(section)).cells) {
+      putU16(bytes, cell);
+    }
+    bytes.resize(slotStart + SLOT_BYTES);
+  }
+
+  // Written aside and renamed over, so that a crash leaves either the old or the new sections
+  std::filesystem::path temporaryPath = _directory / (SECTIONS_FILENAME + ".tmp");
+  int fd = openFile(temporaryPath, O_WRONLY | O_CREAT | O_TRUNC);
+  bool written = writeAll(fd, bytes.data(), bytes.size(), 0) && fdatasync(fd) == 0;
+  std::string msg = strerror(errno);
+  close(fd);
+  if (!written) {
+    throw WorldStorageException("Cannot write " + temporaryPath.string() + ": " + msg);
+  }
+  std::error_code error;
+  std::filesystem::rename(temporaryPath, _directory / SECTIONS_FILENAME, error);
+  if (error) {
+    throw WorldStorageException("Cannot replace " + (_directory / SECTIONS_FILENAME).string() + ": " + error.message());
+  }
+  syncDirectory(_directory);
+
+  for (uint64_t generation : journalGenerations()) {
+    removeJournal(generation);
+  }
+  syncDirectory(_directory);
+}
+
+int WorldStorage::createJournal(uint64_t generation) {
+  int fd = openFile(journalPath(generation), O_WRONLY | O_CREAT | O_TRUNC);
+  if (!writeAll(fd, _journalHeader.data(), _journalHeader.size(), 0) || fdatasync(fd) != 0) {
+    std::string msg = strerror(errno);
+    close(fd);
+    throw WorldStorageException("Cannot write " + journalPath(generation).string() + ": " + msg);
+  }
+  syncDirectory(_directory);
+  return fd;
+}
+
+void WorldStorage::blocksChanged(const BlocksMap& blocksMap, const BlocksRegion& region) {
+  std::lock_guard lock(_mutex);
+  for (int y = region.min.y; y < region.max.y; y++) {
+    for (int z = region.min.z; z < region.max.z; z++) {
+      const std::optional<Block>* row = &blocksMap.storage[*blocksMap.calculateStorageLocation(glm::ivec3(region.min.x, y, z))] - region.min.x;
+      int x = region.min.x;
+      while (x < region.max.x) {
+        int start = x;
+        BlockCell cell = blockCell(row[x]);
+        while (++x < region.max.x && x - start < UINT16_MAX && blockCell(row[x]) == cell) {}
+        _pendingRuns.push_back(Run{glm::ivec3(start, y, z), (uint16_t) (x - start), cell});
+      }
+    }
+  }
+}
+
+void WorldStorage::writerLoop() {
+  std::unique_lock lock(_mutex);
+  bool stopping = false;
+  while (!stopping) {
+    stopping = _writerWake.wait_for(lock, COMMIT_INTERVAL, [this] { return _stopping; });
+    // Runs that failed to commit stay in front of the newer ones
+    if (_committingRuns.empty()) {
+      std::swap(_committingRuns, _pendingRuns);
+    } else {
+      _committingRuns.insert(_committingRuns.end(), _pendingRuns.begin(), _pendingRuns.end());
+      _pendingRuns.clear();
+    }
+    lock.unlock();
+
+    if (!_committingRuns.empty() && commit()) {
+      _committingRuns.clear();
+    }
+
+    if (_journalBytes >= COMPACT_BYTES && !stopping) {
+      try {
+        int next = createJournal(_journalGeneration + 1);
+        close(_journal);
+        {
+          std::lock_guard sealedLock(_mutex);
+          _sealedJournals.push_back(_journalGeneration);
+        }
+        _compactorWake.notify_one();
+        _journal = next;
+        _journalGeneration++;
+        _journalBytes = _journalHeader.size();
+      } catch (const WorldStorageException& e) {
+        std::cerr << e.what() << std::endl;
+      }
+    }
+    lock.lock();
+  }
+  if (!_committingRuns.empty()) {
+    std::cerr << "Lost " << _committingRuns.size() << " block edits that could not be saved" << std::endl;
+  }
+}
+
+bool WorldStorage::commit() {
+  _record.assign(RECORD_HEADER_BYTES, 0);
+  for (const Run& run : _committingRuns) {
+    putIvec3(_record, run.start);
+    putU16(_record, run.length);
+    putU16(_record, run.cell);
+  }
+  uint32_t payloadBytes = _record.size() - RECORD_HEADER_BYTES;
+  uint32_t checksum = crc32(_record.data() + RECORD_HEADER_BYTES, payloadBytes);
+  for (int i = 0; i < 4; i++) {
+    _record[i] = payloadBytes >> (8 * i);
+    _record[4 + i] = checksum >> (8 * i);
+  }
+
+  if (!writeAll(_journal, _record.data(), _record.size(), _journalBytes) || fdatasync(_journal) != 0) {
+    if (!_commitFailing) {
+      std::cerr << "Cannot write " << journalPath(_journalGeneration).string() << ": " << strerror(errno) << ", retrying" << std::endl;
+    }
+    _commitFailing = true;
+    // Drop the partial record, so that the retry follows the last whole one
+    if (ftruncate(_journal, _journalBytes) != 0) {}
+    return false;
+  }
+  _commitFailing = false;
+  _journalBytes += _record.size();
+
+  static Metric& journalBytes = Metrics::counter("world.journal_bytes");
+  static Metric& commits = Metrics::counter("world.journal_commits");
+  journalBytes.add(_record.size());
+  commits.add();
+  return true;
+}
+
+void WorldStorage::compactorLoop() {
+  std::unique_lock lock(_mutex);
+  while (true) {
+    _compactorWake.wait(lock, [this] { return _stopping || !_sealedJournals.empty(); });
+    if (_stopping) return;
+    uint64_t generation = _sealedJournals.front();
+    lock.unlock();
+    try {
+      compact(generation);
+    } catch (const WorldStorageException& e) {
+      // Folding later journals first would let older edits overwrite newer ones on the next replay, they all wait for the next run
+      std::cerr << e.what() << std::endl;
+      return;
+    }
+    lock.lock();
+    _sealedJournals.pop_front();
+  }
+}
+
+void WorldStorage::compact(uint64_t generation) {
+  std::vector<uint8_t> journal = readFile(journalPath(generation));
+  size_t recordsStart = std::min(journal.size(), _journalHeader.size());
+
+  std::filesystem::path sectionsPath = _directory / SECTIONS_FILENAME;
+  int fd = openFile(sectionsPath, O_RDWR);
+  // Only the slots the journal touches are read and written back
+  std::unordered_map<size_t, std::vector<uint8_t>> slots;
+  bool succeeded = true;
+  forEachRun(journal.data() + recordsStart, journal.size() - recordsStart, [&] (const Run& run) {
+    for (int x = run.start.x; x < run.start.x + run.length; x++) {
+      glm::ivec3 position(x, run.start.y, run.start.z);
+      glm::ivec3 internalPosition = position - _basePosition;
+      if (
+        (unsigned) internalPosition.x >= (unsigned) _size.x ||
+        (unsigned) internalPosition.y >= (unsigned) _size.y ||
+        (unsigned) internalPosition.z >= (unsigned) _size.z
+      ) {
+        continue;
+      }
+
+      glm::ivec3 sectionPosition = internalPosition / SECTION_SIZE;
+      size_t section = (sectionPosition.y * _sectionCount.z + sectionPosition.z) * _sectionCount.x + sectionPosition.x;
+      auto [it, inserted] = slots.try_emplace(section);
+      if (inserted) {
+        it->second.resize(SLOT_BYTES);
+        succeeded = succeeded && pread(fd, it->second.data(), SLOT_BYTES, _sectionsHeaderBytes + section * SLOT_BYTES) == (ssize_t) SLOT_BYTES;
+      }
+      BlocksRegion region = sectionRegion(section);
+      glm::ivec3 extent = region.max - region.min;
+      glm::ivec3 local = position - region.min;
+      size_t cellOffset = ((local.y * extent.z + local.z) * extent.x + local.x) * sizeof(BlockCell);
+      it->second[cellOffset] = run.cell;
+      it->second[cellOffset + 1] = run.cell >> 8;
+    }
+  });
+  for (const auto& [section, slot] : slots) {
+    succeeded = succeeded && writeAll(fd, slot.data(), SLOT_BYTES, _sectionsHeaderBytes + section * SLOT_BYTES);
+  }
+  succeeded = succeeded && fdatasync(fd) == 0;
+  std::string msg = strerror(errno);
+  close(fd);
+  if (!succeeded) {
+    throw WorldStorageException("Cannot compact " + journalPath(generation).string() + " into " + sectionsPath.string() + ": " + msg);
+  }
+
+  // A crash before the removal replays the journal over sections that already have it, which changes nothing
+  removeJournal(generation);
+  syncDirectory(_directory);
+
+  static Metric& compactedJournals = Metrics::counter("world.journals_compacted");
+  compactedJournals.add();
+}
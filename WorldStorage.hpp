@@ -0,0 +1,104 @@
+#ifndef _WORLD_STORAGE_HPP_
+#define _WORLD_STORAGE_HPP_
+#include <string>
+#include <vector>
+#include <deque>
+#include <optional>
+#include <filesystem>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "ApplicationException.hpp"
+#include "BlocksMap.hpp"
+#include "Protocol.hpp"
+
+// Keeps a BlocksMap saved in a directory, at a cost that follows the edits rather than the size of the world
+// The directory holds:
+//   sections: the map as of the last compaction, a fixed size slot of cells per SECTION_SIZE^3 section
+//   journal.N: the edits made since, as checksummed records of runs of cells along x
+// Edits reach the storage as a BlocksMapObserver and are only queued on the calling thread
+// A writer thread turns everything queued over COMMIT_INTERVAL into one record and one fdatasync (group commit)
+// A journal that grows past COMPACT_BYTES is sealed and the next one started, a compactor thread folds sealed journals into sections and deletes them
+// Opening a saved world replays sections then the journals in order, a record that is cut short or fails its checksum ends its journal, it was never committed
+class WorldStorage : public BlocksMapObserver {
+public:
+  static constexpr int SECTION_SIZE = 16;
+  static constexpr std::chrono::milliseconds COMMIT_INTERVAL{100};
+  static constexpr size_t COMPACT_BYTES = 4 << 20;
+
+  struct Run {
+    glm::ivec3 start;
+    uint16_t length;
+    BlockCell cell;
+  };
+
+private:
+  std::filesystem::path _directory;
+  BlocksMap& _blocksMap;
+  // Copied from the map, so that the compactor never has to touch it
+  glm::ivec3 _basePosition;
+  glm::ivec3 _size;
+  glm::ivec3 _sectionCount; // along each axis
+  size_t _sectionsHeaderBytes;
+
+  std::mutex _mutex;
+  bool _stopping = false;
+
+  // Writer thread, the pending runs are guarded by _mutex and the rest only used by the thread
+  std::condition_variable _writerWake;
+  std::vector<Run> _pendingRuns;
+  std::vector<Run> _committingRuns;
+  std::vector<uint8_t> _record;
+  std::vector<uint8_t> _journalHeader; // the same for every journal of a run, it lists the block types of the registry
+  int _journal = -1;
+  uint64_t _journalGeneration;
+  size_t _journalBytes; // committed, the end of the last whole record
+  bool _commitFailing = false;
+  std::thread _writerThread;
+
+  // Compactor thread, the sealed journals are guarded by _mutex
+  std::condition_variable _compactorWake;
+  std::deque<uint64_t> _sealedJournals; // generations, oldest first
+  std::thread _compactorThread;
+
+  std::filesystem::path journalPath(uint64_t generation) const;
+  // Generations of the journals in the directory, oldest first
+  std::vector<uint64_t> journalGenerations() const;
+  void removeJournal(uint64_t generation) const;
+  BlocksRegion sectionRegion(size_t section) const;
+
+  void load();
+  // Write the whole map as the sections and drop the journals
+  void writeSnapshot();
+  // Returns the file descriptor of a new journal holding just the header
+  int createJournal(uint64_t generation);
+
+  void writerLoop();
+  bool commit();
+  void compactorLoop();
+  void compact(uint64_t generation);
+
+public:
+  // Bounds of the world saved in directory, to create the map with, or empty if there is none
+  static std::optional<BlocksRegion> savedBounds(const std::string& directory);
+
+  // Loads the world saved in directory into blocksMap, which has to have its bounds, or saves blocksMap there as a new world
+  // Then saves every edit of blocksMap until destroyed
+  WorldStorage(const std::string& directory, BlocksMap& blocksMap_);
+  // Commits the edits still queued
+  ~WorldStorage();
+
+  WorldStorage(const WorldStorage&) = delete;
+  WorldStorage& operator=(const WorldStorage&) = delete;
+
+  void blocksChanged(const BlocksMap& blocksMap, const BlocksRegion& region) override;
+};
+
+class WorldStorageException : public ApplicationException {
+  using ApplicationException::ApplicationException;
+};
+
+#endif
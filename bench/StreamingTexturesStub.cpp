@@ -0,0 +1,43 @@
+#include <optional>
+#include "StreamingTextures.hpp"
+
+// GL-free replacement of StreamingTextures for headless builds, only does the bookkeeping of the cell grid
+
+StreamingTextures::StreamingTextures(size_t cellSideLength_, size_t cellCountPerSide_, std::vector<GLenum>&& textureFormats_, std::function<void(size_t, GLuint)> configFunc) {
+  _cellSideLength = cellSideLength_;
+  _cellCountPerSide = cellCountPerSide_;
+  _textureFormats = textureFormats_;
+  _registry.resize(_cellCountPerSide * _cellCountPerSide, false);
+  _textureIds.resize(_textureFormats.size(), 0);
+}
+
+StreamingTextures::~StreamingTextures() {
+}
+
+void StreamingTextures::bind() {
+}
+
+std::shared_ptr<StreamingTexturesPart> StreamingTextures::allocate(const std::vector<CellData>& data) {
+  if (data.size() != _textureIds.size()) {
+    throw std::invalid_argument("number of data is inconsistent with number of textures");
+  }
+
+  std::optional<size_t> emptySpotIndex;
+  for (size_t i = 0; i < _registry.size(); i++) {
+    if (_registry[i] == false) {
+      _registry[i] = true;
+      emptySpotIndex.emplace(i);
+      break;
+    }
+  }
+  if (!emptySpotIndex) {
+    throw AllocationError("this StreamingTextures is full");
+  }
+
+  return std::shared_ptr<StreamingTexturesPart>(new StreamingTexturesPart(*this, *emptySpotIndex % _cellCountPerSide, *emptySpotIndex / _cellCountPerSide));
+}
+
+std::shared_ptr<StreamingTexturesPart> StreamingTextures::allocateFromFiles(const std::vector<std::string>& filenames) {
+  // The files are not read, only a cell is taken
+  return allocate(std::vector<CellData>(filenames.size()));
+}
@@ -0,0 +1,509 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <filesystem>
+#include <new>
+#include <cstdlib>
+#include <cstdint>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "StreamingTextures.hpp"
+#include "Block.hpp"
+#include "BlockType.hpp"
+#include "BlockRegistry.hpp"
+#include "BlockBehaviours.hpp"
+#include "BlockTickScheduler.hpp"
+#include "BlocksMap.hpp"
+#include "BlocksMesh.hpp"
+#include "MeshCache.hpp"
+#include "BlockFacesMesh.hpp"
+#include "LightMap.hpp"
+#include "EntityStore.hpp"
+#include "EntitySpatialHash.hpp"
+#include "Raycast.hpp"
+#include "ParticleSystem.hpp"
+#include "ThreadPool.hpp"
+
+// Headless benchmarks of the CPU side of the game
+// Each result is printed as one JSON object per line, so that it can be collected and compared across commits
+
+// Count every heap allocation made by the process
+// The operators are kept out of line, otherwise GCC mistakes the malloc/free pairs for mismatched new/delete
+namespace {
+size_t allocatedBytes = 0;
+size_t allocationCount = 0;
+}
+
+[[gnu::noinline]] void* operator new(size_t size) {
+  allocatedBytes += size;
+  allocationCount++;
+  if (void* ptr = std::malloc(size ? size : 1)) return ptr;
+  throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+[[gnu::noinline]] void operator delete(void* ptr, size_t) noexcept {
+  std::free(ptr);
+}
+
+namespace {
+
+struct Options {
+  int worldSize = 16;
+  size_t iterations = 5;
+  std::string filter;
+};
+
+struct Measurement {
+  double medianNs;
+  double minNs;
+  size_t bytesAllocated; // per iteration
+  size_t allocations; // per iteration
+};
+
+// Run func once to warm up, then time it for the given iterations
+Measurement measure(size_t iterations, const std::function<void()>& func) {
+  func();
+
+  std::vector<double> timesNs;
+  timesNs.reserve(iterations);
+  size_t bytesBefore = allocatedBytes;
+  size_t countBefore = allocationCount;
+  for (size_t i = 0; i < iterations; i++) {
+    auto start = std::chrono::steady_clock::now();
+    func();
+    auto end = std::chrono::steady_clock::now();
+    timesNs.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+  }
+  size_t bytes = allocatedBytes - bytesBefore;
+  size_t count = allocationCount - countBefore;
+
+  std::sort(timesNs.begin(), timesNs.end());
+  return Measurement{
+    .medianNs = timesNs[timesNs.size() / 2],
+    .minNs = timesNs.front(),
+    .bytesAllocated = bytes / iterations,
+    .allocations = count / iterations,
+  };
+}
+
+// Deterministic integer hash, used as the noise source so that worlds are identical on every run
+uint32_t hash(int x, int y, int z, uint32_t seed) {
+  uint32_t h = seed;
+  for (int v : {x, y, z}) {
+    h ^= (uint32_t) v + 0x9e3779b9u + (h << 6) + (h >> 2);
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+  }
+  return h;
+}
+
+// Smoothly interpolated value noise in [0, 1)
+float valueNoise(float x, float z, uint32_t seed) {
+  int x0 = (int) glm::floor(x);
+  int z0 = (int) glm::floor(z);
+  float fx = x - x0;
+  float fz = z - z0;
+  fx = fx * fx * (3.f - 2.f * fx);
+  fz = fz * fz * (3.f - 2.f * fz);
+  auto corner = [seed] (int cx, int cz) { return (hash(cx, 0, cz, seed) & 0xffff) / 65536.f; };
+  float top = corner(x0, z0) + (corner(x0 + 1, z0) - corner(x0, z0)) * fx;
+  float bottom = corner(x0, z0 + 1) + (corner(x0 + 1, z0 + 1) - corner(x0, z0 + 1)) * fx;
+  return top + (bottom - top) * fz;
+}
+
+// Index into the block types, -1 for air
+using WorldGenerator = std::function<int(glm::ivec3 position, glm::ivec3 size)>;
+
+enum BenchBlockType { GRASS_BLOCK = 0, STONE, TREE_TRUNK, TREE_LEAVES, DIRT };
+
+const std::vector<std::pair<std::string, WorldGenerator>> worldGenerators = {
+  {"flat", [] (glm::ivec3 p, glm::ivec3 size) {
+    if (p.y < size.y / 2) return (int) STONE;
+    if (p.y == size.y / 2) return (int) GRASS_BLOCK;
+    return -1;
+  }},
+  {"noise", [] (glm::ivec3 p, glm::ivec3 size) {
+    float noise = valueNoise(p.x / 16.f, p.z / 16.f, 1) * 0.7f + valueNoise(p.x / 4.f, p.z / 4.f, 2) * 0.3f;
+    int height = (int) (size.y * (0.25f + 0.5f * noise));
+    if (p.y < height) return (int) STONE;
+    if (p.y == height) return (int) GRASS_BLOCK;
+    // Sparse foliage above ground
+    if (p.y < height + 6 && hash(p.x, p.y, p.z, 3) % 64 == 0) return (int) TREE_LEAVES;
+    return -1;
+  }},
+  {"checkerboard", [] (glm::ivec3 p, glm::ivec3 size) {
+    // Every face of every block is exposed
+    return ((p.x + p.y + p.z) % 2 == 0) ? (int) STONE : -1;
+  }},
+  {"solid", [] (glm::ivec3 p, glm::ivec3 size) {
+    return (int) STONE;
+  }},
+};
+
+void printResult(const std::string& benchmark, const std::string& world, size_t voxels, const Measurement& m, const std::string& extraFields = "") {
+  std::cout << "{\"benchmark\":\"" << benchmark << "\",\"world\":\"" << world << "\""
+    << ",\"voxels\":" << voxels
+    << ",\"median_ns\":" << (uint64_t) m.medianNs
+    << ",\"min_ns\":" << (uint64_t) m.minNs
+    << ",\"ns_per_voxel\":" << m.medianNs / voxels
+    << ",\"mvoxels_per_s\":" << voxels / m.medianNs * 1e3
+    << ",\"bytes_allocated\":" << m.bytesAllocated
+    << ",\"allocations\":" << m.allocations
+    << extraFields << "}" << std::endl;
+}
+
+bool selected(const Options& options, const std::string& name) {
+  return options.filter.empty() || name.find(options.filter) != std::string::npos;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--size" && i + 1 < argc) {
+      options.worldSize = std::atoi(argv[++i]);
+    } else if (arg == "--iterations" && i + 1 < argc) {
+      options.iterations = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--filter" && i + 1 < argc) {
+      options.filter = argv[++i];
+    } else {
+      std::cerr << "Usage: " << argv[0] << " [--size N] [--iterations N] [--filter SUBSTRING]" << std::endl;
+      return 1;
+    }
+  }
+
+  // Same block types as the game, with textures that only exist in the cell grid bookkeeping
+  StreamingTextures blockTextures(16, 16, std::vector<GLenum>{GL_RGBA8});
+  auto texture = [&blockTextures] () {
+    return blockTextures.allocate(std::vector<StreamingTextures::CellData>(1));
+  };
+  BlockRegistry blockRegistry;
+  {
+    auto grassTop = texture(), grassSide = texture(), grassBottom = texture();
+    blockRegistry.add(std::make_unique<BlockType>("grass_block", BlockTypeAttributes{.transparent = false}, std::array<std::shared_ptr<StreamingTexturesPart>, 6>{grassSide, grassSide, grassTop, grassBottom, grassSide, grassSide}));
+    auto stone = texture();
+    blockRegistry.add(std::make_unique<BlockType>("stone", BlockTypeAttributes{.transparent = false}, std::array<std::shared_ptr<StreamingTexturesPart>, 6>{stone, stone, stone, stone, stone, stone}));
+    auto trunkCross = texture(), trunkSide = texture();
+    blockRegistry.add(std::make_unique<BlockType>("tree_trunk", BlockTypeAttributes{.transparent = false}, std::array<std::shared_ptr<StreamingTexturesPart>, 6>{trunkSide, trunkSide, trunkCross, trunkCross, trunkSide, trunkSide}));
+    auto leaves = texture();
+    blockRegistry.add(std::make_unique<BlockType>("tree_leaves", BlockTypeAttributes{.transparent = true}, std::array<std::shared_ptr<StreamingTexturesPart>, 6>{leaves, leaves, leaves, leaves, leaves, leaves}));
+    blockRegistry.add(std::make_unique<BlockType>("dirt", BlockTypeAttributes{.transparent = false}, std::array<std::shared_ptr<StreamingTexturesPart>, 6>{grassBottom, grassBottom, grassBottom, grassBottom, grassBottom, grassBottom}));
+  }
+  addBlockBehaviours(blockRegistry);
+
+  glm::ivec3 size(options.worldSize);
+  glm::ivec3 basePosition(-options.worldSize / 2, 0, -options.worldSize / 2);
+  size_t voxelCount = (size_t) size.x * size.y * size.z;
+
+  ThreadPool threadPool;
+
+  for (const auto& [worldName, generator] : worldGenerators) {
+    BlocksMap blocksMap(blockRegistry, basePosition, size);
+    std::vector<int> layout(voxelCount);
+    for (size_t i = 0; i < voxelCount; i++) {
+      layout[i] = generator(blocksMap.calculatePosition(i) - basePosition, size);
+    }
+
+    auto fill = [&] () {
+      for (size_t i = 0; i < voxelCount; i++) {
+        glm::ivec3 position = blocksMap.calculatePosition(i);
+        if (layout[i] >= 0) {
+          blocksMap.set(position, Block(blockRegistry.type(layout[i])));
+        } else {
+          blocksMap.set(position, std::nullopt);
+        }
+      }
+    };
+
+    if (selected(options, "map_fill/" + worldName)) {
+      printResult("map_fill", worldName, voxelCount, measure(options.iterations, fill));
+    } else {
+      fill();
+    }
+
+    if (selected(options, "mesh_build/" + worldName)) {
+      size_t vertexCount = 0;
+      size_t indexCount = 0;
+      Measurement m = measure(options.iterations, [&] () {
+        BlocksMesh blocksMesh = BlocksMesh::buildFromBlocksMap(blocksMap);
+        vertexCount = blocksMesh.vertices.size();
+        indexCount = blocksMesh.vertexIndices.size();
+      });
+      printResult("mesh_build", worldName, voxelCount, m,
+        ",\"vertices\":" + std::to_string(vertexCount) +
+        ",\"indices\":" + std::to_string(indexCount) +
+        ",\"mesh_bytes\":" + std::to_string(vertexCount * sizeof(BlockVertex) + indexCount * sizeof(GLuint)));
+    }
+
+    if (selected(options, "mesh_rebuild/" + worldName)) {
+      // Rebuilding into the same mesh, as the game does after an edit, should not allocate once the first build has sized it
+      BlocksMesh blocksMesh;
+      printResult("mesh_rebuild", worldName, voxelCount, measure(options.iterations, [&] () {
+        blocksMesh.rebuild(blocksMap);
+      }));
+    }
+
+    if (selected(options, "mesh_cached_build/" + worldName)) {
+      // As on a cold start of an unchanged world: the cache file is opened and every section comes from it
+      std::string cacheFilename = (std::filesystem::temp_directory_path() / ("mc-clone-bench-" + worldName + ".meshes")).string();
+      {
+        MeshCache meshCache(cacheFilename);
+        BlocksMesh blocksMesh;
+        blocksMesh.rebuild(blocksMap, nullptr, &meshCache);
+        meshCache.save();
+      }
+      printResult("mesh_cached_build", worldName, voxelCount, measure(options.iterations, [&] () {
+        MeshCache meshCache(cacheFilename);
+        BlocksMesh blocksMesh;
+        blocksMesh.rebuild(blocksMap, nullptr, &meshCache);
+      }));
+      std::filesystem::remove(cacheFilename);
+    }
+
+    if (selected(options, "face_mesh_build/" + worldName)) {
+      size_t faceCount = 0;
+      Measurement m = measure(options.iterations, [&] () {
+        BlockFacesMesh blockFacesMesh = BlockFacesMesh::buildFromBlocksMap(blocksMap);
+        faceCount = blockFacesMesh.faces.size();
+      });
+      printResult("face_mesh_build", worldName, voxelCount, m,
+        ",\"faces\":" + std::to_string(faceCount) +
+        ",\"mesh_bytes\":" + std::to_string(faceCount * sizeof(uint32_t)));
+    }
+
+    if (selected(options, "face_mesh_rebuild/" + worldName)) {
+      BlockFacesMesh blockFacesMesh;
+      printResult("face_mesh_rebuild", worldName, voxelCount, measure(options.iterations, [&] () {
+        blockFacesMesh.rebuild(blocksMap);
+      }));
+    }
+
+    if (selected(options, "light_compute/" + worldName)) {
+      printResult("light_compute", worldName, voxelCount, measure(options.iterations, [&] () {
+        LightMap lightMap(blocksMap);
+      }));
+    }
+
+    if (selected(options, "light_update/" + worldName)) {
+      // Remove and put back the block at the top center, which changes the light of everything under it
+      LightMap lightMap(blocksMap);
+      glm::ivec3 position = basePosition + glm::ivec3(size.x / 2, 0, size.z / 2);
+      while (position.y < basePosition.y + size.y - 1 && blocksMap.get(position + glm::ivec3(0, 1, 0))) position.y++;
+      const size_t updatesPerIteration = 100;
+      const Block* original = blocksMap.get(position);
+      std::optional<Block> block;
+      if (original) block.emplace(*original);
+      Measurement m = measure(options.iterations, [&] () {
+        for (size_t i = 0; i < updatesPerIteration; i++) {
+          blocksMap.set(position, i % 2 ? block : std::nullopt);
+          lightMap.blockChanged(position);
+        }
+      });
+      blocksMap.set(position, block);
+      std::cout << "{\"benchmark\":\"light_update\",\"world\":\"" << worldName << "\""
+        << ",\"updates\":" << updatesPerIteration
+        << ",\"median_ns\":" << (uint64_t) m.medianNs
+        << ",\"ns_per_update\":" << m.medianNs / updatesPerIteration
+        << ",\"bytes_allocated\":" << m.bytesAllocated
+        << ",\"allocations\":" << m.allocations << "}" << std::endl;
+    }
+
+    if (selected(options, "region_edit/" + worldName)) {
+      // Fill a box at the center with stone and paste its original content back, relighting after each edit
+      LightMap lightMap(blocksMap);
+      glm::ivec3 boxSize = glm::max(size / 4, glm::ivec3(1));
+      glm::ivec3 boxMin = basePosition + (size - boxSize) / 2;
+      BlocksRegion box{boxMin, boxMin + boxSize};
+      BlocksMap original = blocksMap.copy(box);
+      Block stone(blockRegistry.type(blockRegistry.id("stone")));
+      printResult("region_edit", worldName, box.volume(), measure(options.iterations, [&] () {
+        lightMap.regionChanged(blocksMap.fill(box, stone));
+        lightMap.regionChanged(blocksMap.paste(original, box.min));
+      }));
+    }
+
+    if (selected(options, "raycast/" + worldName)) {
+      // Rays from random points in the map in random directions, long enough to cross it
+      const size_t rayCount = 10000;
+      std::vector<Ray> rays;
+      rays.reserve(rayCount);
+      for (size_t i = 0; i < rayCount; i++) {
+        auto random = [i] (int component) { return (hash((int) i, component, 0, 42) & 0xffff) / 65536.f; };
+        glm::vec3 origin = glm::vec3(basePosition) + glm::vec3(random(0), random(1), random(2)) * glm::vec3(size);
+        glm::vec3 direction(random(3) - 0.5f, random(4) - 0.5f, random(5) - 0.5f);
+        rays.push_back(Ray{origin, direction, 2.f * options.worldSize});
+      }
+      std::vector<std::optional<RaycastHit>> hits(rayCount);
+      Measurement m = measure(options.iterations, [&] () {
+        raycast(blocksMap, rays, hits);
+      });
+      size_t hitCount = std::count_if(hits.begin(), hits.end(), [] (const std::optional<RaycastHit>& hit) { return hit.has_value(); });
+      std::cout << "{\"benchmark\":\"raycast\",\"world\":\"" << worldName << "\""
+        << ",\"rays\":" << rayCount
+        << ",\"hits\":" << hitCount
+        << ",\"median_ns\":" << (uint64_t) m.medianNs
+        << ",\"ns_per_ray\":" << m.medianNs / rayCount
+        << ",\"bytes_allocated\":" << m.bytesAllocated
+        << ",\"allocations\":" << m.allocations << "}" << std::endl;
+    }
+
+    for (bool threaded : {false, true}) {
+      if (!selected(options, "block_ticks/" + worldName + (threaded ? "/threaded" : ""))) continue;
+      // On a copy, the ticks change the map
+      BlocksMap tickedMap = blocksMap.copy(BlocksRegion{basePosition, basePosition + size});
+      BlockTickScheduler blockTicks(tickedMap);
+      const size_t ticksPerIteration = 100;
+      Measurement m = measure(options.iterations, [&] () {
+        for (size_t i = 0; i < ticksPerIteration; i++) {
+          blockTicks.tick(threaded ? &threadPool : nullptr);
+        }
+      });
+      std::vector<glm::ivec3> changedPositions;
+      blockTicks.takeChangedPositions(changedPositions);
+      printResult("block_ticks", worldName, voxelCount, m,
+        ",\"threads\":" + std::to_string(threaded ? threadPool.threadCount() : 1) +
+        ",\"ticks\":" + std::to_string(ticksPerIteration) +
+        ",\"changes\":" + std::to_string(changedPositions.size()));
+    }
+  }
+
+  // Ground for entities to walk on in the collision benchmarks, with a wall of trunks every 8 blocks to step onto
+  BlocksMap groundMap(blockRegistry, basePosition, size);
+  for (size_t i = 0; i < voxelCount; i++) {
+    glm::ivec3 position = groundMap.calculatePosition(i);
+    glm::ivec3 internalPosition = position - basePosition;
+    if (internalPosition.y < size.y / 2) {
+      groundMap.set(position, Block(blockRegistry.type(STONE)));
+    } else if (internalPosition.y == size.y / 2 && internalPosition.x % 8 == 7) {
+      groundMap.set(position, Block(blockRegistry.type(TREE_TRUNK)));
+    }
+  }
+
+  // Single-threaded and with a thread pool, at counts below and above the threshold for splitting the update
+  for (size_t entityCount : {(size_t) 1, (size_t) 1000, (size_t) 100000}) {
+    for (bool collide : {false, true}) {
+      for (bool threaded : {false, true}) {
+        std::string name = "entity_store_update/" + std::to_string(entityCount) + (collide ? "/collide" : "") + (threaded ? "/threaded" : "");
+        if (!selected(options, name)) continue;
+
+        EntityStore store;
+        store.reserve(entityCount);
+        std::vector<EntityHandle> handles;
+        for (size_t i = 0; i < entityCount; i++) {
+          // Spread over the ground, standing on it
+          glm::vec3 position(basePosition.x + (float) (i % size.x), basePosition.y + size.y / 2 - 0.5f + 0.9f, basePosition.z + (float) (i / size.x % size.z));
+          EntityHandle handle = store.create(position);
+          store.halfExtents(handle, glm::vec3(0.3f, 0.9f, 0.3f));
+          store.stepHeight(handle, 0.6f);
+          handles.push_back(handle);
+        }
+
+        const size_t framesPerIteration = 100;
+        size_t frame = 0;
+        Measurement m = measure(options.iterations, [&] () {
+          for (size_t i = 0; i < framesPerIteration; i++, frame++) {
+            // Alternate between walking back and forth and stopping so that both sides of the model are exercised, half of the entities stay idle
+            // Walking also pushes down, so that the walking entities stay in contact with the ground
+            glm::vec3 desiredVelocities[] = {glm::vec3(0.f), glm::vec3(5.f, -5.f, 0.f), glm::vec3(0.f), glm::vec3(-5.f, -5.f, 0.f)};
+            glm::vec3 desiredVelocity = desiredVelocities[frame / 120 % 4];
+            for (size_t j = 0; j < entityCount; j += 2) {
+              store.desiredVelocity(handles[j], desiredVelocity);
+            }
+            store.update(1.f / 60.f, collide ? &groundMap : nullptr, threaded ? &threadPool : nullptr);
+          }
+        });
+        size_t entityFrames = entityCount * framesPerIteration;
+        std::cout << "{\"benchmark\":\"entity_store_update\""
+          << ",\"entities\":" << entityCount
+          << ",\"collide\":" << (collide ? "true" : "false")
+          << ",\"threads\":" << (threaded ? threadPool.threadCount() : 1)
+          << ",\"frames\":" << framesPerIteration
+          << ",\"median_ns\":" << (uint64_t) m.medianNs
+          << ",\"ns_per_entity_frame\":" << m.medianNs / entityFrames
+          << ",\"bytes_allocated\":" << m.bytesAllocated
+          << ",\"allocations\":" << m.allocations << "}" << std::endl;
+      }
+    }
+  }
+
+  // Bursts of block break debris over the collision ground, simulated until all of it has died down, as the game does every frame
+  for (size_t breakCount : {(size_t) 16, (size_t) 160, (size_t) 1000}) {
+    size_t particleCount = breakCount * ParticleSystem::BREAK_PARTICLES_PER_SIDE * ParticleSystem::BREAK_PARTICLES_PER_SIDE * ParticleSystem::BREAK_PARTICLES_PER_SIDE;
+    std::string name = "particles/" + std::to_string(particleCount);
+    if (!selected(options, name)) continue;
+
+    ParticleSystem particles(blockRegistry);
+    std::vector<ParticleInstance> instances;
+    instances.reserve(ParticleSystem::MAX_PARTICLES);
+    const size_t framesPerIteration = 90; // longer than the longest lifetime
+    Measurement m = measure(options.iterations, [&] () {
+      for (size_t i = 0; i < breakCount; i++) {
+        glm::ivec3 position = basePosition + glm::ivec3(i % size.x, size.y / 2, i / size.x % size.z);
+        particles.emitBlockBreak(position, STONE);
+      }
+      for (size_t frame = 0; frame < framesPerIteration; frame++) {
+        particles.update(1.f / 60.f, &groundMap);
+        particles.fillInstances(instances);
+      }
+    });
+    std::cout << "{\"benchmark\":\"particles\""
+      << ",\"particles\":" << particleCount
+      << ",\"frames\":" << framesPerIteration
+      << ",\"median_ns\":" << (uint64_t) m.medianNs
+      << ",\"ns_per_particle_frame\":" << m.medianNs / (particleCount * framesPerIteration)
+      << ",\"bytes_allocated\":" << m.bytesAllocated
+      << ",\"allocations\":" << m.allocations << "}" << std::endl;
+  }
+
+  // At a constant density, about 1 entity per 4 blocks of ground, so that the neighbourhood of each query is the same at every count
+  for (size_t entityCount : {(size_t) 1000, (size_t) 10000, (size_t) 100000}) {
+    std::string name = "entity_proximity/" + std::to_string(entityCount);
+    if (!selected(options, name)) continue;
+
+    EntityStore store;
+    store.reserve(entityCount);
+    float side = glm::sqrt(4.f * entityCount);
+    for (size_t i = 0; i < entityCount; i++) {
+      auto random = [i] (int component) { return (hash((int) i, component, 0, 7) & 0xffff) / 65536.f; };
+      store.create(glm::vec3(random(0) * side, random(1) * 4.f, random(2) * side));
+    }
+
+    EntitySpatialHash spatialHash;
+    Measurement rebuild = measure(options.iterations, [&] () {
+      spatialHash.rebuild(store);
+    });
+
+    // Everything within 2 blocks of some of the entities, as pushing and pickup checks would ask
+    const size_t queryCount = 10000;
+    std::vector<uint32_t> nearby;
+    size_t found = 0;
+    Measurement m = measure(options.iterations, [&] () {
+      found = 0;
+      for (size_t i = 0; i < queryCount; i++) {
+        nearby.clear();
+        spatialHash.queryRadius(store.positions().get(i * 7919 % entityCount), 2.f, nearby);
+        found += nearby.size();
+      }
+    });
+    std::cout << "{\"benchmark\":\"entity_proximity\""
+      << ",\"entities\":" << entityCount
+      << ",\"rebuild_ns\":" << (uint64_t) rebuild.medianNs
+      << ",\"rebuild_allocations\":" << rebuild.allocations
+      << ",\"queries\":" << queryCount
+      << ",\"found_per_query\":" << (double) found / queryCount
+      << ",\"median_ns\":" << (uint64_t) m.medianNs
+      << ",\"ns_per_query\":" << m.medianNs / queryCount
+      << ",\"bytes_allocated\":" << m.bytesAllocated
+      << ",\"allocations\":" << m.allocations << "}" << std::endl;
+  }
+}
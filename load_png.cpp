@@ -2,8 +2,35 @@
 #include <string>
 #include <sstream>
 #include <cstring>
+#include <cstdlib>
+#include <cstddef>
 #include <png.h>
 #include "load_png.hpp"
+#include "MemoryTracking.hpp"
+
+namespace {
+
+// libpng's free gives no size, so it is kept in front of every block, padded to keep the block aligned
+const size_t SIZE_HEADER = alignof(std::max_align_t);
+
+png_voidp tracked_malloc(png_structp, png_alloc_size_t size) {
+  uint8_t* block = static_cast<uint8_t*>(malloc(SIZE_HEADER + size));
+  if (!block) return NULL;
+  memcpy(block, &size, sizeof(size));
+  MemoryTracking::allocated(MemoryTag::PNG_DECODE, size);
+  return block + SIZE_HEADER;
+}
+
+void tracked_free(png_structp, png_voidp ptr) {
+  if (!ptr) return;
+  uint8_t* block = static_cast<uint8_t*>(ptr) - SIZE_HEADER;
+  png_alloc_size_t size;
+  memcpy(&size, block, sizeof(size));
+  MemoryTracking::freed(MemoryTag::PNG_DECODE, size);
+  free(block);
+}
+
+}
 
 void load_png(const char* filename, GLenum expected_format, size_t expected_width, size_t expected_height, uint8_t* data) {
   // Should minimize the amount of non trivially destructable types, because setjmp/longjmp is involved
@@ -43,8 +70,8 @@ void load_png(const char* filename, GLenum expected_format, size_t expected_widt
     throw std::runtime_error(msg.str());
   }
 
-  // Initialize libpng
-  png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  // Initialize libpng, with its working memory accounted to PNG_DECODE
+  png_structp png_ptr = png_create_read_struct_2(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL, NULL, tracked_malloc, tracked_free);
   if (!png_ptr) {
     fclose(file);
     delete[] row_pointers;
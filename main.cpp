@@ -1,7 +1,15 @@
 #include <iostream>
+#include <fstream>
 #include <vector>
 #include <memory>
 #include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <filesystem>
+#include <array>
+#include <algorithm>
+#include <chrono>
+#include <thread>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
@@ -13,24 +21,160 @@
 #include "StreamingTextures.hpp"
 #include "Block.hpp"
 #include "BlockType.hpp"
+#include "BlockRegistry.hpp"
+#include "BlockBehaviours.hpp"
+#include "BlockTickScheduler.hpp"
 #include "BlocksMap.hpp"
 #include "BlocksMesh.hpp"
+#include "BlockFacesMesh.hpp"
+#include "LightMap.hpp"
 #include "VAO.hpp"
 #include "GLBuffer.hpp"
+#include "BufferTexture.hpp"
 #include "Entity.hpp"
+#include "Profiler.hpp"
+#include "Metrics.hpp"
+#include "Framebuffer.hpp"
+#include "RenderBenchmark.hpp"
+#include "InputRecording.hpp"
+#include "Raycast.hpp"
+#include "ParticleSystem.hpp"
+#include "Simulation.hpp"
+#include "ThreadPool.hpp"
+#include "Connection.hpp"
+#include "Protocol.hpp"
+#include "WorldStorage.hpp"
+#include "MeshCache.hpp"
 #include "build_config.h"
 
 float lastFrameTime;
 float deltaFrameTime;
 glm::vec2 lastMousePos;
+glm::vec2 pendingCursorDelta; // accumulated by the cursor callback until the next frame
+bool pendingBlockBreak = false; // set by the mouse button callback until the next frame
+
+EntityStore entities;
+Entity player(entities, "player");
+const float BLOCK_REACH = 8.f; // how far away the player can break blocks
+const float AMBIENT_PARTICLE_RADIUS = 12.f; // falling leaves appear within this many blocks of the player
+Profiler profiler;
+
+// Sample the input devices for the current frame
+FrameInput pollInput(GLFWwindow* window) {
+  FrameInput input;
+  input.deltaTime = deltaFrameTime;
+  input.keys = 0;
+  if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) input.keys |= INPUT_KEY_FORWARD;
+  if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) input.keys |= INPUT_KEY_BACKWARD;
+  if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) input.keys |= INPUT_KEY_LEFT;
+  if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) input.keys |= INPUT_KEY_RIGHT;
+  if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS) input.keys |= INPUT_KEY_UP;
+  if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS) input.keys |= INPUT_KEY_DOWN;
+  if (pendingBlockBreak) input.keys |= INPUT_KEY_BREAK_BLOCK;
+  input.cursorDelta = pendingCursorDelta;
+  pendingCursorDelta = glm::vec2(0.f);
+  pendingBlockBreak = false;
+  return input;
+}
+
+// Turn and move the player according to the input of a frame
+void applyInput(const FrameInput& input, Simulation& simulation) {
+  glm::vec2 playerRotation = player.rotation();
+  playerRotation.y = playerRotation.y + input.cursorDelta.x * 0.001f;
+  playerRotation.x = glm::clamp(playerRotation.x - input.cursorDelta.y * 0.001f, -glm::pi<float>() / 2 + 0.001f, glm::pi<float>() / 2 - 0.001f);
+  player.rotation(playerRotation);
+
+  glm::vec3 desiredVelocity(0.f);
+  if (input.keys & INPUT_KEY_FORWARD)
+    desiredVelocity += player.direction() * 5.f;
+  if (input.keys & INPUT_KEY_BACKWARD)
+    desiredVelocity -= player.direction() * 5.f;
+  if (input.keys & INPUT_KEY_LEFT)
+    desiredVelocity -= glm::normalize(glm::cross(player.direction(), glm::vec3(0.f, 1.f, 0.f))) * 5.f;
+  if (input.keys & INPUT_KEY_RIGHT)
+    desiredVelocity += glm::normalize(glm::cross(player.direction(), glm::vec3(0.f, 1.f, 0.f))) * 5.f;
+  if (input.keys & INPUT_KEY_UP)
+    desiredVelocity += glm::vec3(0.f, 1.f, 0.f) * 5.f;
+  if (input.keys & INPUT_KEY_DOWN)
+    desiredVelocity -= glm::vec3(0.f, 1.f, 0.f) * 5.f;
+  simulation.desiredVelocity(player.handle(), desiredVelocity);
+}
+
+// Wait for the description of the world, which the server sends first
+WorldInfoMessage receiveWorldInfo(Connection& connection) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (true) {
+    if (std::optional<Message> message = connection.receive()) {
+      if (message->type != MessageType::WORLD_INFO) {
+        throw ProtocolException("Expected the world info first");
+      }
+      WorldInfoMessage worldInfo;
+      decode(message->payload, worldInfo);
+      return worldInfo;
+    }
+    if (connection.closed()) throw NetworkException("The server closed the connection");
+    if (std::chrono::steady_clock::now() > deadline) throw NetworkException("Timed out waiting for the server");
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+}
 
-Entity player("player");
+// Order the sections of a mesh front to back, so that nearer sections hide the fragments of farther ones from shading
+template <typename S>
+void sortSectionsFrontToBack(const std::vector<S>& sections, const glm::vec3& eyePosition, std::vector<const S*>& sorted) {
+  sorted.clear();
+  for (const S& section : sections) {
+    sorted.push_back(&section);
+  }
+  std::sort(sorted.begin(), sorted.end(), [&eyePosition] (const S* a, const S* b) {
+    return glm::dot(a->center - eyePosition, a->center - eyePosition) < glm::dot(b->center - eyePosition, b->center - eyePosition);
+  });
+}
 
 int main(int argc, char* argv[]) {
-  (void) argc;
-  (void) argv;
+  bool benchmarkMode = false;
+  size_t benchmarkFrames = 1000;
+  const char* recordFilename = nullptr;
+  const char* replayFilename = nullptr;
+  float replayTimestep = 0.f; // 0 to use the recorded frame times
+  const char* traceFilename = nullptr;
+  bool faceInstancing = false;
+  const char* connectAddress = nullptr;
+  const char* metricsDestination = nullptr;
+  const char* worldDirectory = nullptr;
+  std::string meshCacheFilename;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--benchmark") == 0) {
+      benchmarkMode = true;
+    } else if (strcmp(argv[i], "--benchmark-frames") == 0 && i + 1 < argc) {
+      benchmarkFrames = std::max(1, atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+      recordFilename = argv[++i];
+    } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+      replayFilename = argv[++i];
+    } else if (strcmp(argv[i], "--replay-timestep") == 0 && i + 1 < argc) {
+      replayTimestep = std::max(0.f, (float) atof(argv[++i]));
+    } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+      traceFilename = argv[++i];
+    } else if (strcmp(argv[i], "--face-instancing") == 0) {
+      faceInstancing = true;
+    } else if (strcmp(argv[i], "--connect") == 0 && i + 1 < argc) {
+      connectAddress = argv[++i];
+    } else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+      metricsDestination = argv[++i];
+    } else if (strcmp(argv[i], "--world") == 0 && i + 1 < argc) {
+      worldDirectory = argv[++i];
+    } else if (strcmp(argv[i], "--mesh-cache") == 0 && i + 1 < argc) {
+      meshCacheFilename = argv[++i];
+    } else {
+      std::cerr << "Usage: " << argv[0] << " [--benchmark [--benchmark-frames N]] [--record FILE | --replay FILE [--replay-timestep SECONDS]] [--trace FILE] [--face-instancing] [--connect unix:PATH | --connect HOST:PORT | --world DIR] [--metrics unix:PATH | --metrics FILE] [--mesh-cache FILE]" << std::endl;
+      exit(-1);
+    }
+  }
 
   try {
+    std::optional<MetricsExporter> metricsExporter;
+    if (metricsDestination) metricsExporter.emplace(metricsDestination);
+
     glfwSetErrorCallback([] (int error, const char* description) {
       std::cerr << "GLFW Error: " << description << std::endl;
     });
@@ -40,6 +184,10 @@ int main(int argc, char* argv[]) {
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
     glfwWindowHint(GLFW_SCALE_TO_MONITOR, GLFW_TRUE);
+    if (benchmarkMode) {
+      // Rendering goes to an offscreen framebuffer, so that the benchmark runs without a display surface of a fixed size
+      glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    }
 
     GLFWwindow* window = glfwCreateWindow(640, 480, "Test", NULL, NULL);
     if (!window) throw ApplicationException("Cannot create window");
@@ -48,7 +196,7 @@ int main(int argc, char* argv[]) {
     GLenum glewErr = glewInit();
     if (glewErr != GLEW_OK) throw ApplicationException((const char*) glewGetErrorString(glewErr));
 
-    if (!glewIsSupported("GL_ARB_texture_storage")) {
+    if (!glewIsSupported("GL_ARB_texture_storage GL_ARB_instanced_arrays")) {
       throw ApplicationException("Necessary OpenGL extensions not supported");
     }
 
@@ -84,28 +232,42 @@ int main(int argc, char* argv[]) {
             glfwSetWindowShouldClose(window, GLFW_TRUE);
           }
           break;
+        case GLFW_KEY_F2:
+          if (action == GLFW_PRESS) {
+            profiler.printPercentiles(std::cout);
+          }
+          break;
+        case GLFW_KEY_F3:
+          if (action == GLFW_PRESS) {
+            std::ofstream traceFile("frame_trace.json");
+            profiler.writeChromeTrace(traceFile);
+            std::cout << "Frame trace written to frame_trace.json" << std::endl;
+          }
+          break;
         default:
           ;
       }
     });
 
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    if (!benchmarkMode) glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     glfwSetCursorPosCallback(window, [] (GLFWwindow* window, double xpos, double ypos) {
       glm::vec2 currentMousePos((float) xpos, (float) ypos);
-      glm::vec2 deltaMousePos = currentMousePos - lastMousePos;
+      pendingCursorDelta += currentMousePos - lastMousePos;
       lastMousePos = currentMousePos;
-
-      glm::vec2 playerRotation = player.rotation();
-      playerRotation.y = playerRotation.y + deltaMousePos.x * 0.001f;
-      playerRotation.x = glm::clamp(playerRotation.x - deltaMousePos.y * 0.001f, -glm::pi<float>() / 2 + 0.001f, glm::pi<float>() / 2 - 0.001f);
-      player.rotation(playerRotation);
+    });
+    glfwSetMouseButtonCallback(window, [] (GLFWwindow* window, int button, int action, int mods) {
+      if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
+        pendingBlockBreak = true;
+      }
     });
 
-    glfwSwapInterval(1);
+    glfwSwapInterval(benchmarkMode ? 0 : 1);
     glEnable(GL_CULL_FACE);
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LEQUAL);
 
+    profiler.enableGpuTiming();
+
     // Define block types, load block textures
 
     StreamingTextures blockTextures(16, 16, std::vector<GLenum>{GL_RGBA8}, [] (size_t i, GLuint textureId) {
@@ -113,99 +275,113 @@ int main(int argc, char* argv[]) {
       glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     });
 
-    std::vector<std::unique_ptr<BlockType>> blockTypes;
-
-    {
-      auto grassBlockTextureTop = blockTextures.allocateFromFiles(std::vector<std::string>{APP_RESOURCE_PATH "/textures/grass_block/top.png"});
-      auto grassBlockTextureSide = blockTextures.allocateFromFiles(std::vector<std::string>{APP_RESOURCE_PATH "/textures/grass_block/side.png"});
-      auto grassBlockTextureBottom = blockTextures.allocateFromFiles(std::vector<std::string>{APP_RESOURCE_PATH "/textures/grass_block/bottom.png"});
-      blockTypes.push_back(std::make_unique<BlockType>("grass_block", BlockTypeAttributes{
-        .transparent = false,
-      }, std::array<std::shared_ptr<StreamingTexturesPart>, 6>{
-        grassBlockTextureSide,
-        grassBlockTextureSide,
-        grassBlockTextureTop,
-        grassBlockTextureBottom,
-        grassBlockTextureSide,
-        grassBlockTextureSide,
-      }));
-
-      auto stoneTexture = blockTextures.allocateFromFiles(std::vector<std::string>{APP_RESOURCE_PATH "/textures/stone/all.png"});
-      blockTypes.push_back(std::make_unique<BlockType>("stone", BlockTypeAttributes{
-        .transparent = false,
-      }, std::array<std::shared_ptr<StreamingTexturesPart>, 6>{
-        stoneTexture,
-        stoneTexture,
-        stoneTexture,
-        stoneTexture,
-        stoneTexture,
-        stoneTexture,
-      }));
-
-      auto treeTrunkCrossTexture = blockTextures.allocateFromFiles(std::vector<std::string>{APP_RESOURCE_PATH "/textures/tree_trunk/cross.png"});
-      auto treeTrunkSideTexture = blockTextures.allocateFromFiles(std::vector<std::string>{APP_RESOURCE_PATH "/textures/tree_trunk/side.png"});
-      blockTypes.push_back(std::make_unique<BlockType>("tree_trunk", BlockTypeAttributes{
-        .transparent = false,
-      }, std::array<std::shared_ptr<StreamingTexturesPart>, 6>{
-        treeTrunkSideTexture,
-        treeTrunkSideTexture,
-        treeTrunkCrossTexture,
-        treeTrunkCrossTexture,
-        treeTrunkSideTexture,
-        treeTrunkSideTexture,
-      }));
-
-      auto treeLeavesTexture = blockTextures.allocateFromFiles(std::vector<std::string>{APP_RESOURCE_PATH "/textures/tree_leaves/all.png"});
-      blockTypes.push_back(std::make_unique<BlockType>("tree_leaves", BlockTypeAttributes{
-        .transparent = true,
-      }, std::array<std::shared_ptr<StreamingTexturesPart>, 6>{
-        treeLeavesTexture,
-        treeLeavesTexture,
-        treeLeavesTexture,
-        treeLeavesTexture,
-        treeLeavesTexture,
-        treeLeavesTexture,
-      }));
-    }
+    BlockRegistry blockRegistry;
+    blockRegistry.loadFromFile(APP_RESOURCE_PATH "/blocks.txt", blockTextures, APP_RESOURCE_PATH "/textures");
+    addBlockBehaviours(blockRegistry);
 
     // Construct block mesh
 
-    BlocksMap blocksMap(glm::ivec3(-7, 0, -7), glm::ivec3(16, 8, 16));
+    // Connected to a server, the map starts out empty and is filled in by the sections it streams
+    std::optional<Connection> serverConnection;
+    WorldInfoMessage worldInfo{glm::ivec3(-7, 0, -7), glm::ivec3(16, 8, 16), {}};
+    std::vector<std::optional<Block>> blocksByCell; // the server's block cells as local blocks
+    if (connectAddress) {
+      serverConnection.emplace(Connection::connect(connectAddress));
+      worldInfo = receiveWorldInfo(*serverConnection);
+      blocksByCell.emplace_back();
+      for (const std::string& blockType : worldInfo.blockTypes) {
+        blocksByCell.emplace_back(Block(blockRegistry.type(blockRegistry.id(blockType))));
+      }
+    }
 
-    for (int i = 0; i < 100; i++) {
-      blocksMap[glm::ivec3(-5 + i % 10, 0, -5 + i / 10)].emplace(Block(*blockTypes[1]));
-      blocksMap[glm::ivec3(-5 + i % 10, 1, -5 + i / 10)].emplace(Block(*blockTypes[0]));
+    // A local world saved with --world keeps the bounds it was created with, a server's world is saved by the server
+    std::optional<BlocksRegion> savedBounds;
+    if (worldDirectory && !serverConnection) savedBounds = WorldStorage::savedBounds(worldDirectory);
+    if (savedBounds) {
+      worldInfo.basePosition = savedBounds->min;
+      worldInfo.size = savedBounds->max - savedBounds->min;
     }
-    for (int i = 0; i < 3; i++) {
-      blocksMap[glm::ivec3(2, 2 + i, 2)].emplace(Block(*blockTypes[2]));
+
+    BlocksMap blocksMap(blockRegistry, worldInfo.basePosition, worldInfo.size);
+    if (!serverConnection && !savedBounds) {
+      Block grassBlock(blockRegistry.type(blockRegistry.id("grass_block")));
+      Block stone(blockRegistry.type(blockRegistry.id("stone")));
+      Block treeTrunk(blockRegistry.type(blockRegistry.id("tree_trunk")));
+      Block treeLeaves(blockRegistry.type(blockRegistry.id("tree_leaves")));
+
+      blocksMap.fill(BlocksRegion{glm::ivec3(-5, 0, -5), glm::ivec3(5, 1, 5)}, stone);
+      blocksMap.fill(BlocksRegion{glm::ivec3(-5, 1, -5), glm::ivec3(5, 2, 5)}, grassBlock);
+      blocksMap.fill(BlocksRegion{glm::ivec3(2, 2, 2), glm::ivec3(3, 5, 3)}, treeTrunk);
+      blocksMap.set(glm::ivec3(2, 5, 2), treeLeaves);
+      blocksMap.set(glm::ivec3(1, 4, 2), treeLeaves);
+      blocksMap.set(glm::ivec3(3, 4, 2), treeLeaves);
+      blocksMap.set(glm::ivec3(2, 4, 1), treeLeaves);
+      blocksMap.set(glm::ivec3(2, 4, 3), treeLeaves);
     }
-    blocksMap[glm::ivec3(2, 5, 2)].emplace(Block(*blockTypes[3]));
-    blocksMap[glm::ivec3(1, 4, 2)].emplace(Block(*blockTypes[3]));
-    blocksMap[glm::ivec3(3, 4, 2)].emplace(Block(*blockTypes[3]));
-    blocksMap[glm::ivec3(2, 4, 1)].emplace(Block(*blockTypes[3]));
-    blocksMap[glm::ivec3(2, 4, 3)].emplace(Block(*blockTypes[3]));
 
-    auto blocksMesh = BlocksMesh::buildFromBlocksMap(blocksMap);
+    std::optional<WorldStorage> worldStorage;
+    if (worldDirectory && !serverConnection) worldStorage.emplace(worldDirectory, blocksMap);
+
+    LightMap lightMap(blocksMap);
+    BlockTickScheduler blockTicks(blocksMap);
+
+    // With face instancing, the blocks are drawn from face records in a buffer texture instead of the vertex and index buffers, and the VAO has no attributes
+    BlocksMesh blocksMesh;
+    BlockFacesMesh blockFacesMesh;
 
     VAO blocksVao;
     blocksVao.bind();
 
     GLBuffer blocksVbo(GL_ARRAY_BUFFER);
-    blocksVbo.bind();
-    blocksVbo.sendData(blocksMesh.vertices, GL_STATIC_DRAW);
     GLBuffer blocksIbo(GL_ELEMENT_ARRAY_BUFFER);
-    blocksIbo.bind();
-    blocksIbo.sendData(blocksMesh.vertexIndices, GL_STATIC_DRAW);
-
+    BufferTexture blockFacesTexture(GL_R32UI);
+
+    // A saved world keeps the meshes of its sections next to it, so that loading it again does not mesh what did not change
+    if (meshCacheFilename.empty() && worldDirectory && !serverConnection) meshCacheFilename = (std::filesystem::path(worldDirectory) / "meshes").string();
+    std::optional<MeshCache> meshCache;
+    if (!meshCacheFilename.empty()) meshCache.emplace(meshCacheFilename);
+
+    auto buildBlocksMesh = [&] () {
+      if (faceInstancing) {
+        blockFacesMesh.rebuild(blocksMap, &lightMap);
+        blockFacesTexture.sendData(blockFacesMesh.faces, GL_STATIC_DRAW);
+      } else {
+        blocksMesh.rebuild(blocksMap, &lightMap, meshCache ? &*meshCache : nullptr);
+        blocksVao.bind();
+        blocksVbo.bind();
+        blocksVbo.sendData(blocksMesh.vertices, GL_STATIC_DRAW);
+        blocksIbo.bind();
+        blocksIbo.sendData(blocksMesh.vertexIndices, GL_STATIC_DRAW);
+      }
+    };
+    buildBlocksMesh();
+
+    // The opaque variant has no discard so that early depth testing stays enabled, only cutout geometry pays for alpha testing
+    // Attribute locations are fixed, so that both variants can use the same VAO
+    const std::array<const char*, 5> blocksAttribNames = {"vPos", "vNorm", "vTexCoord", "vTexPartLocation", "vLight"};
+    auto makeBlocksShaderProgram = [&blocksAttribNames, faceInstancing] (ShaderProgram& program, std::vector<std::string> defines) {
+      if (faceInstancing) defines.push_back("FACE_RECORDS");
+      program.loadAndAttachShader(GL_VERTEX_SHADER, "shaders/blocks_vert.glsl", defines);
+      program.loadAndAttachShader(GL_FRAGMENT_SHADER, "shaders/blocks_frag.glsl", defines);
+      for (size_t i = 0; i < blocksAttribNames.size(); i++) {
+        program.bindAttribLocation(i, blocksAttribNames[i]);
+      }
+      program.link();
+    };
     ShaderProgram blocksShaderProgram;
-    blocksShaderProgram.loadAndAttachShader(GL_VERTEX_SHADER, "shaders/blocks_vert.glsl");
-    blocksShaderProgram.loadAndAttachShader(GL_FRAGMENT_SHADER, "shaders/blocks_frag.glsl");
-    blocksShaderProgram.link();
+    makeBlocksShaderProgram(blocksShaderProgram, {});
+    ShaderProgram blocksCutoutShaderProgram;
+    makeBlocksShaderProgram(blocksCutoutShaderProgram, {"ALPHA_TEST"});
 
-    blocksVao.enableAndSetAttribPointer(blocksShaderProgram.getAttribLocation("vPos"), 3, GL_FLOAT, GL_FALSE, sizeof(BlockVertex), offsetof(BlockVertex, x));
-    blocksVao.enableAndSetAttribPointer(blocksShaderProgram.getAttribLocation("vNorm"), 3, GL_FLOAT, GL_FALSE, sizeof(BlockVertex), offsetof(BlockVertex, nx));
-    blocksVao.enableAndSetAttribPointer(blocksShaderProgram.getAttribLocation("vTexCoord"), 2, GL_FLOAT, GL_FALSE, sizeof(BlockVertex), offsetof(BlockVertex, u));
-    blocksVao.enableAndSetAttribIPointer(blocksShaderProgram.getAttribLocation("vTexPartLocation"), 2, GL_UNSIGNED_INT, sizeof(BlockVertex), offsetof(BlockVertex, tx));
+    if (!faceInstancing) {
+      blocksVao.bind();
+      blocksVbo.bind();
+      blocksVao.enableAndSetAttribPointer(blocksShaderProgram.getAttribLocation("vPos"), 3, GL_FLOAT, GL_FALSE, sizeof(BlockVertex), offsetof(BlockVertex, x));
+      blocksVao.enableAndSetAttribPointer(blocksShaderProgram.getAttribLocation("vNorm"), 3, GL_FLOAT, GL_FALSE, sizeof(BlockVertex), offsetof(BlockVertex, nx));
+      blocksVao.enableAndSetAttribPointer(blocksShaderProgram.getAttribLocation("vTexCoord"), 2, GL_FLOAT, GL_FALSE, sizeof(BlockVertex), offsetof(BlockVertex, u));
+      blocksVao.enableAndSetAttribIPointer(blocksShaderProgram.getAttribLocation("vTexPartLocation"), 2, GL_UNSIGNED_INT, sizeof(BlockVertex), offsetof(BlockVertex, tx));
+      blocksVao.enableAndSetAttribPointer(blocksShaderProgram.getAttribLocation("vLight"), 2, GL_FLOAT, GL_FALSE, sizeof(BlockVertex), offsetof(BlockVertex, skyLight));
+    }
 
     // Make skybox
 
@@ -242,13 +418,86 @@ int main(int argc, char* argv[]) {
 
     skyboxVao.enableAndSetAttribPointer(skyboxShaderProgram.getAttribLocation("vPos"), 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), 0);
 
-    player.position = glm::vec3(0.f, 3.f, 0.f);
+    // Make particles, drawn as one instanced quad per particle with the instances streamed every frame
+
+    ParticleSystem particles(blockRegistry);
+    std::vector<ParticleInstance> particleInstances;
+    particleInstances.reserve(ParticleSystem::MAX_PARTICLES);
+
+    VAO particlesVao;
+    particlesVao.bind();
+
+    GLBuffer particlesVbo(GL_ARRAY_BUFFER);
+    particlesVbo.bind();
+    particlesVbo.sendData(ParticleSystem::MAX_PARTICLES * sizeof(ParticleInstance), GL_STREAM_DRAW);
+
+    ShaderProgram particlesShaderProgram;
+    particlesShaderProgram.loadAndAttachShader(GL_VERTEX_SHADER, "shaders/particles_vert.glsl");
+    particlesShaderProgram.loadAndAttachShader(GL_FRAGMENT_SHADER, "shaders/particles_frag.glsl");
+    particlesShaderProgram.link();
+
+    GLint particleCenterLocation = particlesShaderProgram.getAttribLocation("vCenter");
+    GLint particleSizeLocation = particlesShaderProgram.getAttribLocation("vSize");
+    GLint particleTextureLocation = particlesShaderProgram.getAttribLocation("vTexture");
+    particlesVao.enableAndSetAttribPointer(particleCenterLocation, 3, GL_FLOAT, GL_FALSE, sizeof(ParticleInstance), offsetof(ParticleInstance, x));
+    particlesVao.enableAndSetAttribPointer(particleSizeLocation, 1, GL_FLOAT, GL_FALSE, sizeof(ParticleInstance), offsetof(ParticleInstance, size));
+    particlesVao.enableAndSetAttribIPointer(particleTextureLocation, 1, GL_UNSIGNED_INT, sizeof(ParticleInstance), offsetof(ParticleInstance, texture));
+    for (GLint location : {particleCenterLocation, particleSizeLocation, particleTextureLocation}) {
+      particlesVao.setAttribDivisor(location, 1);
+    }
+
+    // Above the ground of whatever world the server has
+    player.position(serverConnection ? glm::vec3(0.f, worldInfo.basePosition.y + worldInfo.size.y - 2.f, 0.f) : glm::vec3(0.f, 3.f, 0.f));
+    player.halfExtents(glm::vec3(0.3f, 0.9f, 0.3f));
+    player.stepHeight(0.6f);
     player.direction(glm::vec3(0.f, 0.f, 1.f));
 
-    while (!glfwWindowShouldClose(window)) {
+    ThreadPool threadPool;
+    Simulation simulation(entities, blocksMap, Simulation::DEFAULT_TICK_LENGTH, &threadPool);
+    // The server runs the block ticks of its world
+    if (!serverConnection) simulation.blockTicks(&blockTicks);
+
+    std::optional<InputRecorder> inputRecorder;
+    std::optional<InputReplayer> inputReplayer;
+    if (replayFilename) {
+      inputReplayer.emplace(replayFilename);
+    } else if (recordFilename) {
+      inputRecorder.emplace(recordFilename);
+    }
+
+    std::optional<Framebuffer> benchmarkFramebuffer;
+    std::optional<RenderBenchmark> benchmark;
+    if (benchmarkMode) {
+      benchmarkFramebuffer.emplace(1280, 720);
+      benchmarkFramebuffer->bind();
+      glViewport(0, 0, benchmarkFramebuffer->width(), benchmarkFramebuffer->height());
+
+      glm::vec3 mapCenter = glm::vec3(blocksMap.basePosition) + glm::vec3(blocksMap.size) / 2.f;
+      float mapRadius = glm::max(blocksMap.size.x, blocksMap.size.z);
+      benchmark.emplace(benchmarkFrames, mapCenter, mapRadius, (float) blocksMap.size.y);
+    }
+
+    // Replays step the simulation along with the recorded frames so that they are repeatable, the benchmark moves the camera itself
+    if (!inputReplayer && !benchmark) {
+      simulation.start();
+    }
+
+    // Reused every frame
+    std::vector<const BlocksMesh::Section*> sortedSections;
+    std::vector<const BlockFacesMesh::Section*> sortedFaceSections;
+    std::vector<glm::ivec3> tickChangedPositions;
+
+    while (!glfwWindowShouldClose(window) && !(benchmark && benchmark->finished())) {
+      profiler.beginFrame();
+
       float ratio;
       int width, height;
-      glfwGetFramebufferSize(window, &width, &height);
+      if (benchmarkFramebuffer) {
+        width = benchmarkFramebuffer->width();
+        height = benchmarkFramebuffer->height();
+      } else {
+        glfwGetFramebufferSize(window, &width, &height);
+      }
       ratio = width / (float) height;
 
       float currentFrameTime = glfwGetTime();
@@ -256,50 +505,249 @@ int main(int argc, char* argv[]) {
       lastFrameTime = currentFrameTime;
 
       // Game logic
-      if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-        player.desiredVelocity += player.direction() * 5.f;
-      if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-        player.desiredVelocity -= player.direction() * 5.f;
-      if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-        player.desiredVelocity -= glm::normalize(glm::cross(player.direction(), glm::vec3(0.f, 1.f, 0.f))) * 5.f;
-      if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-        player.desiredVelocity += glm::normalize(glm::cross(player.direction(), glm::vec3(0.f, 1.f, 0.f))) * 5.f;
-      if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS)
-        player.desiredVelocity += glm::vec3(0.f, 1.f, 0.f) * 5.f;
-      if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS)
-        player.desiredVelocity -= glm::vec3(0.f, 1.f, 0.f) * 5.f;
-      player.processFrame(deltaFrameTime);
-
-      // Rendering
-      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+      if (benchmark) {
+        benchmark->beginFrame(player);
+      } else {
+        Profiler::Scope scope(profiler, "Input");
+        FrameInput input;
+        if (inputReplayer) {
+          // The recorded input replaces the devices, so that the player follows the recorded trajectory exactly
+          std::optional<FrameInput> replayedInput = inputReplayer->next();
+          if (replayedInput) {
+            input = *replayedInput;
+            if (replayTimestep > 0.f) input.deltaTime = replayTimestep;
+          } else {
+            input = FrameInput{0.f, 0, glm::vec2(0.f)};
+            glfwSetWindowShouldClose(window, GLFW_TRUE);
+          }
+          pendingCursorDelta = glm::vec2(0.f);
+          pendingBlockBreak = false;
+        } else {
+          input = pollInput(window);
+          if (inputRecorder) inputRecorder->record(input);
+        }
+        deltaFrameTime = input.deltaTime;
+        applyInput(input, simulation);
+
+        // Break the block under the crosshair
+        if (input.keys & INPUT_KEY_BREAK_BLOCK) {
+          std::unique_lock worldLock(simulation.worldMutex());
+          std::optional<RaycastHit> hit = raycast(blocksMap, Ray{simulation.interpolatedPosition(player.handle()), player.direction(), BLOCK_REACH});
+          if (hit && serverConnection) {
+            // Comes back as a delta
+            serverConnection->send(MessageType::BREAK_BLOCK, encode(BreakBlockMessage{hit->position}));
+          } else if (hit) {
+            particles.emitBlockBreak(hit->position, blocksMap[hit->position]->id());
+            blocksMap.set(hit->position, std::nullopt);
+            lightMap.blockChanged(hit->position);
+            blockTicks.blockChanged(hit->position);
+            buildBlocksMesh();
+          }
+        }
+      }
+      if (!benchmark && !simulation.running()) {
+        Profiler::Scope scope(profiler, "Simulation::advance");
+        simulation.advance(deltaFrameTime);
+      }
+      {
+        // Relight and remesh after the blocks changed by the simulation
+        std::unique_lock worldLock(simulation.worldMutex());
+        blockTicks.takeChangedPositions(tickChangedPositions);
+        for (const glm::ivec3& position : tickChangedPositions) {
+          lightMap.blockChanged(position);
+        }
+        if (!tickChangedPositions.empty()) {
+          buildBlocksMesh();
+          tickChangedPositions.clear();
+        }
+      }
+      if (serverConnection) {
+        Profiler::Scope scope(profiler, "Network");
+        std::unique_lock worldLock(simulation.worldMutex());
+        // Sections received in the same frame are relit together
+        std::optional<BlocksRegion> changedRegion;
+        auto regionChanged = [&changedRegion] (const BlocksRegion& region) {
+          if (region.empty()) return;
+          changedRegion = changedRegion ? BlocksRegion{glm::min(changedRegion->min, region.min), glm::max(changedRegion->max, region.max)} : region;
+        };
+        bool deltasApplied = false;
+        while (std::optional<Message> message = serverConnection->receive()) {
+          if (message->type == MessageType::SECTION) {
+            SectionMessage section;
+            decode(message->payload, section);
+            regionChanged(applySection(blocksMap, section, blocksByCell));
+          } else if (message->type == MessageType::SECTION_UNLOAD) {
+            SectionUnloadMessage unload;
+            decode(message->payload, unload);
+            regionChanged(blocksMap.fill(unload.region, std::nullopt));
+          } else if (message->type == MessageType::BLOCK_DELTAS) {
+            BlockDeltasMessage deltas;
+            decode(message->payload, deltas);
+            for (const BlockDelta& delta : deltas.deltas) {
+              if (delta.cell >= blocksByCell.size() || !blocksMap.calculateStorageLocation(delta.position)) {
+                throw ProtocolException("Invalid block delta");
+              }
+              // Debris for blocks broken by anyone, not only by this player
+              const Block* previous = blocksMap.get(delta.position);
+              if (previous && !blocksByCell[delta.cell]) particles.emitBlockBreak(delta.position, previous->id());
+              blocksMap.set(delta.position, blocksByCell[delta.cell]);
+              lightMap.blockChanged(delta.position);
+            }
+            deltasApplied = true;
+          } else {
+            throw ProtocolException("Unexpected message type " + std::to_string((int) message->type));
+          }
+        }
+        if (changedRegion) lightMap.regionChanged(*changedRegion);
+        if (changedRegion || deltasApplied) buildBlocksMesh();
+
+        serverConnection->send(MessageType::PLAYER_POSITION, encode(PlayerPositionMessage{simulation.interpolatedPosition(player.handle())}));
+        serverConnection->flush();
+        if (serverConnection->closed()) {
+          std::cerr << "Disconnected from the server" << std::endl;
+          glfwSetWindowShouldClose(window, GLFW_TRUE);
+        }
+      }
 
-      glm::mat4 m(1.f);
-      glm::mat4 v = glm::lookAt(player.position, player.position + player.direction(), glm::vec3(0.f, 1.f, 0.f));
-      glm::mat4 p = glm::perspective(glm::pi<float>() / 4.f, ratio, 0.1f, 100.f);
-      glm::mat4 mvp = p * v * m;
+      {
+        Profiler::Scope scope(profiler, "Particles");
+        std::shared_lock worldLock(simulation.worldMutex());
+        glm::vec3 center = benchmark ? player.position() : simulation.interpolatedPosition(player.handle());
+        particles.emitAmbient(blocksMap, center, AMBIENT_PARTICLE_RADIUS, deltaFrameTime);
+        particles.update(deltaFrameTime, &blocksMap);
+        particles.fillInstances(particleInstances, &lightMap);
+      }
 
-      // Draw blocks mesh
-      blocksVao.bind();
-      blockTextures.bind();
+      // Rendering
+      {
+        Profiler::Scope renderScope(profiler, "Render");
+
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        glm::mat4 m(1.f);
+        glm::vec3 eyePosition = benchmark ? player.position() : simulation.interpolatedPosition(player.handle());
+        glm::mat4 v = glm::lookAt(eyePosition, eyePosition + player.direction(), glm::vec3(0.f, 1.f, 0.f));
+        glm::mat4 p = glm::perspective(glm::pi<float>() / 4.f, ratio, 0.1f, 100.f);
+        glm::mat4 mvp = p * v * m;
+
+        // Draw blocks mesh
+        {
+          Profiler::Scope scope(profiler, "Uniform setup");
+          blocksVao.bind();
+          blockTextures.bind();
+          if (faceInstancing) blockFacesTexture.bind(1);
+
+          for (ShaderProgram* program : {&blocksShaderProgram, &blocksCutoutShaderProgram}) {
+            program->use();
+            program->setUniform("MVP", mvp);
+            program->setUniform("colorMap", 0);
+            program->setUniform("atlasCellCount", (GLuint) blockTextures.cellCountPerSide(), (GLuint) blockTextures.cellCountPerSide());
+            program->setUniform("texSize", (GLuint) blockTextures.cellSideLength(), (GLuint) blockTextures.cellSideLength());
+            if (faceInstancing) program->setUniform("faces", 1);
+          }
 
-      blocksShaderProgram.use();
-      blocksShaderProgram.setUniform("MVP", mvp);
-      blocksShaderProgram.setUniform("colorMap", 0);
-      blocksShaderProgram.setUniform("atlasCellCount", (GLuint) blockTextures.cellCountPerSide(), (GLuint) blockTextures.cellCountPerSide());
-      blocksShaderProgram.setUniform("texSize", (GLuint) blockTextures.cellSideLength(), (GLuint) blockTextures.cellSideLength());
+          if (faceInstancing) {
+            sortSectionsFrontToBack(blockFacesMesh.sections, eyePosition, sortedFaceSections);
+          } else {
+            sortSectionsFrontToBack(blocksMesh.sections, eyePosition, sortedSections);
+          }
+        }
+        // Draw either the opaque or the cutout range of every section with the program
+        auto drawBlocks = [&] (ShaderProgram& program, bool cutout) {
+          program.use();
+          if (faceInstancing) {
+            // A quad of 6 vertices for every face
+            for (const BlockFacesMesh::Section* section : sortedFaceSections) {
+              const BlocksMesh::IndexRange& range = cutout ? section->cutout : section->opaque;
+              if (range.count == 0) continue;
+              program.setUniform("faceOffset", (GLint) range.first);
+              program.setUniform("sectionOrigin", section->origin);
+              GLState::drawArraysInstanced(GL_TRIANGLES, 0, 6, range.count);
+            }
+          } else {
+            for (const BlocksMesh::Section* section : sortedSections) {
+              const BlocksMesh::IndexRange& range = cutout ? section->cutout : section->opaque;
+              if (range.count == 0) continue;
+              GLState::drawElements(GL_TRIANGLES, range.count, GL_UNSIGNED_INT, range.first * sizeof(GLuint));
+            }
+          }
+        };
+        {
+          Profiler::Scope scope(profiler, "Draw opaque blocks", true);
+          drawBlocks(blocksShaderProgram, false);
+        }
+        {
+          Profiler::Scope scope(profiler, "Draw cutout blocks", true);
+          drawBlocks(blocksCutoutShaderProgram, true);
+        }
 
-      glDrawElements(GL_TRIANGLES, blocksMesh.vertexIndices.size(), GL_UNSIGNED_INT, 0);
+        // Draw particles, after the blocks so that the hidden ones are rejected by the depth test
+        if (!particleInstances.empty()) {
+          Profiler::Scope scope(profiler, "Draw particles", true);
+          particlesVao.bind();
+          particlesVbo.bind();
+          // Orphan the storage, so that the driver hands out a fresh one instead of waiting for last frame's draw
+          particlesVbo.sendData(ParticleSystem::MAX_PARTICLES * sizeof(ParticleInstance), GL_STREAM_DRAW);
+          particlesVbo.sendSubData(particleInstances);
+
+          particlesShaderProgram.use();
+          particlesShaderProgram.setUniform("MVP", mvp);
+          particlesShaderProgram.setUniform("cameraRight", glm::vec3(v[0][0], v[1][0], v[2][0]));
+          particlesShaderProgram.setUniform("cameraUp", glm::vec3(v[0][1], v[1][1], v[2][1]));
+          particlesShaderProgram.setUniform("colorMap", 0);
+          particlesShaderProgram.setUniform("atlasCellCount", (GLuint) blockTextures.cellCountPerSide(), (GLuint) blockTextures.cellCountPerSide());
+          particlesShaderProgram.setUniform("texSize", (GLuint) blockTextures.cellSideLength(), (GLuint) blockTextures.cellSideLength());
+          blockTextures.bind();
+          GLState::drawArraysInstanced(GL_TRIANGLES, 0, 6, particleInstances.size());
+        }
 
-      // Draw skybox
-      skyboxVao.bind();
-      skyboxShaderProgram.use();
-      skyboxShaderProgram.setUniform("transMat", p * glm::mat4(glm::mat3(v)));
-      glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+        // Draw skybox
+        {
+          Profiler::Scope scope(profiler, "Draw skybox", true);
+          skyboxVao.bind();
+          skyboxShaderProgram.use();
+          skyboxShaderProgram.setUniform("transMat", p * glm::mat4(glm::mat3(v)));
+          GLState::drawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+        }
+      }
 
-      glfwSwapBuffers(window);
+      if (benchmark) {
+        // Nothing is presented, wait for the GPU so that the frame time covers the actual rendering
+        Profiler::Scope scope(profiler, "Finish");
+        glFinish();
+        benchmark->endFrame();
+      } else {
+        Profiler::Scope scope(profiler, "Swap");
+        glfwSwapBuffers(window);
+      }
       glfwPollEvents();
+
+      profiler.endFrame();
+      profiler.collect();
     }
 
+    profiler.disableGpuTiming();
+
+    profiler.collect();
+
+    if (benchmark) {
+      benchmark->printReport(std::cout);
+    }
+    if (inputReplayer) {
+      std::cout << "Replayed " << inputReplayer->frameIndex() << " frames" << std::endl;
+      profiler.printPercentiles(std::cout);
+    }
+    if (traceFilename) {
+      std::ofstream traceFile(traceFilename);
+      profiler.writeChromeTrace(traceFile);
+    }
+    if (meshCache && !faceInstancing) {
+      try {
+        meshCache->save();
+      } catch (const MeshCacheException& e) {
+        std::cerr << e.what() << std::endl;
+      }
+    }
     glfwDestroyWindow(window);
     glfwTerminate();
 
@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <iostream>
+#include "Server.hpp"
+#include "Metrics.hpp"
+
+Server::Server(BlocksMap& blocksMap_, BlockTickScheduler& blockTicks_, EntityStore& entities_, const std::string& address) :
+  _blocksMap(blocksMap_), _blockTicks(blockTicks_), _entities(entities_), _listener(address) {
+  _sectionCount = (_blocksMap.size + SECTION_SIZE - 1) / SECTION_SIZE;
+}
+
+BlocksRegion Server::sectionRegion(size_t section) const {
+  glm::ivec3 sectionPosition(
+    section % _sectionCount.x,
+    section / (_sectionCount.x * _sectionCount.z),
+    section / _sectionCount.x % _sectionCount.z);
+  glm::ivec3 min = _blocksMap.basePosition + sectionPosition * SECTION_SIZE;
+  return _blocksMap.clip(BlocksRegion{min, min + SECTION_SIZE});
+}
+
+void Server::tick(ThreadPool* threadPool) {
+  acceptClients();
+
+  _changedPositions.clear();
+  for (Client& client : _clients) {
+    if (!handleMessages(client)) {
+      std::cerr << "Dropping a client that sent an invalid message" << std::endl;
+      client.connection.close();
+    }
+  }
+
+  _blockTicks.tick(threadPool);
+  _blockTicks.takeChangedPositions(_changedPositions);
+
+  for (Client& client : _clients) {
+    if (!client.connection.closed()) sendUpdates(client);
+  }
+
+  // Forget the clients that went away
+  auto disconnected = std::remove_if(_clients.begin(), _clients.end(), [this] (Client& client) {
+    if (!client.connection.closed()) return false;
+    _entities.destroy(client.player);
+    return true;
+  });
+  _clients.erase(disconnected, _clients.end());
+
+  static Metric& clientCount = Metrics::gauge("server.clients");
+  clientCount.set(_clients.size());
+}
+
+void Server::acceptClients() {
+  while (std::optional<Connection> connection = _listener.accept()) {
+    Client client{std::move(*connection), _entities.create(glm::vec3(0.f))};
+    client.sentSections.resize(_sectionCount.x * _sectionCount.y * _sectionCount.z);
+
+    WorldInfoMessage worldInfo{_blocksMap.basePosition, _blocksMap.size, {}};
+    for (size_t id = 0; id < _blocksMap.registry().size(); id++) {
+      worldInfo.blockTypes.push_back(_blocksMap.registry().type(id).blockId());
+    }
+    client.connection.send(MessageType::WORLD_INFO, encode(worldInfo));
+    _clients.push_back(std::move(client));
+  }
+}
+
+bool Server::handleMessages(Client& client) {
+  try {
+    while (std::optional<Message> message = client.connection.receive()) {
+      switch (message->type) {
+        case MessageType::PLAYER_POSITION: {
+          PlayerPositionMessage playerPosition;
+          decode(message->payload, playerPosition);
+          _entities.position(client.player, playerPosition.position);
+          client.positionKnown = true;
+          break;
+        }
+        case MessageType::BREAK_BLOCK: {
+          BreakBlockMessage breakBlock;
+          decode(message->payload, breakBlock);
+          if (_blocksMap.get(breakBlock.position)) {
+            _blocksMap.set(breakBlock.position, std::nullopt);
+            _blockTicks.blockChanged(breakBlock.position);
+            _changedPositions.push_back(breakBlock.position);
+          }
+          break;
+        }
+        default:
+          throw ProtocolException("Unexpected message type " + std::to_string((int) message->type));
+      }
+    }
+  } catch (const ProtocolException& e) {
+    return false;
+  }
+  return true;
+}
+
+void Server::sendUpdates(Client& client) {
+  // Changes to sections the client does not have are left out, it gets them with the section
+  BlockDeltasMessage deltas;
+  for (const glm::ivec3& position : _changedPositions) {
+    glm::ivec3 section = (position - _blocksMap.basePosition) / SECTION_SIZE;
+    if (client.sentSections[(section.y * _sectionCount.z + section.z) * _sectionCount.x + section.x]) {
+      deltas.deltas.push_back(BlockDelta{position, blockCell(_blocksMap[position])});
+    }
+  }
+  if (!deltas.deltas.empty()) {
+    client.connection.send(MessageType::BLOCK_DELTAS, encode(deltas));
+  }
+
+  if (client.positionKnown) {
+    glm::ivec3 playerSection = (glm::ivec3(glm::floor(_entities.position(client.player) + 0.5f)) - _blocksMap.basePosition) / SECTION_SIZE;
+    _candidateSections.clear();
+    for (size_t section = 0; section < client.sentSections.size(); section++) {
+      glm::ivec3 sectionPosition = (sectionRegion(section).min - _blocksMap.basePosition) / SECTION_SIZE;
+      glm::ivec2 offset = glm::abs(glm::ivec2(sectionPosition.x - playerSection.x, sectionPosition.z - playerSection.z));
+      int distance = std::max(offset.x, offset.y);
+      if (client.sentSections[section]) {
+        if (distance > VIEW_DISTANCE + 1) {
+          client.connection.send(MessageType::SECTION_UNLOAD, encode(SectionUnloadMessage{sectionRegion(section)}));
+          client.sentSections[section] = false;
+        }
+      } else if (distance <= VIEW_DISTANCE) {
+        int dy = sectionPosition.y - playerSection.y;
+        _candidateSections.emplace_back(offset.x * offset.x + offset.y * offset.y + dy * dy, section);
+      }
+    }
+
+    // Nearest first, a few per tick so that streaming does not hold up the deltas
+    size_t count = std::min(SECTIONS_PER_TICK, _candidateSections.size());
+    std::partial_sort(_candidateSections.begin(), _candidateSections.begin() + count, _candidateSections.end());
+    for (size_t i = 0; i < count && client.connection.pendingBytes() < MAX_PENDING_BYTES; i++) {
+      size_t section = _candidateSections[i].second;
+      client.connection.send(MessageType::SECTION, encode(sectionOfMap(_blocksMap, sectionRegion(section))));
+      client.sentSections[section] = true;
+      static Metric& sentSections = Metrics::counter("server.sections_sent");
+      sentSections.add();
+    }
+  }
+
+  client.connection.flush();
+}
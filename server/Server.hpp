@@ -0,0 +1,62 @@
+#ifndef _SERVER_HPP_
+#define _SERVER_HPP_
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "BlocksMap.hpp"
+#include "BlockTickScheduler.hpp"
+#include "EntityStore.hpp"
+#include "ThreadPool.hpp"
+#include "Connection.hpp"
+
+// Owns the authoritative world for mc-clone-server and streams it to the connected games
+// Each client gets the sections around its player, nearest first, and the changes to the sections it has as one batch per tick
+class Server {
+public:
+  // Same as the sections of BlocksMesh, so that a received section is remeshed as a whole
+  static constexpr int SECTION_SIZE = 16;
+  // Sections within this many sections of the player horizontally are sent, sections further than one more are unloaded
+  static constexpr int VIEW_DISTANCE = 4;
+  static constexpr size_t SECTIONS_PER_TICK = 8; // per client
+  // No new sections are queued for a client while this much is still unsent, so that a slow client does not pile up memory
+  static constexpr size_t MAX_PENDING_BYTES = 1 << 20;
+
+private:
+  struct Client {
+    Connection connection;
+    EntityHandle player;
+    bool positionKnown = false;
+    std::vector<uint8_t> sentSections; // per section of the map, whether the client has it
+  };
+
+  BlocksMap& _blocksMap;
+  BlockTickScheduler& _blockTicks;
+  EntityStore& _entities;
+  Listener _listener;
+  std::vector<Client> _clients;
+  glm::ivec3 _sectionCount; // along each axis
+
+  // Reused between ticks
+  std::vector<glm::ivec3> _changedPositions;
+  std::vector<std::pair<int, size_t>> _candidateSections; // squared distance and section index
+
+  BlocksRegion sectionRegion(size_t section) const;
+  void acceptClients();
+  // False if the client sent something invalid and has to be dropped
+  bool handleMessages(Client& client);
+  void sendUpdates(Client& client);
+
+public:
+  Server(BlocksMap& blocksMap_, BlockTickScheduler& blockTicks_, EntityStore& entities_, const std::string& address);
+
+  Server(const Server&) = delete;
+  Server& operator=(const Server&) = delete;
+
+  // Take in new clients and their messages, run one tick of the world and send out the results
+  void tick(ThreadPool* threadPool = nullptr);
+
+  size_t clientCount() const { return _clients.size(); }
+};
+
+#endif
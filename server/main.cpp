@@ -0,0 +1,132 @@
+// Headless dedicated server: owns the world, runs the block ticks and streams sections to the games connected with --connect
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <optional>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "ApplicationException.hpp"
+#include "StreamingTextures.hpp"
+#include "Block.hpp"
+#include "BlockRegistry.hpp"
+#include "BlockBehaviours.hpp"
+#include "BlockTickScheduler.hpp"
+#include "BlocksMap.hpp"
+#include "EntityStore.hpp"
+#include "ThreadPool.hpp"
+#include "Server.hpp"
+#include "WorldStorage.hpp"
+#include "Metrics.hpp"
+#include "build_config.h"
+
+namespace {
+
+std::atomic<bool> stopRequested = false;
+
+const float TICK_LENGTH = 1.f / 20.f;
+
+// Stone with a layer of grass on top, and a tree every 12 blocks
+void generateWorld(BlocksMap& blocksMap) {
+  const BlockRegistry& registry = blocksMap.registry();
+  Block stone(registry.type(registry.id("stone")));
+  Block grass(registry.type(registry.id("grass_block")));
+  Block treeTrunk(registry.type(registry.id("tree_trunk")));
+  Block treeLeaves(registry.type(registry.id("tree_leaves")));
+
+  glm::ivec3 min = blocksMap.basePosition;
+  glm::ivec3 max = blocksMap.basePosition + blocksMap.size;
+  int groundY = min.y + blocksMap.size.y / 4;
+  blocksMap.fill(BlocksRegion{min, glm::ivec3(max.x, groundY, max.z)}, stone);
+  blocksMap.fill(BlocksRegion{glm::ivec3(min.x, groundY, min.z), glm::ivec3(max.x, groundY + 1, max.z)}, grass);
+
+  for (int z = min.z + 6; z + 3 < max.z; z += 12) {
+    for (int x = min.x + 6; x + 3 < max.x; x += 12) {
+      blocksMap.fill(BlocksRegion{glm::ivec3(x - 2, groundY + 4, z - 2), glm::ivec3(x + 3, groundY + 6, z + 3)}, treeLeaves);
+      blocksMap.fill(BlocksRegion{glm::ivec3(x - 1, groundY + 6, z - 1), glm::ivec3(x + 2, groundY + 7, z + 2)}, treeLeaves);
+      blocksMap.fill(BlocksRegion{glm::ivec3(x, groundY + 1, z), glm::ivec3(x + 1, groundY + 6, z + 1)}, treeTrunk);
+    }
+  }
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  std::string address = "127.0.0.1:25565";
+  int worldSize = 128;
+  int worldHeight = 32;
+  const char* metricsDestination = nullptr;
+  const char* worldDirectory = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--listen") == 0 && i + 1 < argc) {
+      address = argv[++i];
+    } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+      worldSize = std::max(1, atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--height") == 0 && i + 1 < argc) {
+      worldHeight = std::max(1, atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+      metricsDestination = argv[++i];
+    } else if (strcmp(argv[i], "--world") == 0 && i + 1 < argc) {
+      worldDirectory = argv[++i];
+    } else {
+      std::cerr << "Usage: " << argv[0] << " [--listen unix:PATH | --listen HOST:PORT] [--size N] [--height N] [--metrics unix:PATH | --metrics FILE] [--world DIR]" << std::endl;
+      exit(-1);
+    }
+  }
+
+  try {
+    std::optional<MetricsExporter> metricsExporter;
+    if (metricsDestination) metricsExporter.emplace(metricsDestination);
+
+    // The server only needs the block types, the textures go through the GL-free stub
+    StreamingTextures blockTextures(16, 16, std::vector<GLenum>{GL_RGBA8});
+    BlockRegistry blockRegistry;
+    blockRegistry.loadFromFile(APP_RESOURCE_PATH "/blocks.txt", blockTextures, APP_RESOURCE_PATH "/textures");
+    addBlockBehaviours(blockRegistry);
+
+    // A saved world keeps the bounds it was created with
+    std::optional<BlocksRegion> savedBounds;
+    if (worldDirectory) savedBounds = WorldStorage::savedBounds(worldDirectory);
+    BlocksRegion bounds = savedBounds.value_or(BlocksRegion{glm::ivec3(-worldSize / 2, 0, -worldSize / 2), glm::ivec3(worldSize - worldSize / 2, worldHeight, worldSize - worldSize / 2)});
+    BlocksMap blocksMap(blockRegistry, bounds.min, bounds.max - bounds.min);
+    if (!savedBounds) generateWorld(blocksMap);
+    std::optional<WorldStorage> worldStorage;
+    if (worldDirectory) worldStorage.emplace(worldDirectory, blocksMap);
+    BlockTickScheduler blockTicks(blocksMap);
+    EntityStore entities;
+    ThreadPool threadPool;
+    Server server(blocksMap, blockTicks, entities, address);
+
+    signal(SIGINT, [] (int) { stopRequested = true; });
+    signal(SIGTERM, [] (int) { stopRequested = true; });
+    std::cout << "Listening on " << address << std::endl;
+
+    auto tickDuration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(TICK_LENGTH));
+    auto nextTickTime = std::chrono::steady_clock::now();
+    size_t lastClientCount = 0;
+    while (!stopRequested) {
+      server.tick(&threadPool);
+      if (server.clientCount() != lastClientCount) {
+        lastClientCount = server.clientCount();
+        std::cout << lastClientCount << " client(s) connected" << std::endl;
+      }
+
+      nextTickTime += tickDuration;
+      auto now = std::chrono::steady_clock::now();
+      if (now > nextTickTime) {
+        // Behind, skip the ticks that were missed rather than running them back to back
+        nextTickTime = now;
+      }
+      std::this_thread::sleep_until(nextTickTime);
+    }
+  } catch (const ApplicationException& e) {
+    std::cerr << e.what() << std::endl;
+    return -1;
+  }
+  return 0;
+}
@@ -4,18 +4,57 @@ uniform mat4 MVP;
 uniform uvec2 atlasCellCount;
 uniform uvec2 texSize;
 
+#ifdef FACE_RECORDS
+// Vertex pulling, each instance is one face record of BlockFacesMesh and gl_VertexID picks a corner of its quad
+uniform usamplerBuffer faces;
+uniform int faceOffset; // of the first face of the draw, gl_InstanceID starts from 0 in every draw
+uniform ivec3 sectionOrigin;
+
+// Same as the full block faces in BlockType, in X+, X-, Y+, Y-, Z+, Z- order
+const vec3 sideCorners[24] = vec3[24](
+  vec3( 0.5, -0.5,  0.5), vec3( 0.5, -0.5, -0.5), vec3( 0.5,  0.5,  0.5), vec3( 0.5,  0.5, -0.5),
+  vec3(-0.5, -0.5, -0.5), vec3(-0.5, -0.5,  0.5), vec3(-0.5,  0.5, -0.5), vec3(-0.5,  0.5,  0.5),
+  vec3(-0.5,  0.5,  0.5), vec3( 0.5,  0.5,  0.5), vec3(-0.5,  0.5, -0.5), vec3( 0.5,  0.5, -0.5),
+  vec3( 0.5, -0.5,  0.5), vec3(-0.5, -0.5,  0.5), vec3( 0.5, -0.5, -0.5), vec3(-0.5, -0.5, -0.5),
+  vec3(-0.5, -0.5,  0.5), vec3( 0.5, -0.5,  0.5), vec3(-0.5,  0.5,  0.5), vec3( 0.5,  0.5,  0.5),
+  vec3( 0.5, -0.5, -0.5), vec3(-0.5, -0.5, -0.5), vec3( 0.5,  0.5, -0.5), vec3(-0.5,  0.5, -0.5)
+);
+const vec3 sideNormals[6] = vec3[6](
+  vec3(1.0, 0.0, 0.0), vec3(-1.0, 0.0, 0.0), vec3(0.0, 1.0, 0.0), vec3(0.0, -1.0, 0.0), vec3(0.0, 0.0, 1.0), vec3(0.0, 0.0, -1.0)
+);
+const vec2 cornerTexCoords[4] = vec2[4](vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(0.0, 1.0), vec2(1.0, 1.0));
+const int quadCorners[6] = int[6](0, 1, 2, 1, 3, 2);
+#else
 in vec3 vPos;
 in vec3 vNorm;
 in uvec2 vTexPartLocation;
 in vec2 vTexCoord;
+in vec2 vLight; // sky light, block light
+#endif
 
 out vec3 normal;
 flat out vec2 uvOffset;
 out vec2 uv;
+out float lightFactor;
 
 void main() {
+#ifdef FACE_RECORDS
+  uint face = texelFetch(faces, faceOffset + gl_InstanceID).r;
+  int side = int((face >> 12) & 7u);
+  int corner = quadCorners[gl_VertexID];
+  uint textureCell = face >> 23;
+  vec3 vPos = vec3(sectionOrigin + ivec3(face & 15u, (face >> 4) & 15u, (face >> 8) & 15u)) + sideCorners[side * 4 + corner];
+  vec3 vNorm = sideNormals[side];
+  vec2 vTexCoord = cornerTexCoords[corner];
+  uvec2 vTexPartLocation = uvec2(textureCell % atlasCellCount.x, textureCell / atlasCellCount.x);
+  vec2 vLight = vec2((face >> 15) & 15u, (face >> 19) & 15u) / 15.0;
+#endif
+
   gl_Position = MVP * vec4(vPos, 1.0);
   normal = (MVP * vec4(vNorm, 0.0)).xyz;
   uv = vTexCoord;
   uvOffset = vec2(vTexPartLocation) / atlasCellCount;
+  // Each light level is 80% as bright as the one above, with a floor so that unlit caves are not pitch black
+  float level = max(vLight.x, vLight.y);
+  lightFactor = max(pow(0.8, 15.0 * (1.0 - level)), 0.05);
 }
@@ -0,0 +1,16 @@
+#version 150
+
+uniform sampler2D colorMap;
+uniform uvec2 atlasCellCount;
+uniform uvec2 texSize;
+
+in vec2 uv;
+flat in vec2 uvOffset;
+in float lightFactor;
+
+void main() {
+  vec2 clampedUv = clamp(uv, 0.5 / texSize, 1.0 - 0.5 / texSize);
+  vec4 color = texture(colorMap, clampedUv / atlasCellCount + uvOffset);
+  if (color.a < 0.5) discard;
+  gl_FragColor = vec4(color.rgb * lightFactor, 1.0);
+}
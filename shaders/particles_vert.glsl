@@ -0,0 +1,34 @@
+#version 150
+
+uniform mat4 MVP;
+uniform vec3 cameraRight;
+uniform vec3 cameraUp;
+uniform uvec2 atlasCellCount;
+
+// Per instance, see ParticleInstance
+in vec3 vCenter;
+in float vSize;
+in uint vTexture;
+
+// Same corner order as the faces, so that the quad is counter-clockwise when facing the camera
+const vec2 cornerOffsets[4] = vec2[4](vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(0.0, 1.0), vec2(1.0, 1.0));
+const int quadCorners[6] = int[6](0, 1, 2, 1, 3, 2);
+const float TEXTURE_SUBCELLS = 4.0; // ParticleSystem::TEXTURE_SUBCELLS
+
+out vec2 uv;
+flat out vec2 uvOffset;
+out float lightFactor;
+
+void main() {
+  vec2 corner = cornerOffsets[quadCorners[gl_VertexID]];
+  vec3 position = vCenter + (cameraRight * (corner.x - 0.5) + cameraUp * (corner.y - 0.5)) * vSize;
+  gl_Position = MVP * vec4(position, 1.0);
+
+  uint textureCell = vTexture & 0xffffu;
+  vec2 subcell = vec2((vTexture >> 16) & 3u, (vTexture >> 18) & 3u);
+  uv = (subcell + corner) / TEXTURE_SUBCELLS;
+  uvOffset = vec2(textureCell % atlasCellCount.x, textureCell / atlasCellCount.x) / atlasCellCount;
+  // Same falloff as the blocks
+  float level = float((vTexture >> 20) & 15u) / 15.0;
+  lightFactor = max(pow(0.8, 15.0 * (1.0 - level)), 0.05);
+}